@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cassert>
+#include <map>
+
+#include "glad/glad.h"
+
+#include "arena.hpp"
+
+render::Arena::Arena(unsigned usage) : buffer_(0)
+                                     , usage_(usage)
+                                     , capacity_(0)
+                                     , used_(0)
+                                     , generation_(0) {}
+
+render::range render::Arena::allocate(unsigned size, unsigned alignment)
+{
+    /**/ assert(alignment != 0);
+
+    std::vector<range>::iterator it = free_.begin();
+    for ( ; it != free_.end(); ++it)
+    {
+        const unsigned offset = (it->offset + alignment - 1) / alignment * alignment;
+        const unsigned end = it->offset + it->size;
+
+        if (offset + size > end) {
+            continue;
+        }
+
+        // Split the block: padding before the range stays free, as does the tail
+        const range head = { it->offset, offset - it->offset };
+        const range tail = { offset + size, end - offset - size };
+
+        it = free_.erase(it);
+        if (tail.size != 0) {
+            it = free_.insert(it, tail);
+        }
+        if (head.size != 0) {
+            free_.insert(it, head);
+        }
+
+        used_ += size;
+
+        const range r = { offset, size };
+        return r;
+    }
+
+    grow(std::max(std::max(2 * capacity_, capacity_ + size + alignment), ARENA_SIZE_MIN));
+    return allocate(size, alignment);
+}
+
+void render::Arena::release(const range& r)
+{
+    if (r.size == 0) {
+        return;
+    }
+
+    used_ -= r.size;
+
+    std::vector<range>::iterator it = free_.begin();
+    while (it != free_.end() && it->offset < r.offset)
+        ++it;
+
+    it = free_.insert(it, r);
+
+    // Merge with the block after, then with the one before
+    std::vector<range>::iterator next = it + 1;
+    if (next != free_.end() && it->offset + it->size == next->offset)
+    {
+        it->size += next->size;
+        free_.erase(next);
+    }
+
+    if (it != free_.begin())
+    {
+        std::vector<range>::iterator prev = it - 1;
+        if (prev->offset + prev->size == it->offset)
+        {
+            prev->size += it->size;
+            free_.erase(it);
+        }
+    }
+}
+
+unsigned render::Arena::buffer() const {
+    return buffer_;
+}
+
+unsigned render::Arena::capacity() const {
+    return capacity_;
+}
+
+unsigned render::Arena::used() const {
+    return used_;
+}
+
+unsigned render::Arena::generation() const {
+    return generation_;
+}
+
+void render::Arena::grow(unsigned capacity)
+{
+    unsigned next = 0;
+    glGenBuffers(1, &next);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, next);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, usage_);
+
+    // Copy on the GPU; deleting the old buffer waits for draws reading it
+    if (buffer_ != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity_);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+        glDeleteBuffers(1, &buffer_);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // The new space extends a free block at the end, or follows it
+    if (!free_.empty() && free_.back().offset + free_.back().size == capacity_) {
+        free_.back().size += capacity - capacity_;
+    }
+
+    else
+    {
+        const range tail = { capacity_, capacity - capacity_ };
+        free_.push_back(tail);
+    }
+
+    buffer_ = next;
+    capacity_ = capacity;
+    ++generation_;
+}
+
+render::Arena& render::vertex_arena()
+{
+    static Arena arena(GL_STATIC_DRAW);
+    return arena;
+}
+
+render::Arena& render::instance_arena()
+{
+    static Arena arena(GL_DYNAMIC_DRAW);
+    return arena;
+}
+
+render::range render::share_mesh(const float* vertices, unsigned size, unsigned stride)
+{
+    static std::map<const float*, range> meshes;
+
+    std::map<const float*, range>::iterator it = meshes.find(vertices);
+    if (it != meshes.end())
+    {
+        /**/ assert(it->second.size == size);
+        return it->second;
+    }
+
+    const range r = vertex_arena().allocate(size, stride);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_arena().buffer());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, r.offset, size, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    meshes[vertices] = r;
+    return r;
+}
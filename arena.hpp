@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <vector>
+
+namespace render {
+
+    /// Smallest buffer an arena allocates (64 KB); it doubles from there
+    static const unsigned ARENA_SIZE_MIN = 1 << 16;
+
+    /// struct range
+    /*! Bytes [offset, offset + size) of an arena's buffer
+     */
+    struct range { unsigned offset, size; };
+
+    /// class Arena
+    /*! One OpenGL buffer handed out in ranges, first fit over a free list
+     *! kept sorted and merged. When no free block fits, the buffer doubles:
+     *! its contents move to a new buffer on the GPU and generation() moves
+     *! on, after which vertex arrays set up against the old buffer must be
+     *! pointed at the new one
+     */
+    class Arena {
+    public:
+        /// ctor.
+        /// @param usage usage hint of the buffer (GL_STATIC_DRAW, ...)
+        explicit Arena(unsigned usage);
+        /// @param size bytes to allocate
+        /// @param alignment the offset is a multiple of alignment (any value,
+        ///        e.g. the vertex size for drawing with a base vertex)
+        /// @return the range allocated
+        range allocate(unsigned size, unsigned alignment);
+        /// Returns a range from allocate() to the free list
+        void release(const range& r);
+        /// @get
+        unsigned buffer() const;
+        /// @get
+        unsigned capacity() const;
+        /// @get
+        /// @return bytes allocated, without alignment padding
+        unsigned used() const;
+        /// @get
+        /// @return times the buffer was replaced
+        unsigned generation() const;
+
+    private:
+
+        // Buffer handle and usage hint
+        unsigned buffer_, usage_;
+        // Buffer size and bytes allocated from it
+        unsigned capacity_, used_;
+        unsigned generation_;
+        // Free blocks by increasing offset, none adjacent
+        std::vector<range> free_;
+        // Helper
+        // Moves the contents to a new buffer of capacity bytes
+        void grow(unsigned capacity);
+    };
+
+    /// @return the arena holding mesh vertices, shared by all drawables
+    Arena& vertex_arena();
+    /// @return the arena holding the instances of UPLOAD_SUBDATA drawables
+    Arena& instance_arena();
+
+    /// @param vertices mesh vertices, static for the program's lifetime
+    /// @param size size of vertices in bytes
+    /// @param stride vertex size in bytes
+    /// @return range of vertex_arena() holding the mesh; stored once per
+    ///         vertices address however many drawables use it
+    range share_mesh(const float* vertices, unsigned size, unsigned stride);
+}
+
+#endif
@@ -17,11 +17,13 @@ struct BallData {
     calc::vec3f speed;
     // Ball turn rate
     calc::vec3f turnRate;
+    // Current ball orientation
+    calc::quatf orientation;
     // Current ball postition
     calc::mat4f translation;
     /*! ctor.
      */
-    BallData() : selectedSkin(0) , direction(1.0, 1.0, 0) , speed(0, 0, 0) , translation(calc::mat4f::identity()) {}
+    BallData() : selectedSkin(0) , direction(1.0, 1.0, 0) , speed(0, 0, 0) , orientation(calc::quatf::identity()) , translation(calc::mat4f::identity()) {}
 };
 
 #endif
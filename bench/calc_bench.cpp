@@ -0,0 +1,1064 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <thread>
+
+#include <x86intrin.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "calc/matrix.hpp"
+#include "calc/simd/schur_mul.hpp"
+
+namespace {
+
+    // Number of calls to the global operator new (replaced below)
+    std::size_t allocations = 0;
+
+    // Keeps results observable so the timed loops aren't optimized away
+    volatile float sink = 0;
+
+    /*! Helper
+     *! Compiler barrier: p is published and memory may have changed, so an
+     *! inlined kernel can neither be hoisted out of the timing loop nor cut
+     *! down to the elements read afterwards
+     */
+    inline void escape(const void* p) {
+        asm volatile("" : : "g"(p) : "memory");
+    }
+
+    /*! Helper
+     *! Fills matrix with values in [-1, 1)
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    void fill(calc::matrix<T, N, M>& m)
+    {
+        T* d = calc::data(m);
+        for (unsigned i = 0; i != N * M; ++i)
+            d[i] = (std::rand() % 2000) / T(1000) - 1;
+    }
+
+    /*! Helper
+     *! Counts a hardware event of the calling thread in user space; valid()
+     *! is false where perf events are unavailable (containers,
+     *! perf_event_paranoid > 2)
+     */
+    class perf_counter {
+
+        int fd_;
+
+    public:
+
+        explicit perf_counter(const unsigned long long config) {
+
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        ~perf_counter() {
+            if (fd_ >= 0) close(fd_);
+        }
+
+        bool valid() const {
+            return fd_ >= 0;
+        }
+
+        void start() {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+
+        long long stop() {
+
+            long long count = 0;
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+                return -1;
+            }
+            return count;
+        }
+    };
+
+    /*! Helper
+     *! Counts core cycles; falls back to the time-stamp counter (reference
+     *! cycles at the nominal frequency) without perf events
+     */
+    class cycle_counter {
+
+        perf_counter counter_;
+        unsigned long long tsc_;
+
+    public:
+
+        cycle_counter() : counter_(PERF_COUNT_HW_CPU_CYCLES), tsc_(0) {}
+
+        void start() {
+            if (counter_.valid()) {
+                counter_.start();
+            }
+            tsc_ = __rdtsc();
+        }
+
+        double stop() {
+
+            const unsigned long long tsc = __rdtsc() - tsc_;
+            const long long count = counter_.valid() ? counter_.stop() : -1;
+            return count >= 0 ? double(count) : double(tsc);
+        }
+    };
+
+    /*! Helper
+     *! Times f over a number of iterations after a warm-up pass and prints
+     *! ns/op, ops/s and cycles/op
+     *! @return number of allocations made by the timed iterations
+     */
+    template <typename F>
+    std::size_t run(const char* name, F f, unsigned iterations = 1000000)
+    {
+        // Warm up (fills caches and thread-local scratch)
+        for (unsigned i = 0; i != iterations / 100 + 1; ++i)
+            f();
+
+        cycle_counter cycles;
+        const std::size_t before = allocations;
+
+        cycles.start();
+        const auto start = std::chrono::steady_clock::now();
+
+        for (unsigned i = 0; i != iterations; ++i)
+            f();
+
+        const auto stop = std::chrono::steady_clock::now();
+        const double cycleCount = cycles.stop();
+        const std::size_t count = allocations - before;
+
+        const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+        printf("%-24s %10.2f ns/op %14.0f ops/s %8.1f cycles/op %6zu allocs\n",
+               name, ns, 1e9 / ns, cycleCount / iterations, count);
+        return count;
+    }
+
+    /*! Helper
+     *! Benchmarks a product of fixed shape
+     */
+    template <unsigned N,
+              unsigned M,
+              unsigned M1,
+              typename T = float>
+    std::size_t bench_mul(const char* name)
+    {
+        calc::matrix<T, N, M> lhs;
+        calc::matrix<T, M, M1> rhs;
+        fill(lhs);
+        fill(rhs);
+
+        return run(name, [&]() {
+            escape(&lhs);
+            const calc::matrix<T, N, M1> out = lhs * rhs;
+            escape(&out);
+            sink = sink + out(0, 0);
+        });
+    }
+
+    // Fixed-size product kernel, as stored in calc::detail::kernel_table
+    typedef void (*kernel_fn)(const float*, const float*, float*);
+
+    /*! Reference
+     *! The dot-product formulation the fixed-size kernels replaced: one
+     *! multiply and two horizontal adds per output element
+     */
+    struct hadd_kernels {
+
+        static inline float dot(const __m128 r, const __m128 c) {
+
+            __m128 tmp;
+
+            tmp = _mm_mul_ps(r, c);
+            tmp = _mm_hadd_ps(tmp, tmp);
+            tmp = _mm_hadd_ps(tmp, tmp);
+
+            return _mm_cvtss_f32(tmp);
+        }
+
+        static void mul_4x4x1(const float* dat1, const float* dat2, float* out) {
+
+            const __m128 c0 = _mm_load_ps(dat2);
+
+            out[0] = dot(_mm_load_ps(dat1), c0);
+            out[1] = dot(_mm_load_ps(dat1 +  4), c0);
+            out[2] = dot(_mm_load_ps(dat1 +  8), c0);
+            out[3] = dot(_mm_load_ps(dat1 + 12), c0);
+        }
+
+        static void mul_4x4x4(const float* dat1, const float* dat2, float* out) {
+
+            __m128 c[4] = {
+                _mm_load_ps(dat2),
+                _mm_load_ps(dat2 +  4),
+                _mm_load_ps(dat2 +  8),
+                _mm_load_ps(dat2 + 12)
+            };
+
+            _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+
+            for (unsigned i = 0; i != 4; ++i)
+            {
+                const __m128 r = _mm_load_ps(dat1 + i * 4);
+                for (unsigned j = 0; j != 4; ++j)
+                    out[i * 4 + j] = dot(r, c[j]);
+            }
+        }
+
+        static void mul_3x3x1(const float* dat1, const float* dat2, float* out) {
+
+            const __m128 c0 = _mm_loadu_ps(dat2);
+
+            out[0] = dot(_mm_loadu_ps(dat1), c0);
+            out[1] = dot(_mm_loadu_ps(dat1 + 3), c0);
+            out[2] = dot(_mm_loadu_ps(dat1 + 6), c0);
+        }
+
+        static void mul_3x3x3(const float* dat1, const float* dat2, float* out) {
+
+            const float datc0[4] __attribute__((aligned(16))) = { dat2[0], dat2[3], dat2[6], 0 };
+            const float datc1[4] __attribute__((aligned(16))) = { dat2[1], dat2[4], dat2[7], 0 };
+            const float datc2[4] __attribute__((aligned(16))) = { dat2[2], dat2[5], dat2[8], 0 };
+
+            const __m128 c[3] = { _mm_load_ps(datc0), _mm_load_ps(datc1), _mm_load_ps(datc2) };
+
+            for (unsigned i = 0; i != 3; ++i)
+            {
+                const __m128 r = _mm_loadu_ps(dat1 + i * 3);
+                for (unsigned j = 0; j != 3; ++j)
+                    out[i * 3 + j] = dot(r, c[j]);
+            }
+        }
+    };
+
+    /*! Helper
+     *! Times a fixed-size kernel on a dependent chain (out feeds the next
+     *! call's RHS) so latency as well as issue rate shows up
+     *! @return ns/op
+     */
+    double bench_kernel(const char* name, kernel_fn kernel)
+    {
+        calc::matrix<float, 4, 4> lhs;
+        calc::matrix<float, 4, 4> rhs;
+        fill(lhs);
+        fill(rhs);
+
+        // Keeps the chain bounded
+        lhs *= 0.25f;
+
+        float* l = calc::data(lhs);
+        float* r = calc::data(rhs);
+
+        const unsigned iterations = 10000000;
+        for (unsigned i = 0; i != iterations / 100; ++i)
+            kernel(l, r, r);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (unsigned i = 0; i != iterations; ++i)
+            kernel(l, r, r);
+
+        const auto stop = std::chrono::steady_clock::now();
+        sink = sink + r[0];
+
+        const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+        printf("%-24s %10.2f ns/op %14.0f ops/s\n", name, ns, 1e9 / ns);
+        return ns;
+    }
+
+    /*! Helper
+     *! Compares one fixed-size shape across the hadd reference and every
+     *! backend the host can run
+     */
+    void bench_kernels(const char* shape,
+                       kernel_fn reference,
+                       kernel_fn calc::detail::kernel_table::* kernel)
+    {
+        char name[64];
+
+        snprintf(name, sizeof(name), "%s hadd", shape);
+        const double base = bench_kernel(name, reference);
+
+        for (unsigned b = calc::BACKEND_SSE4; b <= calc::detail::host_backend(); ++b)
+        {
+            const calc::detail::kernel_table& table = calc::detail::table_for(static_cast<calc::backend>(b));
+
+            snprintf(name, sizeof(name), "%s %s", shape, table.name);
+            const double ns = bench_kernel(name, table.*kernel);
+            printf("%-24s %10.2fx\n", "", base / ns);
+        }
+    }
+
+    /*! Helper
+     *! Times sin and cos of a batch of angles: libm against every backend's
+     *! sincos kernel the host can run
+     */
+    void bench_sincos()
+    {
+        const std::size_t size = 1024;
+        const unsigned iterations = 20000;
+
+        static float rad[size], s[size], c[size];
+        for (std::size_t i = 0; i != size; ++i)
+            rad[i] = (std::rand() % 20000) / 1000.0f - 10;
+
+        auto time = [&](const char* name, void (*kernel)(const float*, float*, float*, std::size_t)) {
+
+            const auto start = std::chrono::steady_clock::now();
+            for (unsigned i = 0; i != iterations; ++i)
+            {
+                kernel(rad, s, c, size);
+                sink = sink + s[i % size] + c[i % size];
+            }
+            const auto stop = std::chrono::steady_clock::now();
+
+            const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations / size;
+            printf("%-24s %10.2f ns/angle %11.0f angles/s\n", name, ns, 1e9 / ns);
+            return ns;
+        };
+
+        struct libm {
+            static void sincos(const float* rad, float* s, float* c, std::size_t size) {
+                for (std::size_t i = 0; i != size; ++i)
+                {
+                    s[i] = std::sin(rad[i]);
+                    c[i] = std::cos(rad[i]);
+                }
+            }
+        };
+
+        char name[64];
+        const double base = time("sincos libm", &libm::sincos);
+
+        for (unsigned b = calc::BACKEND_SSE4; b <= calc::detail::host_backend(); ++b)
+        {
+            const calc::detail::kernel_table& table = calc::detail::table_for(static_cast<calc::backend>(b));
+
+            snprintf(name, sizeof(name), "sincos %s", table.name);
+            const double ns = time(name, table.sincos);
+            printf("%-24s %10.2fx\n", "", base / ns);
+        }
+    }
+
+    /*! Helper
+     *! Times a kernel writing into a zeroed temporary against one built with
+     *! calc::uninit, the way the operators construct their results
+     */
+    template <unsigned N,
+              unsigned M,
+              unsigned M1>
+    void bench_uninit(const char* name, void (*calc::detail::kernel_table::*kernel)(const float*, const float*, float*))
+    {
+        calc::matrix<float, N, M> lhs;
+        calc::matrix<float, M, M1> rhs;
+        fill(lhs);
+        fill(rhs);
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s zeroed", name);
+        run(label, [&]() {
+            calc::matrix<float, N, M1> out;
+            (calc::detail::kernels().*kernel)(calc::data(lhs), calc::data(rhs), calc::data(out));
+            sink = sink + out(0, 0);
+        });
+
+        snprintf(label, sizeof(label), "%s uninit", name);
+        run(label, [&]() {
+            calc::matrix<float, N, M1> out(calc::uninit);
+            (calc::detail::kernels().*kernel)(calc::data(lhs), calc::data(rhs), calc::data(out));
+            sink = sink + out(0, 0);
+        });
+    }
+
+    /*! Helper
+     *! Replays the per-frame math of Camera::update and of the box transform
+     *! in Runner::render
+     */
+    void bench_frame()
+    {
+        const calc::vec3f eye(0, 0, -20);
+        const calc::vec3f forward(0, 0, 1);
+        const calc::vec3f up(0, 1, 0);
+        const calc::quatf viewRotation = calc::quatf::from_euler(0.1f, 0.2f, 0.3f);
+
+        calc::mat4f projection = calc::mat4f::identity();
+        projection(2, 2) = -1.002f;
+        projection(2, 3) = -0.2002f;
+        projection(3, 2) = -1;
+        projection(3, 3) = 0;
+
+        run("camera update", [&]() {
+
+            const calc::vec3f f = calc::normal(forward);
+            const calc::vec3f s = calc::normal(calc::cross(f, up));
+            const calc::vec3f u = calc::cross(s, f);
+
+            calc::mat4f lookAt = calc::mat4f::identity();
+            lookAt(0, 0) = s[0]; lookAt(0, 1) = s[1]; lookAt(0, 2) = s[2];
+            lookAt(1, 0) = u[0]; lookAt(1, 1) = u[1]; lookAt(1, 2) = u[2];
+            lookAt(2, 0) = -f[0]; lookAt(2, 1) = -f[1]; lookAt(2, 2) = -f[2];
+            lookAt(0, 3) = -calc::dot(s, eye);
+            lookAt(1, 3) = -calc::dot(u, eye);
+            lookAt(2, 3) =  calc::dot(f, eye);
+
+            const calc::mat4f view = lookAt * calc::to_mat4(viewRotation);
+            const calc::mat4f scene = projection * view;
+            const calc::mat4f device = calc::transpose(scene);
+            sink = sink + device(0, 0) + calc::transpose(view)(1, 1);
+        });
+
+        float ticks = 0;
+        run("render box transform", [&]() {
+
+            const calc::vec3f turnRate = calc::vec3f(0.5f, 1.0f, 1.5f) * calc::radians(ticks += 0.16f);
+            const calc::quatf orientation = calc::quatf::from_euler(turnRate[0], turnRate[1], turnRate[2]);
+            const calc::affine3f box = calc::to_affine(orientation, calc::vec3f(1, 2, -1));
+            sink = sink + calc::data(box)[0];
+        });
+    }
+
+    /*! Helper
+     *! Times the scalar element loop of calc::transpose against the register
+     *! transpose and the batched kernel of every backend the host can run
+     */
+    void bench_transpose()
+    {
+        const std::size_t size = 1024;
+        static calc::mat4f in[size], out[size];
+        for (std::size_t i = 0; i != size; ++i)
+            fill(in[i]);
+
+        std::size_t k = 0;
+        run("transpose 4x4 scalar", [&]() {
+            out[k] = calc::transpose<float, 4, 4>(in[k]);
+            sink = sink + out[k](0, 1);
+            k = (k + 1) % size;
+        });
+        run("transpose 4x4", [&]() {
+            out[k] = calc::transpose(in[k]);
+            sink = sink + out[k](0, 1);
+            k = (k + 1) % size;
+        });
+
+        const calc::backend active = calc::get_backend();
+        char name[64];
+
+        for (unsigned b = calc::BACKEND_SSE4; b <= calc::detail::host_backend(); ++b)
+        {
+            calc::set_backend(static_cast<calc::backend>(b));
+            snprintf(name, sizeof(name), "transpose[1024] %s", calc::get_backend_name(calc::get_backend()));
+
+            run(name, [&]() {
+                calc::transpose(in, out, size);
+                sink = sink + out[size - 1](0, 1);
+            }, 20000);
+        }
+
+        calc::set_backend(active);
+    }
+
+    /*! Helper
+     *! Times the scalar 4x4 inverse against the register one and the
+     *! rigid and affine inverses of a view matrix
+     */
+    void bench_inverse()
+    {
+        const std::size_t size = 1024;
+        static calc::mat4f in[size], out[size];
+        for (std::size_t i = 0; i != size; ++i)
+        {
+            const calc::quatf q = calc::quatf::from_euler(0.01f * i, 0.02f * i, 0.03f * i);
+            in[i] = calc::to_mat4(q);
+            in[i](0, 3) = 0.5f * i;
+        }
+
+        std::size_t k = 0;
+        run("inverse 4x4 scalar", [&]() {
+            out[k] = calc::inverse<float>(in[k]);
+            sink = sink + out[k](0, 1);
+            k = (k + 1) % size;
+        });
+        run("inverse 4x4", [&]() {
+            out[k] = calc::inverse(in[k]);
+            sink = sink + out[k](0, 1);
+            k = (k + 1) % size;
+        });
+        run("inverse_affine 4x4", [&]() {
+            out[k] = calc::inverse_affine(in[k]);
+            sink = sink + out[k](0, 1);
+            k = (k + 1) % size;
+        });
+        run("inverse_rigid 4x4", [&]() {
+            out[k] = calc::inverse_rigid(in[k]);
+            sink = sink + out[k](0, 1);
+            k = (k + 1) % size;
+        });
+        run("determinant 4x4", [&]() {
+            sink = sink + calc::determinant(in[k]);
+            k = (k + 1) % size;
+        });
+    }
+
+    /*! Helper
+     *! GFLOP/s of square float products, 256 to 4096: the dot product
+     *! formulation the dynamic path used before (up to 1024; beyond that it
+     *! takes minutes) against calc::gemm on one thread and on every core
+     */
+    void bench_gemm()
+    {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        printf("%-24s %12s %12s %12s   (%u cores)\n", "gemm", "dot", "1 thread", "all cores", cores);
+
+        for (std::size_t n = 256; n <= 4096; n *= 2)
+        {
+            calc::matf a(n, n), b(n, n), c(n, n);
+            for (std::size_t i = 0; i != a.size(); ++i)
+            {
+                calc::data(a)[i] = (std::rand() % 2000) / 1000.0f - 1;
+                calc::data(b)[i] = (std::rand() % 2000) / 1000.0f - 1;
+            }
+
+            const double flops = 2.0 * n * n * n;
+
+            // Best of a few repetitions, at least one second's worth below 1024
+            auto gflops = [&](const std::function<void()>& f) {
+
+                const unsigned repeat = n <= 512 ? 8 : (n <= 1024 ? 3 : 1);
+
+                double best = 0;
+                for (unsigned r = 0; r != repeat; ++r)
+                {
+                    const auto start = std::chrono::steady_clock::now();
+                    f();
+                    const auto stop = std::chrono::steady_clock::now();
+
+                    best = std::max(best, flops / std::chrono::duration<double, std::nano>(stop - start).count());
+                }
+
+                sink = sink + calc::data(c)[0];
+                return best;
+            };
+
+#ifndef __NO_USE_SIMD__
+            const double dot = n > 1024 ? 0 : gflops([&]() {
+                calc::matrix_mul<float, 0, 0, 0>::mul_dot(calc::data(a), calc::data(b), calc::data(c), n, n, n);
+            });
+#else
+            const double dot = 0;
+#endif
+            const double serial = gflops([&]() {
+                calc::gemm(calc::data(a), calc::data(b), calc::data(c), n, n, n, 1);
+            });
+            const double parallel = cores == 1 ? serial : gflops([&]() {
+                calc::gemm(calc::data(a), calc::data(b), calc::data(c), n, n, n);
+            });
+
+            char name[32];
+            snprintf(name, sizeof(name), "gemm %zux%zu", n, n);
+            if (dot != 0)
+                printf("%-24s %12.2f %12.2f %12.2f GFLOP/s\n", name, dot, serial, parallel);
+            else
+                printf("%-24s %12s %12.2f %12.2f GFLOP/s\n", name, "-", serial, parallel);
+        }
+    }
+
+    /*! Helper
+     *! Times calc::gemm at a size the worker pool splits, four ways even on
+     *! fewer cores; threads and packing space come from the warm-up
+     *! @return number of allocations made by the timed iterations
+     */
+    std::size_t bench_gemm_pool()
+    {
+        const std::size_t n = 256;
+
+        calc::matf a(n, n), b(n, n), c(n, n);
+        for (std::size_t i = 0; i != a.size(); ++i)
+        {
+            calc::data(a)[i] = (std::rand() % 2000) / 1000.0f - 1;
+            calc::data(b)[i] = (std::rand() % 2000) / 1000.0f - 1;
+        }
+
+        const std::size_t count = run("gemm 256x256 4 threads", [&]() {
+            calc::gemm(calc::data(a), calc::data(b), calc::data(c), n, n, n, 4);
+            sink = sink + calc::data(c)[0];
+        }, 200);
+
+        return count;
+    }
+
+    /*! Helper
+     *! Times per-vector dot and normalize on an array of vec3f: one call per
+     *! vector against the batched forms on every backend the host can run
+     */
+    void bench_vectors()
+    {
+        const std::size_t size = 1024;
+        const unsigned iterations = 20000;
+
+        static calc::vec3f a[size], b[size], out[size];
+        static float d[size];
+        for (std::size_t i = 0; i != size; ++i)
+        {
+            fill(a[i]);
+            fill(b[i]);
+        }
+
+        auto time = [&](const char* name, const std::function<void()>& f) {
+
+            const auto start = std::chrono::steady_clock::now();
+            for (unsigned i = 0; i != iterations; ++i)
+            {
+                f();
+                sink = sink + d[i % size] + out[i % size][0];
+            }
+            const auto stop = std::chrono::steady_clock::now();
+
+            const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations / size;
+            printf("%-24s %10.2f ns/vec %13.0f vecs/s\n", name, ns, 1e9 / ns);
+        };
+
+        time("dot vec3f", [&]() {
+            for (std::size_t i = 0; i != size; ++i)
+                d[i] = calc::dot(a[i], b[i]);
+        });
+        time("normal vec3f", [&]() {
+            for (std::size_t i = 0; i != size; ++i)
+                out[i] = calc::normal(a[i]);
+        });
+        time("normal_fast vec3f", [&]() {
+            for (std::size_t i = 0; i != size; ++i)
+                out[i] = calc::normal_fast(a[i]);
+        });
+
+        const calc::backend active = calc::get_backend();
+        char name[64];
+
+        for (unsigned k = calc::BACKEND_SSE4; k <= calc::detail::host_backend(); ++k)
+        {
+            calc::set_backend(static_cast<calc::backend>(k));
+            const char* backend = calc::get_backend_name(calc::get_backend());
+
+            snprintf(name, sizeof(name), "dot[] %s", backend);
+            time(name, [&]() { calc::dot(a, b, d, size); });
+
+            snprintf(name, sizeof(name), "normal[] %s", backend);
+            time(name, [&]() { calc::normal(a, out, size); });
+
+            snprintf(name, sizeof(name), "normal_fast[] %s", backend);
+            time(name, [&]() { calc::normal_fast(a, out, size); });
+        }
+
+        calc::set_backend(active);
+    }
+
+    /*! Helper
+     *! Times a projection of 1024 points one at a time through mat4f * vec4f
+     *! against the batched transforms on every backend the host can run
+     */
+    void bench_points()
+    {
+        const std::size_t size = 1024;
+        const unsigned iterations = 20000;
+
+        static calc::vec3f in[size], out[size];
+        for (std::size_t i = 0; i != size; ++i)
+            fill(in[i]);
+
+        calc::mat4f m;
+        fill(m);
+        m(3, 3) += 4;
+
+        auto time = [&](const char* name, const std::function<void()>& f) {
+
+            const auto start = std::chrono::steady_clock::now();
+            for (unsigned i = 0; i != iterations; ++i)
+            {
+                f();
+                sink = sink + out[i % size][0];
+            }
+            const auto stop = std::chrono::steady_clock::now();
+
+            const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations / size;
+            printf("%-24s %10.2f ns/vec %13.0f vecs/s\n", name, ns, 1e9 / ns);
+        };
+
+        time("project mat4f * vec4f", [&]() {
+            for (std::size_t i = 0; i != size; ++i)
+            {
+                const calc::vec4f p = m * calc::vec4f(in[i][0], in[i][1], in[i][2], 1);
+                out[i] = calc::vec3f(p[0] / p[3], p[1] / p[3], p[2] / p[3]);
+            }
+        });
+
+        const calc::backend active = calc::get_backend();
+        char name[64];
+
+        for (unsigned k = calc::BACKEND_SSE4; k <= calc::detail::host_backend(); ++k)
+        {
+            calc::set_backend(static_cast<calc::backend>(k));
+            const char* backend = calc::get_backend_name(calc::get_backend());
+
+            snprintf(name, sizeof(name), "transform_points %s", backend);
+            time(name, [&]() { calc::transform_points(m, in, out, size); });
+
+            snprintf(name, sizeof(name), "transform_dirs %s", backend);
+            time(name, [&]() { calc::transform_dirs(m, in, out, size); });
+
+            snprintf(name, sizeof(name), "project_points %s", backend);
+            time(name, [&]() { calc::project_points(m, in, out, size); });
+        }
+
+        calc::set_backend(active);
+    }
+
+    /*! Helper
+     *! Times f and, where available, counts its instructions
+     *! @return ns per call
+     */
+    template <typename F>
+    double bench_expr(const char* name, F f)
+    {
+        const unsigned iterations = 2000000;
+        for (unsigned i = 0; i != iterations / 100; ++i)
+            f();
+
+        perf_counter counter(PERF_COUNT_HW_INSTRUCTIONS);
+        if (counter.valid()) {
+            counter.start();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (unsigned i = 0; i != iterations; ++i)
+        {
+            f();
+            // Operands are reloaded and results stored every iteration
+            asm volatile("" : : : "memory");
+        }
+
+        const auto stop = std::chrono::steady_clock::now();
+        const long long instructions = counter.valid() ? counter.stop() : -1;
+
+        const double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+        if (instructions >= 0) {
+            printf("%-24s %10.2f ns/op %14.0f ops/s %10.1f instr/op\n", name, ns, 1e9 / ns, double(instructions) / iterations);
+        } else {
+            printf("%-24s %10.2f ns/op %14.0f ops/s %10s instr/op\n", name, ns, 1e9 / ns, "n/a");
+        }
+        return ns;
+    }
+
+    /*! Helper
+     *! Compares eager operators against calc::lazy expressions on per-frame
+     *! transform math: a model chain and an elementwise blend
+     */
+    void bench_exprs()
+    {
+        static calc::mat4f t, rx, ry, rz, out;
+        fill(t);
+        rx = calc::rotate_4x(0.3f);
+        ry = calc::rotate_4y(0.5f);
+        rz = calc::rotate_4z(0.7f);
+
+        bench_expr("chain eager", [&]() { out = t * rx * ry * rz; });
+        bench_expr("chain lazy", [&]() { calc::assign(out, calc::lazy(t) * rx * ry * rz); });
+
+        static calc::mat4f a, b, c;
+        fill(a);
+        fill(b);
+        fill(c);
+
+        bench_expr("a + b * s - c eager", [&]() { out = a + b * 0.5f - c; });
+        bench_expr("a + b * s - c lazy", [&]() { calc::assign(out, calc::lazy(a) + calc::lazy(b) * 0.5f - c); });
+
+        static calc::mat3f d, e, f, g;
+        fill(d);
+        fill(e);
+        fill(f);
+
+        bench_expr("3x3 d * e + f eager", [&]() { g = d * e + f; });
+        bench_expr("3x3 d * e + f lazy", [&]() { calc::assign(g, calc::lazy(d) * e + f); });
+    }
+
+    /*! Helper
+     *! a * s + b - c over arrays, on every backend the host can run: three
+     *! passes through the elementwise functors, with a temporary, against one
+     *! fused pass; the odd length ends in a partial register
+     */
+    void bench_fused()
+    {
+        const calc::backend active = calc::get_backend();
+
+        for (const std::size_t size : {std::size_t(1024), std::size_t(1027)})
+        {
+            static float a[1032], b[1032], c[1032], t[1032], out[1032];
+            for (std::size_t i = 0; i != size; ++i)
+            {
+                a[i] = (std::rand() % 2000) / 1000.0f - 1;
+                b[i] = (std::rand() % 2000) / 1000.0f - 1;
+                c[i] = (std::rand() % 2000) / 1000.0f - 1;
+            }
+
+            for (unsigned bk = calc::BACKEND_SSE4; bk <= calc::detail::host_backend(); ++bk)
+            {
+                calc::set_backend(static_cast<calc::backend>(bk));
+
+                char name[64];
+                snprintf(name, sizeof(name), "a*s+b-c [%zu] 3 pass %s", size, calc::get_backend_name(calc::get_backend()));
+                bench_expr(name, [&]() {
+                    calc::scalar_mul<float>::mul(a, 0.5f, t, size);
+                    calc::matrix_add<float>::add(t, b, t, size);
+                    calc::matrix_sub<float>::sub(t, c, out, size);
+                });
+
+                snprintf(name, sizeof(name), "a*s+b-c [%zu] fused %s", size, calc::get_backend_name(calc::get_backend()));
+                bench_expr(name, [&]() {
+                    calc::elementwise(out, size, calc::elements(a) * 0.5f + calc::elements(b) - calc::elements(c));
+                });
+            }
+        }
+
+        calc::set_backend(active);
+    }
+
+    /*! Helper
+     *! @return shape label, e.g. "4x4" or "3x1d" for double
+     */
+    template <typename T>
+    const char* shape_name(char* out, std::size_t size, const unsigned n, const unsigned m)
+    {
+        snprintf(out, size, "%ux%u%s", n, m, sizeof(T) == sizeof(double) ? "d" : "");
+        return out;
+    }
+
+    /*! Helper
+     *! Benchmarks the elementwise operators of one shape
+     *! @return number of allocations made by the timed iterations
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    std::size_t bench_elementwise()
+    {
+        static calc::matrix<T, N, M> a, b, out;
+        fill(a);
+        fill(b);
+
+        const T scalar = T(0.75);
+        const unsigned iterations = 200000;
+
+        char shape[16], name[64];
+        shape_name<T>(shape, sizeof(shape), N, M);
+
+        std::size_t count = 0;
+
+        snprintf(name, sizeof(name), "add %s", shape);
+        count += run(name, [&]() { out = a + b; sink = sink + calc::data(out)[0]; }, iterations);
+
+        snprintf(name, sizeof(name), "sub %s", shape);
+        count += run(name, [&]() { out = a - b; sink = sink + calc::data(out)[0]; }, iterations);
+
+        snprintf(name, sizeof(name), "schur %s", shape);
+        count += run(name, [&]() {
+            calc::detail::schur_mul<T>::mul(calc::data(a), calc::data(b), calc::data(out), out.size());
+            sink = sink + calc::data(out)[0];
+        }, iterations);
+
+        snprintf(name, sizeof(name), "mul %s * s", shape);
+        count += run(name, [&]() { out = a * scalar; sink = sink + calc::data(out)[0]; }, iterations);
+
+        snprintf(name, sizeof(name), "div %s / s", shape);
+        count += run(name, [&]() { out = a / scalar; sink = sink + calc::data(out)[0]; }, iterations);
+
+        return count;
+    }
+
+    /*! Helper
+     *! Benchmarks every operator of an NxN shape: elementwise, NxN * NxN
+     *! and NxN * Nx1
+     *! @return number of allocations made by the timed iterations
+     */
+    template <typename T,
+              unsigned N>
+    std::size_t bench_square()
+    {
+        char shape[16], name[64];
+        shape_name<T>(shape, sizeof(shape), N, N);
+
+        std::size_t count = bench_elementwise<T, N, N>();
+
+        snprintf(name, sizeof(name), "mul %s * %ux%u", shape, N, N);
+        count += bench_mul<N, N, N, T>(name);
+
+        snprintf(name, sizeof(name), "mul %s * %ux1", shape, N);
+        count += bench_mul<N, N, 1, T>(name);
+
+        return count;
+    }
+
+    /*! Helper
+     *! Benchmarks every shape from 2x2 to 8x8 and the vectors of the same
+     *! lengths
+     *! @return number of allocations made by the timed iterations
+     */
+    template <typename T>
+    std::size_t bench_shapes()
+    {
+        std::size_t count = 0;
+
+        count += bench_square<T, 2>();
+        count += bench_square<T, 3>();
+        count += bench_square<T, 4>();
+        count += bench_square<T, 5>();
+        count += bench_square<T, 6>();
+        count += bench_square<T, 7>();
+        count += bench_square<T, 8>();
+        printf("\n");
+
+        count += bench_elementwise<T, 2, 1>();
+        count += bench_elementwise<T, 3, 1>();
+        count += bench_elementwise<T, 4, 1>();
+        count += bench_elementwise<T, 5, 1>();
+        count += bench_elementwise<T, 6, 1>();
+        count += bench_elementwise<T, 7, 1>();
+        count += bench_elementwise<T, 8, 1>();
+        printf("\n");
+
+        return count;
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Out of line, or GCC sees free() of a pointer from operator new
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+/*! Entry point
+ *! calc_bench [--gemm]: the benchmarks of every operator and shape on the
+ *! active backend; --gemm runs only the large dynamic products. Results are
+ *! checked against the scalar build by calc_test, not here
+ */
+int main(int argc, char** argv)
+{
+    const bool gemmOnly = argc == 2 && std::strcmp(argv[1], "--gemm") == 0;
+
+    if (argc > 2 || (argc == 2 && !gemmOnly))
+    {
+        const bool help = std::strcmp(argv[1], "--help") == 0 || std::strcmp(argv[1], "-h") == 0;
+        fprintf(help ? stdout : stderr, "usage: %s [--gemm]\n", argv[0]);
+        return help ? 0 : 2;
+    }
+
+    printf("backend: %s\n\n", calc::get_backend_name(calc::get_backend()));
+
+    if (gemmOnly)
+    {
+        bench_gemm();
+        return 0;
+    }
+
+    // Broadcast kernels against the hadd formulation they replaced
+    bench_kernels("mul 4x4 * 4x4", &hadd_kernels::mul_4x4x4, &calc::detail::kernel_table::mul_4x4x4);
+    bench_kernels("mul 4x4 * 4x1", &hadd_kernels::mul_4x4x1, &calc::detail::kernel_table::mul_4x4x1);
+    bench_kernels("mul 3x3 * 3x3", &hadd_kernels::mul_3x3x3, &calc::detail::kernel_table::mul_3x3x3);
+    bench_kernels("mul 3x3 * 3x1", &hadd_kernels::mul_3x3x1, &calc::detail::kernel_table::mul_3x3x1);
+    printf("\n");
+
+    // Vectorized sin/cos against libm
+    bench_sincos();
+    printf("\n");
+
+    // Zero-filled result temporaries against calc::uninit, and the per-frame
+    // camera and box math built from them
+    bench_uninit<4, 4, 4>("mul 4x4 * 4x4", &calc::detail::kernel_table::mul_4x4x4);
+    bench_uninit<4, 4, 1>("mul 4x4 * 4x1", &calc::detail::kernel_table::mul_4x4x1);
+    bench_uninit<3, 3, 3>("mul 3x3 * 3x3", &calc::detail::kernel_table::mul_3x3x3);
+    bench_frame();
+    printf("\n");
+
+    // Row-major to column-major (device) order, one and many at a time
+    bench_transpose();
+    printf("\n");
+
+    // General, affine and rigid inverses (Camera::unproject)
+    bench_inverse();
+    printf("\n");
+
+    // Vector building blocks, one at a time and batched
+    bench_vectors();
+    printf("\n");
+
+    // Arrays of points through one matrix (culling, picking, debug lines)
+    bench_points();
+    printf("\n");
+
+    // Temporaries of eager operators against fused lazy expressions
+    bench_exprs();
+    printf("\n");
+
+    // Chains over arrays: one pass per operator against one fused pass
+    bench_fused();
+    printf("\n");
+
+    // Every operator, 2x2 to 8x8 and vectors; steady state must not allocate
+    std::size_t count = 0;
+    count += bench_shapes<float>();
+    count += bench_shapes<double>();
+
+    // Dynamic-size products (no fixed-size kernel)
+    count += bench_mul<2, 2, 2>("mul 2x2 * 2x2");
+    count += bench_mul<5, 7, 3>("mul 5x7 * 7x3");
+    count += bench_mul<6, 6, 6>("mul 6x6 * 6x6");
+    count += bench_mul<8, 8, 8>("mul 8x8 * 8x8");
+    count += bench_mul<7, 5, 1>("mul 7x5 * 5x1");
+    printf("\n");
+
+    count += bench_mul<16, 16, 16>("mul 16x16 * 16x16");
+    count += bench_mul<5, 7, 3, double>("mul 5x7d * 7x3d");
+    count += bench_mul<16, 16, 16, double>("mul 16x16d * 16x16d");
+    count += bench_gemm_pool();
+
+    if (count != 0)
+    {
+        printf("\nerror: %zu allocations in steady-state products\n", count);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,816 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "glad/glad.h"
+
+#include "arena.hpp"
+#include "box.hpp"
+#include "draw_instanced_no_texture.hpp"
+#include "draw_instanced_with_texture.hpp"
+#include "drawable.hpp"
+#include "grid_square.hpp"
+#include "render_queue.hpp"
+#include "square.hpp"
+
+namespace {
+
+    /*! Helper
+     *! Headless OpenGL 4.5 core context on the Mesa surfaceless platform
+     *! (llvmpipe without a GPU); valid() is false where there is none
+     */
+    class gl_context {
+
+        EGLDisplay display_;
+        EGLContext context_;
+
+    public:
+
+        gl_context() : display_(EGL_NO_DISPLAY)
+                     , context_(EGL_NO_CONTEXT) {
+
+            display_ = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, nullptr, nullptr)) {
+                return;
+            }
+
+            eglBindAPI(EGL_OPENGL_API);
+
+            const EGLint attributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 4,
+                EGL_CONTEXT_MINOR_VERSION, 5,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+            };
+
+            context_ = eglCreateContext(display_, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+            if (context_ == EGL_NO_CONTEXT || !eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+                context_ = EGL_NO_CONTEXT;
+                return;
+            }
+
+            if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+                context_ = EGL_NO_CONTEXT;
+            }
+        }
+
+        ~gl_context() {
+
+            if (display_ != EGL_NO_DISPLAY) {
+                eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                if (context_ != EGL_NO_CONTEXT) {
+                    eglDestroyContext(display_, context_);
+                }
+                eglTerminate(display_);
+            }
+        }
+
+        bool valid() const {
+            return context_ != EGL_NO_CONTEXT;
+        }
+    };
+
+    /*! Helper
+     *! GL calls made since the last reset(), counted by wrappers installed
+     *! over the glad entry points
+     */
+    struct gl_calls {
+
+        static std::size_t bind;
+        static std::size_t upload;
+        static std::size_t map;
+        static std::size_t wait;
+        static std::size_t finish;
+        static std::size_t copy;
+        static std::size_t buffers;
+        static std::size_t arrays;
+        static std::size_t arrayBinds;
+        static std::size_t programBinds;
+        static std::size_t textureBinds;
+        static std::size_t draws;
+        // Base instance of the last instanced draw
+        static GLuint baseInstance;
+        // Fence waits report GL_WAIT_FAILED without waiting
+        static bool failWaits;
+
+        static PFNGLBINDBUFFERPROC bindBuffer;
+        static PFNGLBUFFERSUBDATAPROC bufferSubData;
+        static PFNGLMAPBUFFERRANGEPROC mapBufferRange;
+        static PFNGLCLIENTWAITSYNCPROC clientWaitSync;
+        static PFNGLFINISHPROC finishAll;
+        static PFNGLCOPYBUFFERSUBDATAPROC copyBufferSubData;
+        static PFNGLGENBUFFERSPROC genBuffers;
+        static PFNGLGENVERTEXARRAYSPROC genVertexArrays;
+        static PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+        static PFNGLUSEPROGRAMPROC useProgram;
+        static PFNGLBINDTEXTUREPROC bindTexture;
+        static PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced;
+        static PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC drawArraysInstancedBaseInstance;
+
+        static void APIENTRY count_bind(GLenum target, GLuint buffer) {
+            ++bind;
+            bindBuffer(target, buffer);
+        }
+
+        static void APIENTRY count_upload(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+            ++upload;
+            bufferSubData(target, offset, size, data);
+        }
+
+        static void* APIENTRY count_map(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+            ++map;
+            return mapBufferRange(target, offset, length, access);
+        }
+
+        // Only waits that did not find the fence signalled count
+        static GLenum APIENTRY count_wait(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+            const GLenum result = failWaits ? GL_WAIT_FAILED : clientWaitSync(sync, flags, timeout);
+            wait += (result != GL_ALREADY_SIGNALED);
+            return result;
+        }
+
+        static void APIENTRY count_finish() {
+            ++finish;
+            finishAll();
+        }
+
+        static void APIENTRY count_copy(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+            ++copy;
+            copyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+        }
+
+        static void APIENTRY count_buffers(GLsizei n, GLuint* handles) {
+            buffers += n;
+            genBuffers(n, handles);
+        }
+
+        static void APIENTRY count_arrays(GLsizei n, GLuint* handles) {
+            arrays += n;
+            genVertexArrays(n, handles);
+        }
+
+        static void APIENTRY count_array_bind(GLuint array) {
+            ++arrayBinds;
+            bindVertexArray(array);
+        }
+
+        static void APIENTRY count_program_bind(GLuint program) {
+            ++programBinds;
+            useProgram(program);
+        }
+
+        static void APIENTRY count_texture_bind(GLenum target, GLuint texture) {
+            ++textureBinds;
+            bindTexture(target, texture);
+        }
+
+        static void APIENTRY draw(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+            ++draws;
+            baseInstance = 0;
+            drawArraysInstanced(mode, first, count, instances);
+        }
+
+        static void APIENTRY draw_base(GLenum mode, GLint first, GLsizei count, GLsizei instances, GLuint base) {
+            ++draws;
+            baseInstance = base;
+            drawArraysInstancedBaseInstance(mode, first, count, instances, base);
+        }
+
+        static void install() {
+
+            bindBuffer = glad_glBindBuffer;
+            bufferSubData = glad_glBufferSubData;
+            mapBufferRange = glad_glMapBufferRange;
+            clientWaitSync = glad_glClientWaitSync;
+            finishAll = glad_glFinish;
+            copyBufferSubData = glad_glCopyBufferSubData;
+            genBuffers = glad_glGenBuffers;
+            genVertexArrays = glad_glGenVertexArrays;
+            bindVertexArray = glad_glBindVertexArray;
+            useProgram = glad_glUseProgram;
+            bindTexture = glad_glBindTexture;
+            drawArraysInstanced = glad_glDrawArraysInstanced;
+            drawArraysInstancedBaseInstance = glad_glDrawArraysInstancedBaseInstance;
+
+            glad_glBindBuffer = &count_bind;
+            glad_glBufferSubData = &count_upload;
+            glad_glMapBufferRange = &count_map;
+            glad_glClientWaitSync = &count_wait;
+            glad_glFinish = &count_finish;
+            glad_glCopyBufferSubData = &count_copy;
+            glad_glGenBuffers = &count_buffers;
+            glad_glGenVertexArrays = &count_arrays;
+            glad_glBindVertexArray = &count_array_bind;
+            glad_glUseProgram = &count_program_bind;
+            glad_glBindTexture = &count_texture_bind;
+            glad_glDrawArraysInstanced = &draw;
+            glad_glDrawArraysInstancedBaseInstance = &draw_base;
+        }
+
+        static void reset() {
+            bind = upload = map = wait = finish = copy = buffers = arrays = arrayBinds = 0;
+            programBinds = textureBinds = draws = 0;
+        }
+    };
+
+    std::size_t gl_calls::bind = 0;
+    std::size_t gl_calls::upload = 0;
+    std::size_t gl_calls::map = 0;
+    std::size_t gl_calls::wait = 0;
+    std::size_t gl_calls::finish = 0;
+    std::size_t gl_calls::copy = 0;
+    std::size_t gl_calls::buffers = 0;
+    std::size_t gl_calls::arrays = 0;
+    std::size_t gl_calls::arrayBinds = 0;
+    std::size_t gl_calls::programBinds = 0;
+    std::size_t gl_calls::textureBinds = 0;
+    std::size_t gl_calls::draws = 0;
+    GLuint gl_calls::baseInstance = 0;
+    bool gl_calls::failWaits = false;
+
+    PFNGLBINDBUFFERPROC gl_calls::bindBuffer = nullptr;
+    PFNGLBUFFERSUBDATAPROC gl_calls::bufferSubData = nullptr;
+    PFNGLMAPBUFFERRANGEPROC gl_calls::mapBufferRange = nullptr;
+    PFNGLCLIENTWAITSYNCPROC gl_calls::clientWaitSync = nullptr;
+    PFNGLFINISHPROC gl_calls::finishAll = nullptr;
+    PFNGLCOPYBUFFERSUBDATAPROC gl_calls::copyBufferSubData = nullptr;
+    PFNGLGENBUFFERSPROC gl_calls::genBuffers = nullptr;
+    PFNGLGENVERTEXARRAYSPROC gl_calls::genVertexArrays = nullptr;
+    PFNGLBINDVERTEXARRAYPROC gl_calls::bindVertexArray = nullptr;
+    PFNGLUSEPROGRAMPROC gl_calls::useProgram = nullptr;
+    PFNGLBINDTEXTUREPROC gl_calls::bindTexture = nullptr;
+    PFNGLDRAWARRAYSINSTANCEDPROC gl_calls::drawArraysInstanced = nullptr;
+    PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC gl_calls::drawArraysInstancedBaseInstance = nullptr;
+
+    /*! Helper
+     *! Offscreen colour target the benchmark draws into, so that uploads
+     *! compete with draws still reading the buffers
+     */
+    void bind_target(const int width, const int height)
+    {
+        GLuint fbo = 0, rbo = 0;
+
+        glGenRenderbuffers(1, &rbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo);
+
+        glViewport(0, 0, width, height);
+    }
+
+    // Instances of the drawables under test (the wall and grass tiles run to thousands)
+    const unsigned INSTANCES = 4096;
+
+    /*! Helper
+     *! The per-instance upload render::modify made before the shadow copy:
+     *! one bind and one glBufferSubData per index
+     */
+    void modify_each(unsigned buffer, GLintptr offset, const float* mat, const unsigned* instanceIndices, unsigned count)
+    {
+        static const unsigned nbytes = render::INSTANCE_SIZE * sizeof(float);
+
+        for (unsigned i = 0; i != count; ++i)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferSubData(GL_ARRAY_BUFFER, offset + instanceIndices[i] * nbytes, nbytes, mat + i * render::INSTANCE_SIZE);
+        }
+    }
+
+    /*! Helper
+     *! Where the last draw read its instances: the buffer and attribute
+     *! pointer of the vertex array it left bound, plus its base instance
+     */
+    void instance_storage(GLint& buffer, GLintptr& offset)
+    {
+        void* pointer = nullptr;
+
+        glGetVertexAttribiv(2, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+        glGetVertexAttribPointerv(2, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+
+        offset = reinterpret_cast<GLintptr>(pointer) + gl_calls::baseInstance * render::INSTANCE_SIZE * sizeof(float);
+    }
+
+    /*! Helper
+     *! Compares the instances the last draw read with what was written
+     *! @return number of differing floats
+     */
+    unsigned check_instances(const std::vector<float>& expected)
+    {
+        std::vector<float> actual(expected.size());
+
+        GLint buffer = 0;
+        GLintptr offset = 0;
+        instance_storage(buffer, offset);
+
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glGetBufferSubData(GL_ARRAY_BUFFER, offset, actual.size() * sizeof(float), actual.data());
+
+        unsigned failures = 0;
+        for (std::size_t i = 0; i != expected.size(); ++i)
+            failures += (actual[i] != expected[i]);
+        return failures;
+    }
+
+    /*! Helper
+     *! Times frame() over a number of frames, issued back to back as a
+     *! render loop would and finished with one glFinish, and prints the GL
+     *! calls per frame
+     */
+    void run(const char* name, const std::function<void()>& frame, unsigned frames = 200)
+    {
+        frame();
+        glFinish();
+
+        gl_calls::reset();
+        const auto start = std::chrono::steady_clock::now();
+
+        for (unsigned i = 0; i != frames; ++i)
+            frame();
+        glFinish();
+
+        const auto stop = std::chrono::steady_clock::now();
+
+        const double us = std::chrono::duration<double, std::micro>(stop - start).count() / frames;
+        printf("%-36s %10.2f us/frame %7.1f binds %7.1f uploads %5.1f maps %5.1f waits\n",
+               name, us,
+               double(gl_calls::bind) / frames,
+               double(gl_calls::upload) / frames,
+               double(gl_calls::map) / frames,
+               double(gl_calls::wait) / frames);
+    }
+
+    /*! Helper
+     *! Writes count instances per frame, at the indices given, one call per
+     *! index as before against scatter() and one flush(); the buffer must
+     *! match the shadow afterwards, and a batch with an index past the last
+     *! instance must throw without writing
+     *! @return number of failures
+     */
+    unsigned bench_scatter(const char* name, const std::vector<unsigned>& indices)
+    {
+        render::Box box(nullptr, 0, INSTANCES);
+
+        std::vector<float> initial(INSTANCES * render::INSTANCE_SIZE);
+        for (std::size_t i = 0; i != initial.size(); ++i)
+            initial[i] = float(i);
+
+        box.reset(initial.data(), INSTANCES);
+        box.flush();
+
+        std::vector<float> mats(indices.size() * render::INSTANCE_SIZE);
+        for (std::size_t i = 0; i != mats.size(); ++i)
+            mats[i] = float(std::rand() % 1000);
+
+        // The box's instances, for writing them one at a time
+        GLint buffer = 0;
+        GLintptr offset = 0;
+
+        box.draw();
+        instance_storage(buffer, offset);
+
+        char label[64];
+
+        snprintf(label, sizeof(label), "%s per index", name);
+        run(label, [&]() {
+            modify_each(buffer, offset, mats.data(), indices.data(), indices.size());
+        });
+
+        snprintf(label, sizeof(label), "%s scatter + flush", name);
+        run(label, [&]() {
+            box.scatter(mats.data(), indices.data(), indices.size());
+            box.flush();
+        });
+
+        std::vector<float> expected = initial;
+        for (std::size_t i = 0; i != indices.size(); ++i)
+            std::copy(mats.begin() + i * render::INSTANCE_SIZE,
+                      mats.begin() + (i + 1) * render::INSTANCE_SIZE,
+                      expected.begin() + indices[i] * render::INSTANCE_SIZE);
+
+        // An index past the last instance fails the whole batch before any write
+        std::vector<unsigned> bad = indices;
+        bad.back() = INSTANCES;
+
+        bool thrown = false;
+        try {
+            box.scatter(mats.data(), bad.data(), bad.size());
+        }
+        catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        box.flush();
+
+        // Vertex array state for check_instances
+        box.draw();
+
+        unsigned failures = check_instances(expected);
+        if (failures != 0) {
+            printf("check %s: %u floats differ from the shadow copy\n", name, failures);
+        }
+
+        if (!thrown)
+        {
+            printf("check %s: scatter past the last instance did not throw\n", name);
+            ++failures;
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Rewrites every instance and draws, each frame, through mode; stream
+     *! without persistent mapping where persistent is false
+     *! @return number of failures
+     */
+    unsigned bench_stream(const char* name, const unsigned instances, const render::upload_mode mode, const bool persistent = true)
+    {
+        const int glVersion44 = GLAD_GL_VERSION_4_4, bufferStorage = GLAD_GL_ARB_buffer_storage;
+        GLAD_GL_VERSION_4_4 = glVersion44 && persistent;
+        GLAD_GL_ARB_buffer_storage = bufferStorage && persistent;
+
+        render::Box box(nullptr, 0, instances, mode);
+        GLAD_GL_VERSION_4_4 = glVersion44;
+        GLAD_GL_ARB_buffer_storage = bufferStorage;
+
+        // Two sets of transforms, alternated so that every frame changes;
+        // off screen, which keeps llvmpipe from rasterizing
+        std::vector<float> mats[2];
+        for (std::vector<float>& m : mats)
+        {
+            m.resize(instances * render::INSTANCE_SIZE);
+            for (float& x : m)
+                x = 100.0f + float(std::rand() % 1000);
+        }
+
+        // Draws are slow on llvmpipe; fewer frames
+        unsigned frame = 0;
+        run(name, [&]() {
+            box.reset(mats[++frame % 2].data(), instances);
+            box.flush();
+            box.draw();
+        }, 50);
+
+        const unsigned failures = check_instances(mats[frame % 2]);
+        if (failures != 0) {
+            printf("check %s: %u floats differ from the shadow copy\n", name, failures);
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Streams through a persistent ring whose fence waits all fail: each
+     *! must fall back to glFinish, and the buffer still match the shadow
+     *! @return number of failures
+     */
+    unsigned check_failed_waits()
+    {
+        if (!GLAD_GL_VERSION_4_4 && !GLAD_GL_ARB_buffer_storage) {
+            return 0;
+        }
+
+        render::Box box(nullptr, 0, 1, render::UPLOAD_STREAM);
+        std::vector<float> mat(render::INSTANCE_SIZE, 1.0f);
+
+        gl_calls::reset();
+        gl_calls::failWaits = true;
+
+        // Twice round the ring, so that every segment is waited for
+        for (unsigned frame = 0; frame != 2 * render::STREAM_FRAMES; ++frame)
+        {
+            mat[0] = float(frame);
+            box.reset(mat.data(), 1);
+            box.flush();
+            box.draw();
+        }
+
+        gl_calls::failWaits = false;
+
+        unsigned failures = check_instances(mat);
+        if (failures != 0) {
+            printf("check failed waits: %u floats differ from the shadow copy\n", failures);
+        }
+
+        if (gl_calls::wait == 0 || gl_calls::finish != gl_calls::wait)
+        {
+            printf("check failed waits: %zu waits failed, %zu glFinish calls\n", gl_calls::wait, gl_calls::finish);
+            ++failures;
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Spawns INSTANCES instances, 16 a frame, into a box allocated with
+     *! initial room for initial, then cuts it to 100 and shrinks it; the
+     *! buffer must hold the instances after both
+     *! @return number of failures
+     */
+    unsigned bench_growth(const char* name, const unsigned initial, const render::upload_mode mode)
+    {
+        static const unsigned perFrame = 16;
+
+        render::Box box(nullptr, 0, initial, mode);
+
+        std::vector<float> mats(INSTANCES * render::INSTANCE_SIZE);
+        for (float& x : mats)
+            x = 100.0f + float(std::rand() % 1000);
+
+        gl_calls::reset();
+        const auto start = std::chrono::steady_clock::now();
+
+        for (unsigned i = 0; i != INSTANCES; i += perFrame)
+        {
+            box.push_back(mats.data() + i * render::INSTANCE_SIZE, perFrame);
+            box.flush();
+        }
+        glFinish();
+
+        const auto stop = std::chrono::steady_clock::now();
+
+        const double us = std::chrono::duration<double, std::micro>(stop - start).count() / (INSTANCES / perFrame);
+        printf("%-36s %10.2f us/frame %7u capacity %3u reallocations %3zu copies\n",
+               name, us, box.capacity(), box.reallocations(), gl_calls::copy);
+
+        box.draw();
+        unsigned failures = check_instances(mats);
+
+        box.reset(mats.data(), 100);
+        box.shrink_to_fit();
+        box.flush();
+
+        printf("%-36s %10s %16u capacity %3u reallocations\n", "  cut to 100, shrink_to_fit", "", box.capacity(), box.reallocations());
+
+        mats.resize(100 * render::INSTANCE_SIZE);
+
+        box.draw();
+        failures += check_instances(mats);
+        failures += (box.capacity() != 100);
+
+        if (failures != 0) {
+            printf("check %s: %u failures\n", name, failures);
+        }
+
+        return failures;
+    }
+    /*! Helper
+     *! Builds the application's drawables (three streamed ball skins, the
+     *! wall, two grass layers and the grid) and draws them each frame;
+     *! without base instances each keeps a vertex array of its own
+     *! @return number of failures
+     */
+    unsigned bench_scene(const char* name, const bool baseInstance)
+    {
+        static const unsigned tiles = 1024;
+        static const unsigned textures[1] = { 0 };
+
+        const int glVersion42 = GLAD_GL_VERSION_4_2;
+        GLAD_GL_VERSION_4_2 = glVersion42 && baseInstance;
+
+        const unsigned meshBytes = render::vertex_arena().used();
+        gl_calls::reset();
+
+        render::Box balls[3] = {
+            render::Box(textures, 1, 1, render::UPLOAD_STREAM),
+            render::Box(textures, 1, 1, render::UPLOAD_STREAM),
+            render::Box(textures, 1, 1, render::UPLOAD_STREAM)
+        };
+
+        render::Box wall(textures, 1, tiles);
+        render::Square grass(textures, 1, tiles);
+        render::Square dryGrass(textures, 1, tiles);
+        render::GridSquare grid(tiles);
+
+        GLAD_GL_VERSION_4_2 = glVersion42;
+
+        printf("%-36s %7zu buffers %3zu vertex arrays %5u mesh bytes added\n",
+               name, gl_calls::buffers, gl_calls::arrays, render::vertex_arena().used() - meshBytes);
+
+        std::vector<float> mats(tiles * render::INSTANCE_SIZE);
+        for (float& x : mats)
+            x = 100.0f + float(std::rand() % 1000);
+
+        render::Drawable* drawables[] = { &grid, &wall, &dryGrass, &grass, &balls[0], &balls[1], &balls[2] };
+        for (render::Drawable* d : drawables)
+            d->reset(mats.data(), (d == &balls[0] || d == &balls[1] || d == &balls[2]) ? 1 : tiles);
+
+        char label[64];
+        snprintf(label, sizeof(label), "  flush + draw all");
+
+        run(label, [&]() {
+            balls[0].modify(mats.data(), 0);
+            for (render::Drawable* d : drawables)
+            {
+                d->flush();
+                d->draw();
+            }
+        }, 20);
+
+        printf("%-36s %10s %7.1f vertex array binds\n", "", "", double(gl_calls::arrayBinds) / 20);
+
+        unsigned failures = 0;
+
+        wall.draw();
+        failures += check_instances(mats);
+        grass.draw();
+        failures += check_instances(mats);
+
+        if (failures != 0) {
+            printf("check %s: %u failures\n", name, failures);
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Draws the application's frame, the grid with its own program and the
+     *! rest textured, one object after another as before against submitting
+     *! it to a render queue; both must issue the same draws, and the queue's
+     *! statistics must match the calls counted
+     *! @return number of failures
+     */
+    unsigned bench_queue(const char* name, DrawInstancedNoTexture& gridProgram, DrawInstancedWithTexture& mainProgram)
+    {
+        static const unsigned tiles = 1024;
+
+        // Three ball skins, the wall, grass and dry grass
+        GLuint textures[6];
+        glGenTextures(6, textures);
+
+        render::Box balls[3] = {
+            render::Box(&textures[0], 1, 1, render::UPLOAD_STREAM),
+            render::Box(&textures[1], 1, 1, render::UPLOAD_STREAM),
+            render::Box(&textures[2], 1, 1, render::UPLOAD_STREAM)
+        };
+
+        render::Box wall(&textures[3], 1, tiles);
+        render::Square grass(&textures[4], 1, tiles);
+        render::Square dryGrass(&textures[5], 1, tiles);
+        render::GridSquare grid(tiles);
+
+        std::vector<float> mats(tiles * render::INSTANCE_SIZE);
+        for (float& x : mats)
+            x = 100.0f + float(std::rand() % 1000);
+
+        render::Drawable* scene[] = { &wall, &dryGrass, &grass, &balls[0], &balls[1], &balls[2] };
+        for (render::Drawable* d : scene)
+            d->reset(mats.data(), (d == &balls[0] || d == &balls[1] || d == &balls[2]) ? 1 : tiles);
+
+        grid.reset(mats.data(), tiles);
+        grid.flush();
+        for (render::Drawable* d : scene)
+            d->flush();
+
+        static const unsigned frames = 20;
+        char label[64];
+
+        snprintf(label, sizeof(label), "%s, draw each", name);
+        run(label, [&]() {
+            gridProgram.use();
+            grid.draw();
+            mainProgram.use();
+            for (render::Drawable* d : scene)
+                d->draw();
+        }, frames);
+
+        const std::size_t draws = gl_calls::draws;
+
+        printf("%-36s %10s %7.1f program %5.1f array %5.1f texture binds\n", "", "",
+               double(gl_calls::programBinds) / frames,
+               double(gl_calls::arrayBinds) / frames,
+               double(gl_calls::textureBinds) / frames);
+
+        render::RenderQueue queue;
+
+        // Submitted in the application's order; the balls interleave with
+        // the tiles as a scene with several of them would
+        snprintf(label, sizeof(label), "%s, render queue", name);
+        run(label, [&]() {
+            grid.submit(queue, gridProgram.handle());
+            wall.submit(queue, mainProgram.handle());
+            balls[0].submit(queue, mainProgram.handle());
+            dryGrass.submit(queue, mainProgram.handle());
+            balls[1].submit(queue, mainProgram.handle());
+            grass.submit(queue, mainProgram.handle());
+            balls[2].submit(queue, mainProgram.handle());
+            queue.execute();
+        }, frames);
+
+        const render::render_stats& stats = queue.stats();
+        printf("%-36s %10s %7.1f program %5.1f array %5.1f texture binds\n", "", "",
+               double(gl_calls::programBinds) / frames,
+               double(gl_calls::arrayBinds) / frames,
+               double(gl_calls::textureBinds) / frames);
+        printf("%-36s %10s %7u program %5u array %5u texture binds saved\n", "", "",
+               stats.programBindsSaved, stats.arrayBindsSaved, stats.textureBindsSaved);
+
+        unsigned failures = 0;
+
+        failures += (gl_calls::draws != draws);
+        failures += (stats.packets != 7);
+        failures += (stats.programBinds * frames != gl_calls::programBinds);
+        failures += (stats.arrayBinds * frames != gl_calls::arrayBinds);
+        failures += (stats.textureBinds * frames != gl_calls::textureBinds);
+
+        glDeleteTextures(6, textures);
+
+        if (failures != 0) {
+            printf("check %s: %u failures\n", name, failures);
+        }
+
+        return failures;
+    }
+}
+
+int main()
+{
+    setvbuf(stdout, nullptr, _IONBF, 0);
+
+    gl_context context;
+    if (!context.valid())
+    {
+        printf("no OpenGL 4.5 context (EGL surfaceless platform unavailable)\n");
+        return 0;
+    }
+
+    printf("renderer: %s\n\n", glGetString(GL_RENDERER));
+    gl_calls::install();
+
+    bind_target(256, 256);
+
+    DrawInstancedWithTexture program;
+    program.use();
+
+    std::vector<unsigned> all(INSTANCES), odd, block, few;
+    for (unsigned i = 0; i != INSTANCES; ++i)
+        all[i] = i;
+
+    for (unsigned i = 1; i < INSTANCES; i += 2)
+        odd.push_back(i);
+    for (unsigned i = 1024; i != 1024 + 256; ++i)
+        block.push_back(i);
+
+    std::random_shuffle(all.begin(), all.end());
+    few.assign(all.begin(), all.begin() + 64);
+
+    // Dirty-range coalescing: one call per index against merged uploads
+    unsigned failures = 0;
+    failures += bench_scatter("64 random", few);
+    failures += bench_scatter("256 adjacent", block);
+    failures += bench_scatter("every other", odd);
+    failures += bench_scatter("all, shuffled", all);
+    printf("\n");
+
+    // Per-frame instances: synchronous uploads against the fenced ring
+    failures += bench_stream("ball, subdata", 1, render::UPLOAD_SUBDATA);
+    failures += bench_stream("ball, stream persistent", 1, render::UPLOAD_STREAM);
+    failures += bench_stream("ball, stream orphan", 1, render::UPLOAD_STREAM, false);
+    failures += bench_stream("256 dynamic, subdata", 256, render::UPLOAD_SUBDATA);
+    failures += bench_stream("256 dynamic, stream persistent", 256, render::UPLOAD_STREAM);
+    failures += bench_stream("256 dynamic, stream orphan", 256, render::UPLOAD_STREAM, false);
+    failures += check_failed_waits();
+    printf("\n");
+
+    // Growth: preallocated against doubling from one instance
+    failures += bench_growth("spawn 4096, preallocated", INSTANCES, render::UPLOAD_SUBDATA);
+    failures += bench_growth("spawn 4096, growing", 1, render::UPLOAD_SUBDATA);
+    failures += bench_growth("spawn 4096, growing, stream", 1, render::UPLOAD_STREAM);
+    printf("\n");
+
+    // Arenas: one vertex array per layout and base instances, against one
+    // vertex array per drawable pointed at its range. Whichever scene is
+    // built first runs slower here, in either order: a warm-up round first
+    failures += bench_scene("scene, warm-up", true);
+    failures += bench_scene("scene, base instance", true);
+    failures += bench_scene("scene, vertex array each", false);
+    printf("\n");
+
+    // Render queue: binds issued per frame against drawing object by object
+    DrawInstancedNoTexture gridProgram;
+    failures += bench_queue("scene", gridProgram, program);
+
+    const GLenum error = glGetError();
+    if (error != GL_NO_ERROR)
+    {
+        printf("\nerror: GL error 0x%x\n", error);
+        return 1;
+    }
+
+    if (failures != 0)
+    {
+        printf("\nerror: instance buffers differ from their shadow copies\n");
+        return 1;
+    }
+
+    return 0;
+}
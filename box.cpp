@@ -7,7 +7,7 @@
 
 namespace {
     // Box shape and texture vertices
-    static const float VERTICES__[180] = {
+    static constexpr float VERTICES__[180] = {
         -0.5f, -0.5f, -0.5f,    0.0f, 0.0f,
         +0.5f, -0.5f, -0.5f,    1.0f, 0.0f,
         +0.5f,  0.5f, -0.5f,    1.0f, 1.0f,
@@ -52,66 +52,23 @@ namespace {
     };
 }
 
-render::Box::Box(const unsigned* taoSrc, unsigned taoCount, unsigned instanceSizeMax)
+render::Box::Box(const unsigned* taoSrc, unsigned taoCount, unsigned instanceSizeMax, upload_mode mode)
 {
     ::memset(&tao_, 0, sizeof(tao_));
-    ::memset(&vbo_, 0, sizeof(vbo_));
+    vbo_ = vbo();
 
     // Copy texture handles
     if (taoSrc != nullptr) {
         ::memcpy(tao_.tao, taoSrc, (tao_.size = taoCount) * sizeof(unsigned));
     }
 
-    // Initialize OpenGL buffers
-    glGenVertexArrays(1, &vbo_.mesh);
-    glBindVertexArray(vbo_.mesh);
-
-    glGenBuffers(1, &vbo_.vertex);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_.vertex);
-
-    // Add vertices
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VERTICES__), VERTICES__, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(0));
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-
-    // Instancing
-    glGenBuffers(1, &vbo_.instance);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_.instance);
-
-    // Null buffer
-    glBufferData(GL_ARRAY_BUFFER, instanceSizeMax * 16 * sizeof(float), nullptr, GL_STREAM_DRAW);
-
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(0));
-
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(4  * sizeof(float)));
-
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(8  * sizeof(float)));
-
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(12 * sizeof(float)));
-
-    glVertexAttribDivisor(2, 1);
-    glVertexAttribDivisor(3, 1);
-    glVertexAttribDivisor(4, 1);
-    glVertexAttribDivisor(5, 1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Mesh, instance storage and vertex array
+    render::allocate(vbo_, VERTICES__, sizeof(VERTICES__), {3, 2}, instanceSizeMax, mode);
 }
 
 void render::Box::draw() const
 {
-    static const unsigned vertexSize = sizeof(VERTICES__) / sizeof(float) / 5;
-
     // Load textures...
-    glBindVertexArray(vbo_.mesh);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     unsigned i = 0;
@@ -122,7 +79,13 @@ void render::Box::draw() const
     }
 
     // Draw...
-    glDrawArraysInstanced(GL_TRIANGLES, 0, vertexSize, vbo_.instanceCount);
+    render::draw(vbo_, GL_TRIANGLES);
+}
+
+void render::Box::submit(RenderQueue& queue, unsigned program) const
+{
+    const packet p = { program, vbo_.mesh, tao_.tao, tao_.size, &vbo_, GL_TRIANGLES };
+    queue.submit(p);
 }
 
 void render::Box::modify(const float* mat, unsigned instanceIndex)
@@ -135,10 +98,19 @@ void render::Box::modify(const float* mat, unsigned* instanceIndices, unsigned c
     render::modify(vbo_, mat, instanceIndices, count);
 }
 
+void render::Box::scatter(const float* mat, const unsigned* instanceIndices, unsigned count)
+{
+    render::scatter(vbo_, mat, instanceIndices, count);
+}
+
 void render::Box::reset(const float* mat, unsigned count) {
     render::reset(vbo_, mat, count);
 }
 
+float* render::Box::reset(unsigned count) {
+    return render::reset(vbo_, count);
+}
+
 void render::Box::push_back(const float* mat) {
     render::push_back(vbo_, mat);
 }
@@ -146,3 +118,23 @@ void render::Box::push_back(const float* mat) {
 void render::Box::push_back(const float* mat, unsigned count) {
     render::push_back(vbo_, mat, count);
 }
+
+float* render::Box::push_back(unsigned count) {
+    return render::push_back(vbo_, count);
+}
+
+void render::Box::flush() {
+    render::flush(vbo_);
+}
+
+void render::Box::shrink_to_fit() {
+    render::shrink_to_fit(vbo_);
+}
+
+unsigned render::Box::capacity() const {
+    return render::capacity(vbo_);
+}
+
+unsigned render::Box::reallocations() const {
+    return vbo_.reallocations;
+}
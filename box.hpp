@@ -17,20 +17,37 @@ namespace render {
         /// ctor.
         /// @param taoSrc texture handle array
         /// @param taoCount taoSrc size
-        /// @param instanceSizeMax the maximum # of instances to allocate
-        Box(const unsigned* taoSrc, unsigned taoCount, unsigned instanceSizeMax);
+        /// @param instanceSizeMax the # of instances to allocate up front; grows as needed
+        /// @param mode how instance changes are uploaded
+        Box(const unsigned* taoSrc, unsigned taoCount, unsigned instanceSizeMax, upload_mode mode = UPLOAD_SUBDATA);
         /// @override
         void draw() const;
         /// @override
+        void submit(RenderQueue& queue, unsigned program) const;
+        /// @override
         void modify(const float* mat, unsigned  instanceIndex);
         /// @override
         void modify(const float* mat, unsigned* instanceIndices, unsigned count);
         /// @override
+        void scatter(const float* mat, const unsigned* instanceIndices, unsigned count);
+        /// @override
         void reset(const float* mat, unsigned count);
         /// @override
+        float* reset(unsigned count);
+        /// @override
         void push_back(const float* mat);
         /// @override
         void push_back(const float* mat, unsigned count);
+        /// @override
+        float* push_back(unsigned count);
+        /// @override
+        void flush();
+        /// @override
+        void shrink_to_fit();
+        /// @override
+        unsigned capacity() const;
+        /// @override
+        unsigned reallocations() const;
 
     private:
 
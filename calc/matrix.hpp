@@ -4,6 +4,11 @@
 #define _CALC_MATRIX_HPP
 
 #include "matrix_nxm.hpp"
+#include "matrix_affine.hpp"
+#include "matrix_quaternion.hpp"
+#include "matrix_array.hpp"
+#include "matrix_dynamic.hpp"
+#include "matrix_expr.hpp"
 #include "matrix_operation.hpp"
 #include "matrix_transform.hpp"
 
@@ -0,0 +1,306 @@
+#pragma once
+
+#ifndef _CALC_MATRIX_AFFINE_HPP
+#define _CALC_MATRIX_AFFINE_HPP
+
+#include <cstring>
+
+#include "matrix_nxm.hpp"
+#include "matrix_operation.hpp"
+
+namespace calc {
+
+    /// class affine3f
+    /*! Affine 3D transform [ L | t ]: the top three rows of a 4x4 matrix whose
+     *! bottom row is 0, 0, 0, 1. Stored as three row-major rows of 4 floats, 48
+     *! bytes, which is also the per-instance layout the instanced shaders read
+     *! (a mat3x4 multiplied from the left by the homogeneous vertex).
+     */
+    class affine3f {
+
+        // Row-major rows 0..2 of the 4x4 matrix
+        float buffer_[12] __attribute__((aligned(16)));
+
+    public:
+
+        static affine3f identity() {
+
+            affine3f out;
+            out(0, 0) = 1;
+            out(1, 1) = 1;
+            out(2, 2) = 1;
+            return out;
+        }
+
+        operator float*() {
+            return buffer_;
+        }
+
+        operator const float*() const {
+            return buffer_;
+        }
+
+        /// ctor.
+        affine3f() {
+            std::memset(buffer_, 0, sizeof(buffer_));
+        }
+
+        /// ctor.
+        /// Elements are indeterminate until written
+        explicit affine3f(uninit_t) {}
+
+        /// ctor.
+        /// @param m 4x4 matrix; its bottom row is assumed to be 0, 0, 0, 1
+        explicit affine3f(const mat4f& m) {
+            std::memcpy(buffer_, data(m), sizeof(buffer_));
+        }
+
+        /// ctor.
+        /// @param linear linear part L
+        /// @param t translation
+        affine3f(const mat3f& linear, const vec3f& t) {
+
+            for (unsigned r = 0; r != 3; ++r)
+            {
+                for (unsigned c = 0; c != 3; ++c)
+                    (*this)(r, c) = linear(r, c);
+                (*this)(r, 3) = t[r];
+            }
+        }
+
+        /// @overload
+        float& operator()(const unsigned r, const unsigned c) {
+            return buffer_[r * 4 + c];
+        }
+
+        /// @overload
+        const float& operator()(const unsigned r, const unsigned c) const {
+            return buffer_[r * 4 + c];
+        }
+
+        /// @return the equivalent 4x4 matrix
+        mat4f to_mat4() const {
+
+            mat4f out(uninit);
+            std::memcpy(data(out), buffer_, sizeof(buffer_));
+            out(3, 0) = 0;
+            out(3, 1) = 0;
+            out(3, 2) = 0;
+            out(3, 3) = 1;
+            return out;
+        }
+
+        /// @return linear part L
+        mat3f linear() const {
+
+            mat3f out(uninit);
+            for (unsigned r = 0; r != 3; ++r)
+                for (unsigned c = 0; c != 3; ++c)
+                    out(r, c) = (*this)(r, c);
+            return out;
+        }
+
+        /// @return translation t
+        vec3f translation() const {
+            return vec3f(buffer_[3], buffer_[7], buffer_[11]);
+        }
+
+        /// @return composition: this applied after rhs
+        affine3f operator*(const affine3f& rhs) const {
+
+            affine3f out(uninit);
+#ifdef __NO_USE_SIMD__
+            for (unsigned r = 0; r != 3; ++r)
+            {
+                for (unsigned c = 0; c != 4; ++c)
+                {
+                    out(r, c) = (*this)(r, 0) * rhs(0, c)
+                              + (*this)(r, 1) * rhs(1, c)
+                              + (*this)(r, 2) * rhs(2, c);
+                }
+
+                out(r, 3) += (*this)(r, 3);
+            }
+#else
+            // Row i = a(i, 0) * b0 + a(i, 1) * b1 + a(i, 2) * b2 + (0, 0, 0, a(i, 3))
+            const __m128 b0 = _mm_load_ps(rhs.buffer_);
+            const __m128 b1 = _mm_load_ps(rhs.buffer_ + 4);
+            const __m128 b2 = _mm_load_ps(rhs.buffer_ + 8);
+
+            for (unsigned i = 0; i != 3; ++i)
+            {
+                const __m128 a = _mm_load_ps(buffer_ + i * 4);
+
+                __m128 row = _mm_blend_ps(_mm_setzero_ps(), a, 0x8);
+                row = _mm_add_ps(row, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), b0));
+                row = _mm_add_ps(row, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), b1));
+                row = _mm_add_ps(row, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), b2));
+
+                _mm_store_ps(out.buffer_ + i * 4, row);
+            }
+#endif
+            return out;
+        }
+
+        /// @overload
+        affine3f& operator*=(const affine3f& rhs) {
+            return (*this = (*this * rhs));
+        }
+    };
+
+    /// @return pointer to the data
+    inline float* data(affine3f& a) { return static_cast<float*>(a); }
+
+    /// @return pointer to the data
+    inline const float* data(const affine3f& a) { return static_cast<const float*>(a); }
+
+    namespace detail {
+
+        /// @return (dot(r0, v), dot(r1, v), dot(r2, v)) of an affine transform's rows
+        inline vec3f affine_apply(const float* rows, const float x, const float y, const float z, const float w) {
+
+            vec3f out(uninit);
+#ifdef __NO_USE_SIMD__
+            for (unsigned r = 0; r != 3; ++r)
+                out[r] = rows[r * 4] * x + rows[r * 4 + 1] * y + rows[r * 4 + 2] * z + rows[r * 4 + 3] * w;
+#else
+            const __m128 v = _mm_setr_ps(x, y, z, w);
+
+            const __m128 p0 = _mm_mul_ps(_mm_load_ps(rows), v);
+            const __m128 p1 = _mm_mul_ps(_mm_load_ps(rows + 4), v);
+            const __m128 p2 = _mm_mul_ps(_mm_load_ps(rows + 8), v);
+
+            // Transpose-and-add reduction; lane 3 ends up 0 and lands in the padding
+            const __m128 s01 = _mm_add_ps(_mm_unpacklo_ps(p0, p1), _mm_unpackhi_ps(p0, p1));
+            const __m128 s2z = _mm_add_ps(_mm_unpacklo_ps(p2, _mm_setzero_ps()), _mm_unpackhi_ps(p2, _mm_setzero_ps()));
+
+            _mm_store_ps(data(out), _mm_add_ps(_mm_movelh_ps(s01, s2z), _mm_movehl_ps(s2z, s01)));
+#endif
+            return out;
+        }
+    }
+
+    /// @return a applied to point p (translation included)
+    inline vec3f transform_point(const affine3f& a, const vec3f& p) {
+        return detail::affine_apply(a, p[0], p[1], p[2], 1);
+    }
+
+    /// @return a applied to direction v (translation ignored)
+    inline vec3f transform_vector(const affine3f& a, const vec3f& v) {
+        return detail::affine_apply(a, v[0], v[1], v[2], 0);
+    }
+
+    /// @return inverse of a; not finite if the linear part is singular
+    inline affine3f inverse(const affine3f& a)
+    {
+        affine3f out(uninit);
+#ifdef __NO_USE_SIMD__
+        // Rows of L^-1 are cross products of columns of L over det(L)
+        const vec3f c0(a(0, 0), a(1, 0), a(2, 0));
+        const vec3f c1(a(0, 1), a(1, 1), a(2, 1));
+        const vec3f c2(a(0, 2), a(1, 2), a(2, 2));
+
+        const vec3f u[3] = { cross(c1, c2), cross(c2, c0), cross(c0, c1) };
+        const float det = c0[0] * u[0][0] + c0[1] * u[0][1] + c0[2] * u[0][2];
+
+        for (unsigned r = 0; r != 3; ++r)
+        {
+            for (unsigned c = 0; c != 3; ++c)
+                out(r, c) = u[r][c] / det;
+            out(r, 3) = -(out(r, 0) * a(0, 3) + out(r, 1) * a(1, 3) + out(r, 2) * a(2, 3));
+        }
+#else
+        // Columns of [ L | t ]: c0, c1, c2 with lane 3 zero, c3 = (t, 1)
+        __m128 c0 = _mm_load_ps(static_cast<const float*>(a));
+        __m128 c1 = _mm_load_ps(static_cast<const float*>(a) + 4);
+        __m128 c2 = _mm_load_ps(static_cast<const float*>(a) + 8);
+        __m128 c3 = _mm_setr_ps(0, 0, 0, 1);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+        // cross(x, y) = x.yzx * y.zxy - x.zxy * y.yzx; lane 3 stays 0
+        struct local {
+            static inline __m128 cross(const __m128 x, const __m128 y) {
+                const __m128 x1 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 0, 2, 1));
+                const __m128 y1 = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 0, 2, 1));
+                const __m128 x2 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 1, 0, 2));
+                const __m128 y2 = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 1, 0, 2));
+                return _mm_sub_ps(_mm_mul_ps(x1, y2), _mm_mul_ps(x2, y1));
+            }
+        };
+
+        // Rows of L^-1 are cross products of columns of L over det(L)
+        __m128 u0 = local::cross(c1, c2);
+        __m128 u1 = local::cross(c2, c0);
+        __m128 u2 = local::cross(c0, c1);
+
+        const __m128 det = _mm_dp_ps(c0, u0, 0x7f);
+        u0 = _mm_div_ps(u0, det);
+        u1 = _mm_div_ps(u1, det);
+        u2 = _mm_div_ps(u2, det);
+
+        // t' = -L^-1 * t, moved into lane 3 of each row
+        const __m128 t = _mm_blend_ps(c3, _mm_setzero_ps(), 0x8);
+        const __m128 sign = _mm_set1_ps(-0.0f);
+
+        const __m128 t0 = _mm_xor_ps(sign, _mm_dp_ps(u0, t, 0x7f));
+        const __m128 t1 = _mm_xor_ps(sign, _mm_dp_ps(u1, t, 0x7f));
+        const __m128 t2 = _mm_xor_ps(sign, _mm_dp_ps(u2, t, 0x7f));
+
+        _mm_store_ps(static_cast<float*>(out), _mm_blend_ps(u0, t0, 0x8));
+        _mm_store_ps(static_cast<float*>(out) + 4, _mm_blend_ps(u1, t1, 0x8));
+        _mm_store_ps(static_cast<float*>(out) + 8, _mm_blend_ps(u2, t2, 0x8));
+#endif
+        return out;
+    }
+
+    /// @return inverse of a rigid transform, rotation and translation only
+    ///         (L orthonormal): [ L^T | -L^T t ], with no division
+    inline affine3f inverse_rigid(const affine3f& a)
+    {
+        affine3f out(uninit);
+#ifdef __NO_USE_SIMD__
+        for (unsigned r = 0; r != 3; ++r)
+        {
+            for (unsigned c = 0; c != 3; ++c)
+                out(r, c) = a(c, r);
+            out(r, 3) = -(a(0, r) * a(0, 3) + a(1, r) * a(1, 3) + a(2, r) * a(2, 3));
+        }
+#else
+        // Columns of [ L | t ]: c0, c1, c2 with lane 3 zero, c3 = (t, 1)
+        __m128 c0 = _mm_load_ps(static_cast<const float*>(a));
+        __m128 c1 = _mm_load_ps(static_cast<const float*>(a) + 4);
+        __m128 c2 = _mm_load_ps(static_cast<const float*>(a) + 8);
+        __m128 c3 = _mm_setr_ps(0, 0, 0, 1);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+        // Rows of L^T are the columns of L; t' = -L^T * t in lane 3
+        const __m128 t = _mm_blend_ps(c3, _mm_setzero_ps(), 0x8);
+        const __m128 sign = _mm_set1_ps(-0.0f);
+
+        const __m128 t0 = _mm_xor_ps(sign, _mm_dp_ps(c0, t, 0x7f));
+        const __m128 t1 = _mm_xor_ps(sign, _mm_dp_ps(c1, t, 0x7f));
+        const __m128 t2 = _mm_xor_ps(sign, _mm_dp_ps(c2, t, 0x7f));
+
+        _mm_store_ps(static_cast<float*>(out), _mm_blend_ps(c0, t0, 0x8));
+        _mm_store_ps(static_cast<float*>(out) + 4, _mm_blend_ps(c1, t1, 0x8));
+        _mm_store_ps(static_cast<float*>(out) + 8, _mm_blend_ps(c2, t2, 0x8));
+#endif
+        return out;
+    }
+
+    /// @return inverse of a 4x4 matrix whose bottom row is 0, 0, 0, 1, e.g.
+    ///         a model matrix; cheaper than the general calc::inverse
+    inline mat4f inverse_affine(const mat4f& m)
+    {
+        return inverse(affine3f(m)).to_mat4();
+    }
+
+    /// @return inverse of a 4x4 rigid transform (a view matrix: rotation and
+    ///         translation, bottom row 0, 0, 0, 1)
+    inline mat4f inverse_rigid(const mat4f& m)
+    {
+        return inverse_rigid(affine3f(m)).to_mat4();
+    }
+}
+
+#endif
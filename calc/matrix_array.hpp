@@ -0,0 +1,382 @@
+#pragma once
+
+#ifndef _CALC_MATRIX_ARRAY_HPP
+#define _CALC_MATRIX_ARRAY_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+#include "matrix_nxm.hpp"
+#include "matrix_operation.hpp"
+#include "matrix_transform.hpp"
+
+namespace calc {
+
+    /// class mat4f_array
+    /*! Structure-of-arrays batch of 4x4 float matrices: element (r, c) of every
+     *! matrix lives in its own contiguous stream, so batch operations run one
+     *! SIMD lane per matrix. device() interleaves the batch back into
+     *! column-major matrices, device_affine() into the 48-byte affine instance
+     *! layout; either can be uploaded as-is.
+     */
+    class mat4f_array {
+
+        // Stream length; a multiple of 16 so every kernel may process whole registers
+        std::size_t stride_;
+        // Number of matrices
+        std::size_t size_;
+        // 16 streams of stride_ elements, in row-major element order
+        std::vector<float> buffer_;
+        // Column-major matrices, 16 floats each, or affine rows, 12 floats each;
+        // rebuilt by device() / device_affine()
+        std::vector<float> device_;
+        // compose() input streams, 12 of stride_ elements; kept across calls
+        std::vector<float> scratch_;
+
+        static std::size_t round_stride(const std::size_t size) {
+            return (size + 15) / 16 * 16;
+        }
+
+    public:
+
+        /// ctor.
+        mat4f_array() : stride_(0), size_(0) {}
+
+        /// ctor.
+        /// @param size number of matrices
+        /// @param fill initial value of every matrix
+        explicit mat4f_array(const std::size_t size, const mat4f& fill = mat4f::identity()) : stride_(0), size_(0) {
+            resize(size, fill);
+        }
+
+        std::size_t size() const {
+            return size_;
+        }
+
+        std::size_t capacity() const {
+            return stride_;
+        }
+
+        /// @return stream of element (r, c); size() values, contiguous
+        float* stream(const unsigned r, const unsigned c) {
+            return buffer_.data() + (r * 4 + c) * stride_;
+        }
+
+        /// @return stream of element (r, c); size() values, contiguous
+        const float* stream(const unsigned r, const unsigned c) const {
+            return buffer_.data() + (r * 4 + c) * stride_;
+        }
+
+        /// Reallocates the streams to hold at least capacity matrices
+        void reserve(const std::size_t capacity) {
+
+            if (capacity <= stride_) {
+                return;
+            }
+
+            const std::size_t stride = round_stride(capacity);
+
+            std::vector<float> buffer(16 * stride, 0.0f);
+            for (unsigned i = 0; i != 16; ++i)
+            {
+                const float* src = buffer_.data() + i * stride_;
+                std::copy(src, src + size_, buffer.data() + i * stride);
+            }
+
+            buffer_.swap(buffer);
+            stride_ = stride;
+        }
+
+        /// Resizes the batch; new matrices are set to fill
+        void resize(const std::size_t size, const mat4f& fill = mat4f::identity()) {
+
+            reserve(size);
+            for (unsigned i = 0; i != 16; ++i)
+            {
+                float* s = buffer_.data() + i * stride_;
+                std::fill(s + std::min(size, size_), s + size, data(fill)[i]);
+            }
+
+            size_ = size;
+        }
+
+        /// Appends a matrix; capacity grows geometrically
+        void push_back(const mat4f& m) {
+
+            if (size_ == stride_) {
+                reserve(2 * stride_ + 16);
+            }
+
+            set(size_++, m);
+        }
+
+        /// @return matrix i
+        mat4f get(const std::size_t i) const {
+
+            mat4f out(uninit);
+            for (unsigned k = 0; k != 16; ++k)
+                data(out)[k] = buffer_[k * stride_ + i];
+            return out;
+        }
+
+        /// Overwrites matrix i
+        void set(const std::size_t i, const mat4f& m) {
+
+            for (unsigned k = 0; k != 16; ++k)
+                buffer_[k * stride_ + i] = data(m)[k];
+        }
+
+        /// Replaces every matrix x with m * x
+        void premultiply(const mat4f& m) {
+            // Column l of x: x(k, l) at stream k * 4 + l
+            multiply(data(m), 4, 1);
+        }
+
+        /// Replaces every matrix x with x * m
+        void postmultiply(const mat4f& m) {
+            // Row l of x: x(l, k) at stream l * 4 + k
+            const mat4f w = transpose(m);
+            multiply(data(w), 1, 4);
+        }
+
+        /// Rebuilds every matrix as T * R * S from per-matrix streams of size() values
+        /// @param t translation x, y, z streams
+        /// @param r rotation angles in radians about x, y, z, composed as
+        ///          rotate_4x * rotate_4y * rotate_4z; null for no rotation
+        /// @param s scale x, y, z streams; null for unit scale
+        void compose(const float* const t[3], const float* const r[3] = nullptr, const float* const s[3] = nullptr) {
+
+            if (size_ == 0) {
+                return;
+            }
+
+            // Padded input streams: sin, cos of x, y, z; translation x, y, z; scale x, y, z.
+            // Every value is rewritten, and the lanes up to the next register
+            // cleared, so the storage is only allocated when the streams grow
+            scratch_.resize(12 * stride_);
+            float* const in = scratch_.data();
+
+            const std::size_t padded = (size_ + 3) / 4 * 4;
+            for (unsigned a = 0; a != 3; ++a)
+            {
+                float* sn = &in[(2 * a) * stride_];
+                float* cs = &in[(2 * a + 1) * stride_];
+                float* tr = &in[(6 + a) * stride_];
+                float* sc = &in[(9 + a) * stride_];
+
+                if (r) {
+                    sincos(r[a], sn, cs, size_);
+                } else {
+                    std::fill(sn, sn + size_, 0.0f);
+                    std::fill(cs, cs + size_, 1.0f);
+                }
+
+                for (std::size_t i = 0; i != size_; ++i)
+                {
+                    tr[i] = t[a][i];
+                    sc[i] = s ? s[a][i] : 1;
+                }
+
+                for (float* p : { sn, cs, tr, sc })
+                    std::fill(p + size_, p + padded, 0.0f);
+            }
+
+            const float* sx = &in[ 0 * stride_];
+            const float* cx = &in[ 1 * stride_];
+            const float* sy = &in[ 2 * stride_];
+            const float* cy = &in[ 3 * stride_];
+            const float* sz = &in[ 4 * stride_];
+            const float* cz = &in[ 5 * stride_];
+            const float* tx = &in[ 6 * stride_];
+            const float* ty = &in[ 7 * stride_];
+            const float* tz = &in[ 8 * stride_];
+            const float* kx = &in[ 9 * stride_];
+            const float* ky = &in[10 * stride_];
+            const float* kz = &in[11 * stride_];
+
+            // R = rotate_4x * rotate_4y * rotate_4z; column j of R scaled by s[j]
+#ifdef __NO_USE_SIMD__
+            for (std::size_t i = 0; i != size_; ++i)
+            {
+                stream(0, 0)[i] =  cy[i] * cz[i] * kx[i];
+                stream(0, 1)[i] = -cy[i] * sz[i] * ky[i];
+                stream(0, 2)[i] =  sy[i] * kz[i];
+                stream(0, 3)[i] =  tx[i];
+
+                stream(1, 0)[i] = (sx[i] * sy[i] * cz[i] + cx[i] * sz[i]) * kx[i];
+                stream(1, 1)[i] = (cx[i] * cz[i] - sx[i] * sy[i] * sz[i]) * ky[i];
+                stream(1, 2)[i] = -sx[i] * cy[i] * kz[i];
+                stream(1, 3)[i] =  ty[i];
+
+                stream(2, 0)[i] = (sx[i] * sz[i] - cx[i] * sy[i] * cz[i]) * kx[i];
+                stream(2, 1)[i] = (cx[i] * sy[i] * sz[i] + sx[i] * cz[i]) * ky[i];
+                stream(2, 2)[i] =  cx[i] * cy[i] * kz[i];
+                stream(2, 3)[i] =  tz[i];
+            }
+#else
+            const __m128 sign = _mm_set1_ps(-0.0f);
+            for (std::size_t i = 0; i < size_; i += 4)
+            {
+                const __m128 vsx = _mm_loadu_ps(sx + i), vcx = _mm_loadu_ps(cx + i);
+                const __m128 vsy = _mm_loadu_ps(sy + i), vcy = _mm_loadu_ps(cy + i);
+                const __m128 vsz = _mm_loadu_ps(sz + i), vcz = _mm_loadu_ps(cz + i);
+                const __m128 vkx = _mm_loadu_ps(kx + i);
+                const __m128 vky = _mm_loadu_ps(ky + i);
+                const __m128 vkz = _mm_loadu_ps(kz + i);
+
+                const __m128 sxsy = _mm_mul_ps(vsx, vsy);
+                const __m128 cxsy = _mm_mul_ps(vcx, vsy);
+
+                _mm_storeu_ps(stream(0, 0) + i, _mm_mul_ps(_mm_mul_ps(vcy, vcz), vkx));
+                _mm_storeu_ps(stream(0, 1) + i, _mm_xor_ps(sign, _mm_mul_ps(_mm_mul_ps(vcy, vsz), vky)));
+                _mm_storeu_ps(stream(0, 2) + i, _mm_mul_ps(vsy, vkz));
+                _mm_storeu_ps(stream(0, 3) + i, _mm_loadu_ps(tx + i));
+
+                _mm_storeu_ps(stream(1, 0) + i, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sxsy, vcz), _mm_mul_ps(vcx, vsz)), vkx));
+                _mm_storeu_ps(stream(1, 1) + i, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(vcx, vcz), _mm_mul_ps(sxsy, vsz)), vky));
+                _mm_storeu_ps(stream(1, 2) + i, _mm_xor_ps(sign, _mm_mul_ps(_mm_mul_ps(vsx, vcy), vkz)));
+                _mm_storeu_ps(stream(1, 3) + i, _mm_loadu_ps(ty + i));
+
+                _mm_storeu_ps(stream(2, 0) + i, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(vsx, vsz), _mm_mul_ps(cxsy, vcz)), vkx));
+                _mm_storeu_ps(stream(2, 1) + i, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cxsy, vsz), _mm_mul_ps(vsx, vcz)), vky));
+                _mm_storeu_ps(stream(2, 2) + i, _mm_mul_ps(_mm_mul_ps(vcx, vcy), vkz));
+                _mm_storeu_ps(stream(2, 3) + i, _mm_loadu_ps(tz + i));
+            }
+#endif
+            std::fill(stream(3, 0), stream(3, 0) + size_, 0.0f);
+            std::fill(stream(3, 1), stream(3, 1) + size_, 0.0f);
+            std::fill(stream(3, 2), stream(3, 2) + size_, 0.0f);
+            std::fill(stream(3, 3), stream(3, 3) + size_, 1.0f);
+        }
+
+        /// Interleaves the batch into column-major (device) order
+        /// @return 16 * size() floats; valid until the next call or modification
+        const float* device() {
+
+            device_.resize(16 * size_);
+#ifdef __NO_USE_SIMD__
+            for (std::size_t i = 0; i != size_; ++i)
+            {
+                for (unsigned c = 0; c != 4; ++c)
+                    for (unsigned r = 0; r != 4; ++r)
+                        device_[i * 16 + c * 4 + r] = stream(r, c)[i];
+            }
+#else
+            float* out = device_.data();
+
+            std::size_t i = 0;
+            for ( ; i + 4 <= size_; i += 4)
+            {
+                // Column c of 4 matrices: one 4x4 transpose of streams (0..3, c)
+                for (unsigned c = 0; c != 4; ++c)
+                {
+                    const __m128 x0 = _mm_loadu_ps(stream(0, c) + i);
+                    const __m128 x1 = _mm_loadu_ps(stream(1, c) + i);
+                    const __m128 x2 = _mm_loadu_ps(stream(2, c) + i);
+                    const __m128 x3 = _mm_loadu_ps(stream(3, c) + i);
+
+                    const __m128 y0 = _mm_unpacklo_ps(x0, x1);
+                    const __m128 y1 = _mm_unpackhi_ps(x0, x1);
+                    const __m128 y2 = _mm_unpacklo_ps(x2, x3);
+                    const __m128 y3 = _mm_unpackhi_ps(x2, x3);
+
+                    _mm_storeu_ps(out + (i + 0) * 16 + c * 4, _mm_movelh_ps(y0, y2));
+                    _mm_storeu_ps(out + (i + 1) * 16 + c * 4, _mm_movehl_ps(y2, y0));
+                    _mm_storeu_ps(out + (i + 2) * 16 + c * 4, _mm_movelh_ps(y1, y3));
+                    _mm_storeu_ps(out + (i + 3) * 16 + c * 4, _mm_movehl_ps(y3, y1));
+                }
+            }
+
+            for ( ; i != size_; ++i)
+            {
+                for (unsigned c = 0; c != 4; ++c)
+                    for (unsigned r = 0; r != 4; ++r)
+                        out[i * 16 + c * 4 + r] = stream(r, c)[i];
+            }
+#endif
+            return device_.data();
+        }
+
+        /// Interleaves rows 0..2 of every matrix into the affine3f layout; the
+        /// bottom rows are assumed to be 0, 0, 0, 1
+        /// @return 12 * size() floats; valid until the next call or modification
+        const float* device_affine() {
+
+            device_.resize(12 * size_);
+            device_affine(device_.data());
+
+            return device_.data();
+        }
+
+        /// @overload
+        /// Writes straight to out (e.g. a drawable's instance shadow)
+        /// @param out room for 12 * size() floats
+        void device_affine(float* out) const {
+#ifdef __NO_USE_SIMD__
+            for (std::size_t i = 0; i != size_; ++i)
+            {
+                for (unsigned r = 0; r != 3; ++r)
+                    for (unsigned c = 0; c != 4; ++c)
+                        out[i * 12 + r * 4 + c] = stream(r, c)[i];
+            }
+#else
+            std::size_t i = 0;
+            for ( ; i + 4 <= size_; i += 4)
+            {
+                // Row r of 4 matrices: one 4x4 transpose of streams (r, 0..3)
+                for (unsigned r = 0; r != 3; ++r)
+                {
+                    __m128 x0 = _mm_loadu_ps(stream(r, 0) + i);
+                    __m128 x1 = _mm_loadu_ps(stream(r, 1) + i);
+                    __m128 x2 = _mm_loadu_ps(stream(r, 2) + i);
+                    __m128 x3 = _mm_loadu_ps(stream(r, 3) + i);
+                    _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+
+                    _mm_storeu_ps(out + (i + 0) * 12 + r * 4, x0);
+                    _mm_storeu_ps(out + (i + 1) * 12 + r * 4, x1);
+                    _mm_storeu_ps(out + (i + 2) * 12 + r * 4, x2);
+                    _mm_storeu_ps(out + (i + 3) * 12 + r * 4, x3);
+                }
+            }
+
+            for ( ; i != size_; ++i)
+            {
+                for (unsigned r = 0; r != 3; ++r)
+                    for (unsigned c = 0; c != 4; ++c)
+                        out[i * 12 + r * 4 + c] = stream(r, c)[i];
+            }
+#endif
+        }
+
+    private:
+
+        // Helper
+        // x(l, j) = sum_k w(j, k) * x(l, k), stream (l, k) at (l * outer + k * inner)
+        void multiply(const float* w, const std::size_t inner, const std::size_t outer) {
+#ifdef __NO_USE_SIMD__
+            for (std::size_t i = 0; i != size_; ++i)
+            {
+                for (std::size_t l = 0; l != 4; ++l)
+                {
+                    float x[4];
+                    for (std::size_t k = 0; k != 4; ++k)
+                        x[k] = buffer_[(l * outer + k * inner) * stride_ + i];
+
+                    for (std::size_t j = 0; j != 4; ++j)
+                        buffer_[(l * outer + j * inner) * stride_ + i] =
+                            w[j * 4] * x[0] + w[j * 4 + 1] * x[1] + w[j * 4 + 2] * x[2] + w[j * 4 + 3] * x[3];
+                }
+            }
+#else
+            if (size_ != 0) {
+                detail::kernels().soa_mul_4x4(w, buffer_.data(), stride_, size_, inner, outer);
+            }
+#endif
+        }
+    };
+}
+
+#endif
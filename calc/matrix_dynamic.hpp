@@ -0,0 +1,165 @@
+#pragma once
+
+#ifndef _CALC_MATRIX_DYNAMIC_HPP
+#define _CALC_MATRIX_DYNAMIC_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include "matrix_nxm.hpp"
+#include "simd/elementwise.hpp"
+
+#ifndef __NO_USE_SIMD__
+#include "simd/gemm.hpp"
+#endif
+
+namespace calc {
+
+    /// C = A * B for row-major, unpadded A (n x k), B (k x m) and C (n x m);
+    /// c must not alias a or b. Packed and cache-blocked, with the rows of C
+    /// split across up to threads pooled threads (0: one per core); small products
+    /// stay on the calling thread
+    inline void gemm(const float* a,
+                     const float* b,
+                     float* c,
+                     const std::size_t n,
+                     const std::size_t k,
+                     const std::size_t m,
+                     const unsigned threads = 0)
+    {
+#ifdef __NO_USE_SIMD__
+        (void)threads;
+        for (std::size_t i = 0; i != n; ++i)
+        {
+            float* row = c + i * m;
+            for (std::size_t j = 0; j != m; ++j)
+                row[j] = 0;
+
+            for (std::size_t p = 0; p != k; ++p)
+            {
+                const float x = a[i * k + p];
+                for (std::size_t j = 0; j != m; ++j)
+                    row[j] += x * b[p * m + j];
+            }
+        }
+#else
+        detail::gemm_ps(a, b, c, n, k, m, threads);
+#endif
+    }
+
+    /// class matf
+    /*! Float matrix sized at run time, for batch jobs too large for the
+     *! fixed-size calc::matrix; row-major and unpadded, heap-allocated.
+     *! Longer elementwise chains fuse into one pass with calc::elementwise
+     */
+    class matf {
+
+        std::size_t rows_;
+        std::size_t cols_;
+        // Row-major matrix data
+        std::vector<float> buffer_;
+
+    public:
+
+        /// ctor.
+        matf() : rows_(0), cols_(0) {}
+
+        /// ctor.
+        /// @param rows number of rows
+        /// @param cols number of columns
+        /// @param fill initial value of every element
+        matf(const std::size_t rows, const std::size_t cols, const float fill = 0) : rows_(rows)
+                                                                                  , cols_(cols)
+                                                                                  , buffer_(rows * cols, fill) {}
+
+        operator float*() {
+            return buffer_.data();
+        }
+
+        operator const float*() const {
+            return buffer_.data();
+        }
+
+        std::size_t rows() const {
+            return rows_;
+        }
+
+        std::size_t cols() const {
+            return cols_;
+        }
+
+        std::size_t size() const {
+            return buffer_.size();
+        }
+
+        /// @overload
+        float& operator()(const std::size_t r, const std::size_t c) {
+            return buffer_[r * cols_ + c];
+        }
+
+        /// @overload
+        const float& operator()(const std::size_t r, const std::size_t c) const {
+            return buffer_[r * cols_ + c];
+        }
+
+        /// @overload
+        matf operator+(const matf& rhs) const {
+
+            /**/ assert(rows_ == rhs.rows_ && cols_ == rhs.cols_);
+
+            matf out(rows_, cols_);
+            elementwise(out.buffer_.data(), size(), elements(buffer_.data()) + elements(rhs.buffer_.data()));
+            return out;
+        }
+
+        /// @overload
+        matf operator-(const matf& rhs) const {
+
+            /**/ assert(rows_ == rhs.rows_ && cols_ == rhs.cols_);
+
+            matf out(rows_, cols_);
+            elementwise(out.buffer_.data(), size(), elements(buffer_.data()) - elements(rhs.buffer_.data()));
+            return out;
+        }
+
+        /// @overload
+        matf operator*(const float scalar) const {
+
+            matf out(rows_, cols_);
+            elementwise(out.buffer_.data(), size(), elements(buffer_.data()) * scalar);
+            return out;
+        }
+
+        /// @overload
+        matf operator/(const float scalar) const {
+
+            matf out(rows_, cols_);
+            elementwise(out.buffer_.data(), size(), elements(buffer_.data()) / scalar);
+            return out;
+        }
+
+        /// @overload
+        matf operator*(const matf& rhs) const {
+
+            /**/ assert(cols_ == rhs.rows_);
+
+            matf out(rows_, rhs.cols_);
+            gemm(buffer_.data(), rhs.buffer_.data(), out.buffer_.data(), rows_, cols_, rhs.cols_);
+            return out;
+        }
+
+        /// @overload
+        matf& operator*=(const matf& rhs) {
+            return (*this = (*this * rhs));
+        }
+    };
+
+    /// @return pointer to the data
+    inline float* data(matf& m) { return static_cast<float*>(m); }
+
+    /// @return pointer to the data
+    inline const float* data(const matf& m) { return static_cast<const float*>(m); }
+}
+
+#endif
@@ -0,0 +1,644 @@
+#pragma once
+
+#ifndef _CALC_MATRIX_EXPR_HPP
+#define _CALC_MATRIX_EXPR_HPP
+
+#include <cstddef>
+#include <type_traits>
+
+#include "matrix_nxm.hpp"
+#include "matrix_operation.hpp"
+
+/*! Opt-in lazy matrix expressions
+ *!
+ *! calc::lazy(m) starts an expression; +, -, scalar * and / and matrix
+ *! products chained onto it build a tree of small nodes instead of temporaries.
+ *! Converting the tree to a matrix, or calc::assign(dst, tree), evaluates it in
+ *! a single pass over the destination:
+ *!
+ *!   const mat4f model = calc::lazy(translation) * rotate_4x(a) * rotate_4y(b);
+ *!
+ *! Float expressions of elementwise operations only are evaluated a register
+ *! at a time; float expressions with 4 columns are evaluated one row (two rows
+ *! with AVX2) at a time, so a left-to-right product chain keeps every
+ *! intermediate row in registers. Everything else is evaluated row by row on
+ *! the stack. The AVX2 paths follow the active calc backend.
+ *!
+ *! Nodes refer to their operands: evaluate within the full-expression that
+ *! builds them.
+ */
+
+namespace calc {
+
+    template <typename E>
+    class expr;
+
+    namespace detail {
+
+        /// @return true if each row of a padded N x M float buffer can be read as
+        ///         one register (M <= 4) without reading past the buffer
+        constexpr bool row_loadable(const unsigned N, const unsigned M) {
+            return (M == 4) || (M < 4 && N != 0 && (N - 1) * M + 4 <= __padd__(N * M, 4));
+        }
+
+        /// struct expr_leaf
+        /*! A matrix operand, by reference
+         */
+        template <typename T,
+                  unsigned N,
+                  unsigned M>
+        struct expr_leaf {
+
+            typedef T value_type;
+            enum { rows = N, cols = M, elementwise = 1, registers = row_loadable(N, M) };
+
+            const matrix<T, N, M>& m;
+
+            explicit expr_leaf(const matrix<T, N, M>& m) : m(m) {}
+
+            const matrix<T, N, M>& get() const {
+                return m;
+            }
+
+            void row(const unsigned r, T* out) const {
+                for (unsigned c = 0; c != M; ++c)
+                    out[c] = m(r, c);
+            }
+#ifndef __NO_USE_SIMD__
+            __m128 row4(const unsigned r) const {
+                return (M == 4) ? _mm_load_ps(data(m) + r * 4) : _mm_loadu_ps(data(m) + r * M);
+            }
+
+            __m128 packet(const std::size_t i) const {
+                return _mm_load_ps(data(m) + i);
+            }
+
+            __target_avx2__
+            __m256 row8(const unsigned r) const {
+                return _mm256_loadu_ps(data(m) + r * 4);
+            }
+
+            __target_avx2__
+            __m256 packet8(const std::size_t i) const {
+                return _mm256_loadu_ps(data(m) + i);
+            }
+#endif
+        };
+
+        /// struct expr_value
+        /*! An evaluated sub-expression, by value; the right operand of a
+         *! product must be a whole matrix
+         */
+        template <typename T,
+                  unsigned N,
+                  unsigned M>
+        struct expr_value {
+
+            typedef T value_type;
+            enum { rows = N, cols = M, elementwise = 1, registers = row_loadable(N, M) };
+
+            matrix<T, N, M> m;
+
+            explicit expr_value(const matrix<T, N, M>& m) : m(m) {}
+
+            const matrix<T, N, M>& get() const {
+                return m;
+            }
+        };
+
+        /// Elementwise operations
+        struct expr_add {
+            template <typename T> static T apply(const T a, const T b) { return a + b; }
+#ifndef __NO_USE_SIMD__
+            static __m128 apply(const __m128 a, const __m128 b) { return _mm_add_ps(a, b); }
+            __target_avx2__ static __m256 apply(const __m256 a, const __m256 b) { return _mm256_add_ps(a, b); }
+#endif
+        };
+
+        struct expr_sub {
+            template <typename T> static T apply(const T a, const T b) { return a - b; }
+#ifndef __NO_USE_SIMD__
+            static __m128 apply(const __m128 a, const __m128 b) { return _mm_sub_ps(a, b); }
+            __target_avx2__ static __m256 apply(const __m256 a, const __m256 b) { return _mm256_sub_ps(a, b); }
+#endif
+        };
+
+        /// struct expr_binary
+        /*! lhs (op) rhs, elementwise
+         */
+        template <typename L,
+                  typename R,
+                  typename Op>
+        struct expr_binary {
+
+            static_assert(std::is_same<typename L::value_type, typename R::value_type>::value, "mixed element types");
+            static_assert(unsigned(L::rows) == unsigned(R::rows) && unsigned(L::cols) == unsigned(R::cols), "shape mismatch");
+
+            typedef typename L::value_type value_type;
+            enum { rows = L::rows, cols = L::cols, elementwise = L::elementwise && R::elementwise, registers = L::registers && R::registers };
+
+            L lhs;
+            R rhs;
+
+            expr_binary(const L& lhs, const R& rhs) : lhs(lhs), rhs(rhs) {}
+
+            void row(const unsigned r, value_type* out) const {
+
+                value_type b[cols];
+                lhs.row(r, out);
+                rhs.row(r, b);
+
+                for (unsigned c = 0; c != cols; ++c)
+                    out[c] = Op::apply(out[c], b[c]);
+            }
+#ifndef __NO_USE_SIMD__
+            __m128 row4(const unsigned r) const {
+                return Op::apply(lhs.row4(r), rhs.row4(r));
+            }
+
+            __m128 packet(const std::size_t i) const {
+                return Op::apply(lhs.packet(i), rhs.packet(i));
+            }
+
+            __target_avx2__
+            __m256 row8(const unsigned r) const {
+                return Op::apply(lhs.row8(r), rhs.row8(r));
+            }
+
+            __target_avx2__
+            __m256 packet8(const std::size_t i) const {
+                return Op::apply(lhs.packet8(i), rhs.packet8(i));
+            }
+#endif
+        };
+
+        /// struct expr_scale
+        /*! e * s
+         */
+        template <typename E>
+        struct expr_scale {
+
+            typedef typename E::value_type value_type;
+            enum { rows = E::rows, cols = E::cols, elementwise = E::elementwise, registers = E::registers };
+
+            E e;
+            value_type s;
+
+            expr_scale(const E& e, const value_type s) : e(e), s(s) {}
+
+            void row(const unsigned r, value_type* out) const {
+
+                e.row(r, out);
+                for (unsigned c = 0; c != cols; ++c)
+                    out[c] *= s;
+            }
+#ifndef __NO_USE_SIMD__
+            __m128 row4(const unsigned r) const {
+                return _mm_mul_ps(e.row4(r), _mm_set1_ps(s));
+            }
+
+            __m128 packet(const std::size_t i) const {
+                return _mm_mul_ps(e.packet(i), _mm_set1_ps(s));
+            }
+
+            __target_avx2__
+            __m256 row8(const unsigned r) const {
+                return _mm256_mul_ps(e.row8(r), _mm256_set1_ps(s));
+            }
+
+            __target_avx2__
+            __m256 packet8(const std::size_t i) const {
+                return _mm256_mul_ps(e.packet8(i), _mm256_set1_ps(s));
+            }
+#endif
+        };
+
+        /// struct expr_div
+        /*! e / s, divided lane by lane like the eager operator (not e * (1 / s),
+         *! which rounds differently)
+         */
+        template <typename E>
+        struct expr_div {
+
+            typedef typename E::value_type value_type;
+            enum { rows = E::rows, cols = E::cols, elementwise = E::elementwise, registers = E::registers };
+
+            E e;
+            value_type s;
+
+            expr_div(const E& e, const value_type s) : e(e), s(s) {}
+
+            void row(const unsigned r, value_type* out) const {
+
+                e.row(r, out);
+                for (unsigned c = 0; c != cols; ++c)
+                    out[c] /= s;
+            }
+#ifndef __NO_USE_SIMD__
+            __m128 row4(const unsigned r) const {
+                return _mm_div_ps(e.row4(r), _mm_set1_ps(s));
+            }
+
+            __m128 packet(const std::size_t i) const {
+                return _mm_div_ps(e.packet(i), _mm_set1_ps(s));
+            }
+
+            __target_avx2__
+            __m256 row8(const unsigned r) const {
+                return _mm256_div_ps(e.row8(r), _mm256_set1_ps(s));
+            }
+
+            __target_avx2__
+            __m256 packet8(const std::size_t i) const {
+                return _mm256_div_ps(e.packet8(i), _mm256_set1_ps(s));
+            }
+#endif
+        };
+
+        /// struct expr_product
+        /*! lhs * rhs; row r of the product only needs row r of lhs, so lhs may
+         *! be any expression while rhs is a whole matrix (a leaf or a value)
+         */
+        template <typename L,
+                  typename R>
+        struct expr_product {
+
+            static_assert(std::is_same<typename L::value_type, typename R::value_type>::value, "mixed element types");
+            static_assert(unsigned(L::cols) == unsigned(R::rows), "shape mismatch");
+
+            typedef typename L::value_type value_type;
+            enum { rows = L::rows, cols = R::cols, elementwise = 0, registers = R::registers && (L::cols > 4 || L::registers) };
+
+            L lhs;
+            R rhs;
+
+            expr_product(const L& lhs, const R& rhs) : lhs(lhs), rhs(rhs) {}
+
+            void row(const unsigned r, value_type* out) const {
+
+                value_type a[L::cols];
+                lhs.row(r, a);
+
+                const matrix<value_type, R::rows, R::cols>& b = rhs.get();
+                for (unsigned c = 0; c != cols; ++c)
+                {
+                    value_type sum = 0;
+                    for (unsigned k = 0; k != unsigned(L::cols); ++k)
+                        sum += a[k] * b(k, c);
+                    out[c] = sum;
+                }
+            }
+#ifndef __NO_USE_SIMD__
+            /// Row r = sum_k lhs(r, k) * rhs row k, one register per rhs row
+            __m128 row4(const unsigned r) const {
+                return row4(r, std::integral_constant<bool, L::cols <= 4>());
+            }
+
+            __m128 row4(const unsigned r, std::true_type) const {
+
+                const float* b = data(rhs.get());
+                const __m128 a = lhs.row4(r);
+
+                // Pairwise sums: a chain of products is latency bound
+                __m128 p01 = _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), load_row(b, 0));
+                if (L::cols > 1) {
+                    p01 = _mm_add_ps(p01, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), load_row(b, 1)));
+                }
+
+                if (L::cols > 2)
+                {
+                    __m128 p23 = _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), load_row(b, 2));
+                    if (L::cols > 3) {
+                        p23 = _mm_add_ps(p23, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xff), load_row(b, 3)));
+                    }
+                    p01 = _mm_add_ps(p01, p23);
+                }
+
+                return p01;
+            }
+
+            __m128 row4(const unsigned r, std::false_type) const {
+
+                float a[L::cols];
+                lhs.row(r, a);
+
+                const float* b = data(rhs.get());
+
+                __m128 out = _mm_setzero_ps();
+                for (unsigned k = 0; k != unsigned(L::cols); ++k)
+                    out = _mm_add_ps(out, _mm_mul_ps(_mm_set1_ps(a[k]), load_row(b, k)));
+                return out;
+            }
+
+            /// @return row k of rhs
+            static __m128 load_row(const float* b, const unsigned k) {
+                return (R::cols == 4) ? _mm_load_ps(b + k * 4) : _mm_loadu_ps(b + k * R::cols);
+            }
+
+            /// Rows r and r + 1 at once: in-lane broadcasts against rhs rows
+            /// duplicated into both halves
+            __target_avx2__
+            __m256 row8(const unsigned r) const {
+                return row8(r, std::integral_constant<bool, L::cols == 4 && L::registers>());
+            }
+
+            __target_avx2__
+            __m256 row8(const unsigned r, std::true_type) const {
+
+                const float* b = data(rhs.get());
+                const __m256 a = lhs.row8(r);
+
+                const __m256 p01 = _mm256_fmadd_ps(_mm256_permute_ps(a, 0x55), _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 4)),
+                                                   _mm256_mul_ps(_mm256_permute_ps(a, 0x00), _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b))));
+                const __m256 p23 = _mm256_fmadd_ps(_mm256_permute_ps(a, 0xff), _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 12)),
+                                                   _mm256_mul_ps(_mm256_permute_ps(a, 0xaa), _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 8))));
+                return _mm256_add_ps(p01, p23);
+            }
+
+            __target_avx2__
+            __m256 row8(const unsigned r, std::false_type) const {
+                return _mm256_insertf128_ps(_mm256_castps128_ps256(row4(r)), row4(r + 1), 1);
+            }
+#endif
+        };
+
+        /// Evaluation strategies
+        enum expr_path {
+            EXPR_ROWS,    //> row by row, on the stack
+            EXPR_ROW4,    //> one float row register at a time (up to 4 columns); two with AVX2
+            EXPR_PACKETS  //> 4 or 8 floats at a time, over the padded buffer (elementwise only)
+        };
+
+        template <typename E>
+        struct expr_path_of {
+#ifdef __NO_USE_SIMD__
+            static const expr_path value = EXPR_ROWS;
+#else
+            static const bool isfloat = std::is_same<typename E::value_type, float>::value;
+            static const expr_path value = (isfloat && E::elementwise) ? EXPR_PACKETS
+                                         : (isfloat && E::registers && row_loadable(E::rows, E::cols)) ? EXPR_ROW4
+                                         : EXPR_ROWS;
+#endif
+        };
+
+        template <typename E>
+        inline void expr_eval(const E& e, typename E::value_type* out, std::integral_constant<expr_path, EXPR_ROWS>) {
+
+            typename E::value_type row[E::cols];
+            for (unsigned r = 0; r != unsigned(E::rows); ++r)
+            {
+                e.row(r, row);
+                for (unsigned c = 0; c != unsigned(E::cols); ++c)
+                    out[r * E::cols + c] = row[c];
+            }
+        }
+#ifndef __NO_USE_SIMD__
+        /// Elements [i, rows * cols) 4 floats at a time. The padding lanes of
+        /// the last packet are cleared rather than computed: zero times an
+        /// infinite scale, or zero divided by zero, is NaN
+        template <typename E>
+        inline void expr_eval_tail(const E& e, float* out, std::size_t i) {
+
+            const std::size_t size = E::rows * E::cols;
+            for ( ; i + 4 <= size; i += 4)
+                _mm_store_ps(out + i, e.packet(i));
+
+            if (i != size) {
+                _mm_store_ps(out + i, keep_low(e.packet(i), unsigned(size - i)));
+            }
+        }
+
+        template <typename E>
+        __target_avx2__
+        inline void expr_eval_avx2(const E& e, float* out, std::integral_constant<expr_path, EXPR_ROW4>) {
+
+            unsigned r = 0;
+            for ( ; r + 2 <= unsigned(E::rows); r += 2)
+                _mm256_storeu_ps(out + r * 4, e.row8(r));
+
+            if (r != unsigned(E::rows)) {
+                _mm_store_ps(out + r * 4, e.row4(r));
+            }
+        }
+
+        template <typename E>
+        __target_avx2__
+        inline void expr_eval_avx2(const E& e, float* out, std::integral_constant<expr_path, EXPR_PACKETS>) {
+
+            const std::size_t size = E::rows * E::cols;
+
+            std::size_t i = 0;
+            for ( ; i + 8 <= size; i += 8)
+                _mm256_storeu_ps(out + i, e.packet8(i));
+
+            // At most one whole 128-bit packet remains, then a partial one
+            expr_eval_tail(e, out, i);
+        }
+
+        template <typename E>
+        inline void expr_eval(const E& e, float* out, std::integral_constant<expr_path, EXPR_ROW4> path, std::true_type) {
+
+            if (kernels().type >= BACKEND_AVX2) {
+                expr_eval_avx2(e, out, path);
+                return;
+            }
+
+            for (unsigned r = 0; r != unsigned(E::rows); ++r)
+                _mm_store_ps(out + r * 4, e.row4(r));
+        }
+
+        /// Narrow rows: every row is computed before the overlapping stores,
+        /// and the lanes past the last row are cleared to keep the padding zero
+        template <typename E>
+        inline void expr_eval(const E& e, float* out, std::integral_constant<expr_path, EXPR_ROW4>, std::false_type) {
+
+            __m128 rows[E::rows];
+            for (unsigned r = 0; r != unsigned(E::rows); ++r)
+                rows[r] = e.row4(r);
+
+            for (unsigned r = 0; r + 1 < unsigned(E::rows); ++r)
+                _mm_storeu_ps(out + r * E::cols, rows[r]);
+
+            _mm_storeu_ps(out + (E::rows - 1) * E::cols, _mm_blend_ps(rows[E::rows - 1], _mm_setzero_ps(), (0xf << E::cols) & 0xf));
+        }
+
+        template <typename E>
+        inline void expr_eval(const E& e, float* out, std::integral_constant<expr_path, EXPR_ROW4> path) {
+            expr_eval(e, out, path, std::integral_constant<bool, E::cols == 4>());
+        }
+
+        template <typename E>
+        inline void expr_eval(const E& e, float* out, std::integral_constant<expr_path, EXPR_PACKETS> path) {
+
+            if (kernels().type >= BACKEND_AVX2) {
+                expr_eval_avx2(e, out, path);
+                return;
+            }
+
+            expr_eval_tail(e, out, 0);
+        }
+#endif
+        /// Writes e into out, a padded buffer of e's shape
+        template <typename E>
+        inline void expr_eval(const E& e, typename E::value_type* out) {
+            expr_eval(e, out, std::integral_constant<expr_path, expr_path_of<E>::value>());
+        }
+    }
+
+    /// class expr
+    /*! Lazy matrix expression; see calc::lazy
+     */
+    template <typename E>
+    class expr {
+
+        E node_;
+
+    public:
+
+        typedef typename E::value_type value_type;
+        typedef matrix<value_type, E::rows, E::cols> matrix_type;
+
+        /// ctor.
+        explicit expr(const E& node) : node_(node) {}
+
+        const E& node() const {
+            return node_;
+        }
+
+        /// @return the evaluated matrix
+        matrix_type eval() const {
+
+            matrix_type out(uninit);
+            detail::expr_eval(node_, data(out));
+            return out;
+        }
+
+        /// @overload
+        operator matrix_type() const {
+            return eval();
+        }
+    };
+
+    /// @return the start of a lazy expression on m
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    inline expr<detail::expr_leaf<T, N, M> > lazy(const matrix<T, N, M>& m) {
+        static_assert(N != 0 && M != 0, "lazy expressions need a fixed size");
+        return expr<detail::expr_leaf<T, N, M> >(detail::expr_leaf<T, N, M>(m));
+    }
+
+    /// Evaluates e directly into dst, without a temporary
+    /// dst may appear in e, except as the right operand of a product
+    template <typename E>
+    inline matrix<typename E::value_type, E::rows, E::cols>& assign(matrix<typename E::value_type, E::rows, E::cols>& dst, const expr<E>& e) {
+
+        detail::expr_eval(e.node(), data(dst));
+        return dst;
+    }
+
+    /// @overload
+    template <typename L,
+              typename R>
+    inline expr<detail::expr_binary<L, R, detail::expr_add> > operator+(const expr<L>& lhs, const expr<R>& rhs) {
+        return expr<detail::expr_binary<L, R, detail::expr_add> >(detail::expr_binary<L, R, detail::expr_add>(lhs.node(), rhs.node()));
+    }
+
+    /// @overload
+    template <typename L,
+              typename T,
+              unsigned N,
+              unsigned M>
+    inline expr<detail::expr_binary<L, detail::expr_leaf<T, N, M>, detail::expr_add> > operator+(const expr<L>& lhs, const matrix<T, N, M>& rhs) {
+        return lhs + lazy(rhs);
+    }
+
+    /// @overload
+    template <typename R,
+              typename T,
+              unsigned N,
+              unsigned M>
+    inline expr<detail::expr_binary<detail::expr_leaf<T, N, M>, R, detail::expr_add> > operator+(const matrix<T, N, M>& lhs, const expr<R>& rhs) {
+        return lazy(lhs) + rhs;
+    }
+
+    /// @overload
+    template <typename L,
+              typename R>
+    inline expr<detail::expr_binary<L, R, detail::expr_sub> > operator-(const expr<L>& lhs, const expr<R>& rhs) {
+        return expr<detail::expr_binary<L, R, detail::expr_sub> >(detail::expr_binary<L, R, detail::expr_sub>(lhs.node(), rhs.node()));
+    }
+
+    /// @overload
+    template <typename L,
+              typename T,
+              unsigned N,
+              unsigned M>
+    inline expr<detail::expr_binary<L, detail::expr_leaf<T, N, M>, detail::expr_sub> > operator-(const expr<L>& lhs, const matrix<T, N, M>& rhs) {
+        return lhs - lazy(rhs);
+    }
+
+    /// @overload
+    template <typename R,
+              typename T,
+              unsigned N,
+              unsigned M>
+    inline expr<detail::expr_binary<detail::expr_leaf<T, N, M>, R, detail::expr_sub> > operator-(const matrix<T, N, M>& lhs, const expr<R>& rhs) {
+        return lazy(lhs) - rhs;
+    }
+
+    /// @overload
+    template <typename E>
+    inline expr<detail::expr_scale<E> > operator*(const expr<E>& e, const typename E::value_type s) {
+        return expr<detail::expr_scale<E> >(detail::expr_scale<E>(e.node(), s));
+    }
+
+    /// @overload
+    template <typename E>
+    inline expr<detail::expr_scale<E> > operator*(const typename E::value_type s, const expr<E>& e) {
+        return e * s;
+    }
+
+    /// @overload
+    template <typename E>
+    inline expr<detail::expr_div<E> > operator/(const expr<E>& e, const typename E::value_type s) {
+        return expr<detail::expr_div<E> >(detail::expr_div<E>(e.node(), s));
+    }
+
+    /// @overload
+    template <typename E>
+    inline expr<detail::expr_scale<E> > operator-(const expr<E>& e) {
+        return e * -1;
+    }
+
+    /// @overload
+    template <typename L,
+              typename T,
+              unsigned M,
+              unsigned M1>
+    inline expr<detail::expr_product<L, detail::expr_leaf<T, M, M1> > > operator*(const expr<L>& lhs, const matrix<T, M, M1>& rhs) {
+        typedef detail::expr_product<L, detail::expr_leaf<T, M, M1> > node;
+        return expr<node>(node(lhs.node(), detail::expr_leaf<T, M, M1>(rhs)));
+    }
+
+    /// @overload
+    /// rhs is evaluated once, into a matrix held by the product
+    template <typename L,
+              typename R>
+    inline expr<detail::expr_product<L, detail::expr_value<typename R::value_type, R::rows, R::cols> > > operator*(const expr<L>& lhs, const expr<R>& rhs) {
+        typedef detail::expr_value<typename R::value_type, R::rows, R::cols> value;
+        typedef detail::expr_product<L, value> node;
+        return expr<node>(node(lhs.node(), value(rhs.eval())));
+    }
+
+    /// @overload
+    template <typename R,
+              typename T,
+              unsigned N,
+              unsigned M>
+    inline expr<detail::expr_product<detail::expr_leaf<T, N, M>, detail::expr_value<T, R::rows, R::cols> > > operator*(const matrix<T, N, M>& lhs, const expr<R>& rhs) {
+        return lazy(lhs) * rhs;
+    }
+}
+
+#endif
@@ -5,11 +5,11 @@
 
 #include <cassert>
 #include <cmath>
-#include <cstring>
 #include <limits>
 #include <type_traits>
 
 #ifndef __NO_USE_SIMD__
+#include "simd/dispatch.hpp"
 #include "simd/matrix_add.hpp"
 #include "simd/matrix_mul.hpp"
 #include "simd/matrix_sub.hpp"
@@ -17,22 +17,35 @@
 #include "simd/scalar_mul.hpp"
 #endif
 
-// Padds to alignment size
-#define __padd__(a) (((a) == 0) || ((a) % 16) ?    ((a) + 16 - ((a) % 16))    :    (a))
+// Padds a to a multiple of l, the lanes of one 16-byte SIMD register
+#define __padd__(a, l) (((a) == 0) || ((a) % (l)) ?    ((a) + (l) - ((a) % (l)))    :    (a))
 
 namespace calc {
 
+    /// struct uninit_t
+    /*! Construction tag: the object is left for the caller to fill, skipping
+     *! the zeroing of elements that are about to be overwritten. Padding lanes
+     *! are still cleared, so whole-register kernels see zeros there.
+     */
+    struct uninit_t {
+        explicit constexpr uninit_t(int) {}
+    };
+
+    /// Tag value, e.g. mat4f out(calc::uninit);
+    constexpr uninit_t uninit(0);
+
     template <typename T__,
               unsigned N__,
               unsigned M__>
     class matrix {
 
-        // Row-major ordered matrix data
-        T__ buffer_[__padd__(N__ * M__)] __attribute__((aligned(16)));
+        // Row-major ordered matrix data, padded to a whole SIMD register:
+        // vec3f and vec4f take 16 bytes, mat3f 48
+        T__ buffer_[__padd__(N__ * M__, 16 / sizeof(T__))] __attribute__((aligned(16)));
 
     public:
 
-        static matrix<T__, N__, M__> identity(const T__ eigenout = 1) {
+        static constexpr matrix<T__, N__, M__> identity(const T__ eigenout = 1) {
 
             matrix<T__, N__, M__> out(T__(0));
             for (unsigned i = 0; i != N__; ++i)
@@ -40,21 +53,28 @@ namespace calc {
             return out;
         }
 
-        operator T__*() {
+        constexpr operator T__*() {
             return buffer_;
         }
 
-        operator const T__*() const {
+        constexpr operator const T__*() const {
             return buffer_;
         }
 
         /// ctor.
-        matrix() {
-            std::memset(buffer_, 0, sizeof(buffer_));
+        constexpr matrix() : buffer_() {}
+
+        /// ctor.
+        /// Elements are indeterminate until written; padding lanes are zero
+        explicit matrix(uninit_t) {
+
+            for (unsigned i = N__ * M__; i != sizeof(buffer_) / sizeof(T__); ++i) {
+                buffer_[i] = 0;
+            }
         }
 
         /// ctor.
-        matrix(const typename std::enable_if<std::is_same<T__, float>::value, T__>::type fill) {
+        constexpr matrix(const typename std::enable_if<std::is_floating_point<T__>::value, T__>::type fill) : buffer_() {
 
             for (unsigned i = 0; i != N__ * M__; ++i) {
                 buffer_[i] = fill;
@@ -62,10 +82,11 @@ namespace calc {
         }
 
         /// ctor.
-        explicit matrix(const T__* fill) {
+        explicit constexpr matrix(const T__* fill) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
-            std::memcpy(buffer_, fill, N__ * M__ * sizeof(float));
+            for (unsigned i = 0; i != N__ * M__; ++i) {
+                buffer_[i] = fill[i];
+            }
         }
 
         /// ctor.
@@ -73,9 +94,8 @@ namespace calc {
                   unsigned M1,
                   unsigned N = N__,
                   unsigned M = M__>
-        matrix(const matrix<T__, N1, M1>& v, typename std::enable_if<N * M == 4 && (N == 1 || M == 1) && (N1 * M1 == 2), T__>::type x2, T__ x3) {
+        constexpr matrix(const matrix<T__, N1, M1>& v, typename std::enable_if<N * M == 4 && (N == 1 || M == 1) && (N1 * M1 == 2), T__>::type x2, T__ x3) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
             buffer_[0] = v[0];
             buffer_[1] = v[1];
             buffer_[2] = x2;
@@ -87,9 +107,8 @@ namespace calc {
                   unsigned M1,
                   unsigned N = N__,
                   unsigned M = M__>
-        matrix(const matrix<T__, N1, M1>& v, typename std::enable_if<N * M == 4 && (N == 1 || M == 1) && (N1 * M1 == 3), T__>::type x3) {
+        constexpr matrix(const matrix<T__, N1, M1>& v, typename std::enable_if<N * M == 4 && (N == 1 || M == 1) && (N1 * M1 == 3), T__>::type x3) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
             buffer_[0] = v[0];
             buffer_[1] = v[1];
             buffer_[2] = v[2];
@@ -99,18 +118,16 @@ namespace calc {
         /// ctor.
         template <unsigned N = N__,
                   unsigned M = M__>
-        matrix(typename std::enable_if<N * M == 1, T__>::type x0) {
+        constexpr matrix(typename std::enable_if<N * M == 1, T__>::type x0) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
             buffer_[0] = x0;
         }
 
         /// ctor.
         template <unsigned N = N__,
                   unsigned M = M__>
-        matrix(typename std::enable_if<N * M == 2, T__>::type x0, T__ x1) {
+        constexpr matrix(typename std::enable_if<N * M == 2, T__>::type x0, T__ x1) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
             buffer_[0] = x0;
             buffer_[1] = x1;
         }
@@ -118,9 +135,8 @@ namespace calc {
         /// ctor.
         template <unsigned N = N__,
                   unsigned M = M__>
-        matrix(typename std::enable_if<N * M == 3, T__>::type x0, T__ x1, T__ x2) {
+        constexpr matrix(typename std::enable_if<N * M == 3, T__>::type x0, T__ x1, T__ x2) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
             buffer_[0] = x0;
             buffer_[1] = x1;
             buffer_[2] = x2;
@@ -129,9 +145,8 @@ namespace calc {
         /// ctor.
         template <unsigned N = N__,
                   unsigned M = M__>
-        matrix(typename std::enable_if<N * M == 4, T__>::type x0, T__ x1, T__ x2, T__ x3) {
+        constexpr matrix(typename std::enable_if<N * M == 4, T__>::type x0, T__ x1, T__ x2, T__ x3) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
             buffer_[0] = x0;
             buffer_[1] = x1;
             buffer_[2] = x2;
@@ -141,11 +156,10 @@ namespace calc {
         /// ctor.
         template <unsigned N = N__,
                   unsigned M = M__>
-        matrix(typename std::enable_if<N * M == 9, T__>::type x0, T__ x1, T__ x2,
-               T__ x3, T__ x4, T__ x5,
-               T__ x6, T__ x7, T__ x8) {
+        constexpr matrix(typename std::enable_if<N * M == 9, T__>::type x0, T__ x1, T__ x2,
+                         T__ x3, T__ x4, T__ x5,
+                         T__ x6, T__ x7, T__ x8) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
             buffer_[0] = x0;
             buffer_[1] = x1;
             buffer_[2] = x2;
@@ -162,12 +176,11 @@ namespace calc {
         /// ctor.
         template <unsigned N = N__,
                   unsigned M = M__>
-        matrix(typename std::enable_if<N * M == 16, T__>::type x0, T__ x1, T__ x2, T__ x3,
-               T__ x4,  T__ x5,  T__ x6,  T__ x7,
-               T__ x8,  T__ x9,  T__ x10, T__ x11,
-               T__ x12, T__ x13, T__ x14, T__ x15) {
+        constexpr matrix(typename std::enable_if<N * M == 16, T__>::type x0, T__ x1, T__ x2, T__ x3,
+                         T__ x4,  T__ x5,  T__ x6,  T__ x7,
+                         T__ x8,  T__ x9,  T__ x10, T__ x11,
+                         T__ x12, T__ x13, T__ x14, T__ x15) : buffer_() {
 
-            std::memset(buffer_, 0, sizeof(buffer_));
             buffer_[ 0] = x0;
             buffer_[ 1] = x1;
             buffer_[ 2] = x2;
@@ -189,53 +202,53 @@ namespace calc {
             buffer_[15] = x15;
         }
 
-        unsigned rows() const {
+        constexpr unsigned rows() const {
             return N__;
         }
 
-        unsigned cols() const {
+        constexpr unsigned cols() const {
             return M__;
         }
 
-        unsigned size() const {
+        constexpr unsigned size() const {
             return N__ * M__;
         }
 
         /// @overload
         template <unsigned N = N__,
                   unsigned M = M__>
-        typename std::enable_if<N == 1 || M == 1, T__&>::type operator[](unsigned i) {
+        constexpr typename std::enable_if<N == 1 || M == 1, T__&>::type operator[](unsigned i) {
             return buffer_[i];
         }
 
         /// @overload
         template <unsigned N = N__,
                   unsigned M = M__>
-        typename std::enable_if<N == 1 || M == 1, const T__&>::type operator[](unsigned i) const {
+        constexpr typename std::enable_if<N == 1 || M == 1, const T__&>::type operator[](unsigned i) const {
             return buffer_[i];
         }
 
         /// @overload
         template <unsigned N = N__,
                   unsigned M = M__>
-        typename std::enable_if<(N > 1 && M > 1), T__*>::type operator[](unsigned r) {
+        constexpr typename std::enable_if<(N > 1 && M > 1), T__*>::type operator[](unsigned r) {
             return &buffer_[r * M__];
         }
 
         /// @overload
         template <unsigned N = N__,
                   unsigned M = M__>
-        typename std::enable_if<(N > 1 && M > 1), const T__*>::type operator[](unsigned r) const {
+        constexpr typename std::enable_if<(N > 1 && M > 1), const T__*>::type operator[](unsigned r) const {
             return &buffer_[r * M__];
         }
 
         /// @overload
-        T__& operator()(const unsigned r, const unsigned c) {
+        constexpr T__& operator()(const unsigned r, const unsigned c) {
             return buffer_[r * M__ + c];
         }
 
         /// @overload
-        const T__& operator()(const unsigned r, const unsigned c) const {
+        constexpr const T__& operator()(const unsigned r, const unsigned c) const {
             return buffer_[r * M__ + c];
         }
 
@@ -243,7 +256,7 @@ namespace calc {
         template <unsigned M1>
         matrix<T__, N__, M1> operator*(const matrix<T__, M__, M1>& rhs) const {
 #ifdef __NO_USE_SIMD__
-            matrix<T__, N__, M1> out;
+            matrix<T__, N__, M1> out(uninit);
 
             for (unsigned r = 0; r != N__; ++r)
             {
@@ -261,7 +274,7 @@ namespace calc {
                 }
             }
 #else
-            matrix<T__, N__, M1> out;
+            matrix<T__, N__, M1> out(uninit);
             matrix_mul<T__, N__, M__, M1>::mul(buffer_, data(rhs), data(out));
 #endif
             return out;
@@ -270,11 +283,11 @@ namespace calc {
         /// @overload
         matrix<T__, N__, M__> operator*(const T__ scalar) const {
 #ifdef __NO_USE_SIMD__
-            matrix<T__, N__, M__> out;
+            matrix<T__, N__, M__> out(uninit);
             for (unsigned i = 0; i != size(); ++i)
                 out.buffer_[i] = buffer_[i] * scalar;
 #else
-            matrix<T__, N__, M__> out;
+            matrix<T__, N__, M__> out(uninit);
             scalar_mul<T__, N__ * M__>::mul(buffer_, scalar, out.buffer_, size());
 #endif
             return out;
@@ -283,12 +296,12 @@ namespace calc {
         /// @overload
         matrix<T__, N__, M__> operator/(const T__ scalar) const {
 #ifdef __NO_USE_SIMD__
-            matrix<T__, N__, M__> out;
+            matrix<T__, N__, M__> out(uninit);
             for (unsigned i = 0; i != size(); ++i) {
                 out.buffer_[i] = buffer_[i] / scalar;
             }
 #else
-            matrix<T__, N__, M__> out;
+            matrix<T__, N__, M__> out(uninit);
             scalar_div<T__, N__ * M__>::div(buffer_, scalar, out.buffer_, size());
 #endif
             return out;
@@ -310,7 +323,7 @@ namespace calc {
 #ifdef __NO_USE_SIMD__
             return (*this = (*this * scalar));
 #else
-            scalar_mul<T__, matrix<T__, N__, M__>::size()>::mul(buffer_, scalar, buffer_, size());
+            scalar_mul<T__, N__ * M__>::mul(buffer_, scalar, buffer_, size());
             return *this;
 #endif
         }
@@ -328,7 +341,7 @@ namespace calc {
         /// @overload
         matrix<T__, N__, M__> operator+(const matrix<T__, N__, M__>& rhs) const {
 #ifdef __NO_USE_SIMD__
-            matrix<T__, N__, M__> out;
+            matrix<T__, N__, M__> out(uninit);
             for (unsigned r = 0; r != N__; ++r)
             {
                 for (unsigned c = 0; c != M__; ++c) {
@@ -336,8 +349,8 @@ namespace calc {
                 }
             }
 #else
-            matrix<T__, N__, M__> out;
-            matrix_add<T__, sizeof(T__)>::add(buffer_, rhs.buffer_, out.buffer_, size());
+            matrix<T__, N__, M__> out(uninit);
+            matrix_add<T__, N__ * M__>::add(buffer_, rhs.buffer_, out.buffer_, size());
 #endif
             return out;
         }
@@ -347,7 +360,7 @@ namespace calc {
 #ifdef __NO_USE_SIMD__
             return (*this = (*this + rhs));
 #else
-            matrix_add<T__, sizeof(T__)>::add(buffer_, rhs.buffer_, buffer_, size());
+            matrix_add<T__, N__ * M__>::add(buffer_, rhs.buffer_, buffer_, size());
             return *this;
 #endif
         }
@@ -355,7 +368,7 @@ namespace calc {
         /// @overload
         matrix<T__, N__, M__> operator-(const matrix<T__, N__, M__>& rhs) const {
 #ifdef __NO_USE_SIMD__
-            matrix<T__, N__, M__> out;
+            matrix<T__, N__, M__> out(uninit);
             for (unsigned r = 0; r != N__; ++r)
             {
                 for (unsigned c = 0; c != M__; ++c) {
@@ -363,8 +376,8 @@ namespace calc {
                 }
             }
 #else
-            matrix<T__, N__, M__> out;
-            matrix_sub<T__, sizeof(T__)>::sub(buffer_, rhs.buffer_, out.buffer_, size());
+            matrix<T__, N__, M__> out(uninit);
+            matrix_sub<T__, N__ * M__>::sub(buffer_, rhs.buffer_, out.buffer_, size());
 #endif
             return out;
         }
@@ -372,9 +385,9 @@ namespace calc {
         /// @overload
         matrix<T__, N__, M__>& operator-=(const matrix<T__, N__, M__>& rhs) {
 #ifdef __NO_USE_SIMD__
-            return (*this = (*this + rhs));
+            return (*this = (*this - rhs));
 #else
-            matrix_sub<T__, sizeof(T__)>::sub(buffer_, rhs.buffer_, buffer_, size());
+            matrix_sub<T__, N__ * M__>::sub(buffer_, rhs.buffer_, buffer_, size());
             return *this;
 #endif
         }
@@ -409,6 +422,20 @@ namespace calc {
     typedef matrix<float, 3, 1> vec3f;
     // 4x1
     typedef matrix<float, 4, 1> vec4f;
+
+    // 2x2
+    typedef matrix<double, 2, 2> mat2d;
+    // 3x3
+    typedef matrix<double, 3, 3> mat3d;
+    // 4x4
+    typedef matrix<double, 4, 4> mat4d;
+
+    // 2x1
+    typedef matrix<double, 2, 1> vec2d;
+    // 3x1
+    typedef matrix<double, 3, 1> vec3d;
+    // 4x1
+    typedef matrix<double, 4, 1> vec4d;
 }
 
 #endif
@@ -4,22 +4,164 @@
 #define _CALC_MATRIX_OPERATION_HPP
 
 namespace calc {
+#ifndef __NO_USE_SIMD__
+    namespace detail {
 
+        /// @return sum of the four lanes of v
+        inline float hsum(const __m128 v) {
+
+            const __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+            return _mm_cvtss_f32(_mm_add_ss(s, _mm_movehdup_ps(s)));
+        }
+
+        /// @return sum over the registers of lhs[i] * rhs[i]; padding lanes are
+        ///         zero and add nothing
+        template <unsigned N>
+        inline __m128 dot_ps(const float* lhs, const float* rhs) {
+
+            __m128 sum = _mm_mul_ps(_mm_load_ps(lhs), _mm_load_ps(rhs));
+            for (unsigned i = 4; i < N; i += 4)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(lhs + i), _mm_load_ps(rhs + i)));
+            return sum;
+        }
+
+        /// @return cross product of the first three lanes; lane 3 is zero
+        ///         for finite input
+        inline __m128 cross_ps(const __m128 x, const __m128 y) {
+
+            // x.yzx * y.zxy - x.zxy * y.yzx
+            const __m128 x1 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 0, 2, 1));
+            const __m128 y1 = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 0, 2, 1));
+            const __m128 x2 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 1, 0, 2));
+            const __m128 y2 = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 1, 0, 2));
+            return _mm_sub_ps(_mm_mul_ps(x1, y2), _mm_mul_ps(x2, y1));
+        }
+
+        /// @return cross product of 4-float vectors, lane 3 cleared
+        template <unsigned N>
+        inline matrix<float, N, 1> cross_ps(const matrix<float, N, 1>& lhs, const matrix<float, N, 1>& rhs) {
+
+            matrix<float, N, 1> out(uninit);
+            const __m128 c = cross_ps(_mm_load_ps(static_cast<const float*>(lhs)), _mm_load_ps(static_cast<const float*>(rhs)));
+            _mm_store_ps(static_cast<float*>(out), _mm_blend_ps(c, _mm_setzero_ps(), 0x8));
+            return out;
+        }
+
+        /// @return transposed 4x4 matrix, four rows in registers
+        inline mat4f transpose_ps(const mat4f& in) {
+
+            const float* d = static_cast<const float*>(in);
+            __m128 r0 = _mm_load_ps(d);
+            __m128 r1 = _mm_load_ps(d + 4);
+            __m128 r2 = _mm_load_ps(d + 8);
+            __m128 r3 = _mm_load_ps(d + 12);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            mat4f out(uninit);
+            float* o = static_cast<float*>(out);
+            _mm_store_ps(o, r0);
+            _mm_store_ps(o + 4, r1);
+            _mm_store_ps(o + 8, r2);
+            _mm_store_ps(o + 12, r3);
+            return out;
+        }
+
+        /// @return 2x2 product a * b; 2x2 matrices are row-major in one register
+        inline __m128 mul_2x2_ps(const __m128 a, const __m128 b) {
+
+            return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+                              _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+        }
+
+        /// @return 2x2 product adj(a) * b
+        inline __m128 adj_mul_2x2_ps(const __m128 a, const __m128 b) {
+
+            return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+                              _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+
+        /// @return 2x2 product a * adj(b)
+        inline __m128 mul_adj_2x2_ps(const __m128 a, const __m128 b) {
+
+            return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+                              _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+        }
+
+        /// Inverse of a 4x4 matrix from its 2x2 blocks [ A B ; C D ] and their
+        /// adjugates (no pivoting; not finite if in is singular)
+        /// @param out inverse of in; none if null
+        /// @return determinant of in, in every lane
+        inline __m128 inverse_ps(const mat4f& in, mat4f* out) {
+
+            const float* d = static_cast<const float*>(in);
+            const __m128 r0 = _mm_load_ps(d);
+            const __m128 r1 = _mm_load_ps(d + 4);
+            const __m128 r2 = _mm_load_ps(d + 8);
+            const __m128 r3 = _mm_load_ps(d + 12);
+
+            const __m128 a = _mm_movelh_ps(r0, r1);
+            const __m128 b = _mm_movehl_ps(r1, r0);
+            const __m128 c = _mm_movelh_ps(r2, r3);
+            const __m128 e = _mm_movehl_ps(r3, r2);
+
+            // (|A|, |B|, |C|, |D|)
+            const __m128 dets = _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+                                           _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+
+            const __m128 detA = _mm_shuffle_ps(dets, dets, 0x00);
+            const __m128 detB = _mm_shuffle_ps(dets, dets, 0x55);
+            const __m128 detC = _mm_shuffle_ps(dets, dets, 0xaa);
+            const __m128 detD = _mm_shuffle_ps(dets, dets, 0xff);
+
+            const __m128 dc = adj_mul_2x2_ps(e, c);
+            const __m128 ab = adj_mul_2x2_ps(a, b);
+
+            // |M| = |A| |D| + |B| |C| - tr(adj(A) B adj(D) C)
+            __m128 tr = _mm_mul_ps(ab, _mm_shuffle_ps(dc, dc, _MM_SHUFFLE(3, 1, 2, 0)));
+            tr = _mm_hadd_ps(tr, tr);
+            tr = _mm_hadd_ps(tr, tr);
+
+            const __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+            if (!out) {
+                return det;
+            }
+
+            // Blocks of adj(M), each to be transposed below
+            const __m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), mul_2x2_ps(b, dc));
+            const __m128 w = _mm_sub_ps(_mm_mul_ps(detA, e), mul_2x2_ps(c, ab));
+            const __m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), mul_adj_2x2_ps(e, ab));
+            const __m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), mul_adj_2x2_ps(a, dc));
+
+            const __m128 scale = _mm_div_ps(_mm_setr_ps(1, -1, -1, 1), det);
+            const __m128 xs = _mm_mul_ps(x, scale);
+            const __m128 ys = _mm_mul_ps(y, scale);
+            const __m128 zs = _mm_mul_ps(z, scale);
+            const __m128 ws = _mm_mul_ps(w, scale);
+
+            float* o = static_cast<float*>(*out);
+            _mm_store_ps(o, _mm_shuffle_ps(xs, ys, _MM_SHUFFLE(1, 3, 1, 3)));
+            _mm_store_ps(o + 4, _mm_shuffle_ps(xs, ys, _MM_SHUFFLE(0, 2, 0, 2)));
+            _mm_store_ps(o + 8, _mm_shuffle_ps(zs, ws, _MM_SHUFFLE(1, 3, 1, 3)));
+            _mm_store_ps(o + 12, _mm_shuffle_ps(zs, ws, _MM_SHUFFLE(0, 2, 0, 2)));
+            return det;
+        }
+    }
+#endif
     /// @return pointer to the data
     template <typename T,
               unsigned N,
               unsigned M>
-    inline T* data(matrix<T, N, M>& m) { return static_cast<T*>(m); }
+    constexpr T* data(matrix<T, N, M>& m) { return static_cast<T*>(m); }
 
     /// @return pointer to matrix data
     template <typename T,
               unsigned N,
               unsigned M>
-    inline const T* data(const matrix<T, N, M>& m) { return static_cast<const T*>(m); }
+    constexpr const T* data(const matrix<T, N, M>& m) { return static_cast<const T*>(m); }
 
     /// @return cross product
     template <typename T>
-    inline matrix<T, 4, 1> cross(const matrix<T, 4, 1>& lhs, const matrix<T, 4, 1>& rhs)
+    constexpr matrix<T, 4, 1> cross(const matrix<T, 4, 1>& lhs, const matrix<T, 4, 1>& rhs)
     {
         matrix<T, 4, 1> out;
 
@@ -32,7 +174,7 @@ namespace calc {
 
     /// @return cross product
     template <typename T>
-    inline matrix<T, 3, 1> cross(const matrix<T, 3, 1>& lhs, const matrix<T, 3, 1>& rhs)
+    constexpr matrix<T, 3, 1> cross(const matrix<T, 3, 1>& lhs, const matrix<T, 3, 1>& rhs)
     {
         matrix<T, 3, 1> out;
 
@@ -42,10 +184,23 @@ namespace calc {
 
         return out;
     }
+#ifndef __NO_USE_SIMD__
+    /// @return cross product; SIMD at run time, the scalar template in
+    ///         constant expressions
+    constexpr vec3f cross(const vec3f& lhs, const vec3f& rhs)
+    {
+        return __builtin_is_constant_evaluated() ? cross<float>(lhs, rhs) : detail::cross_ps(lhs, rhs);
+    }
 
+    /// @overload
+    constexpr vec4f cross(const vec4f& lhs, const vec4f& rhs)
+    {
+        return __builtin_is_constant_evaluated() ? cross<float>(lhs, rhs) : detail::cross_ps(lhs, rhs);
+    }
+#endif
     /// @return cross product
     template <typename T>
-    inline matrix<T, 3, 1> cross(const matrix<T, 1, 3>& lhs, const matrix<T, 1, 3>& rhs)
+    constexpr matrix<T, 3, 1> cross(const matrix<T, 1, 3>& lhs, const matrix<T, 1, 3>& rhs)
     {
         matrix<T, 3, 1> out;
 
@@ -61,32 +216,250 @@ namespace calc {
               unsigned N>
     inline matrix<T, N, 1> normal(const matrix<T, N, 1>& in)
     {
+        const T* d = data(in);
+
+        T mag = 0;
+        for (unsigned i = 0; i != N; ++i)
+            mag += (d[i] * d[i]);
+        return in / std::sqrt(mag);
+    }
+
+    /// @overload
+    template <unsigned N>
+    inline matrix<float, N, 1> normal(const matrix<float, N, 1>& in)
+    {
+#ifdef __NO_USE_SIMD__
         const float* d = data(in);
 
         float mag = 0;
         for (unsigned i = 0; i != N; ++i)
             mag += (d[i] * d[i]);
         return in / std::sqrt(mag);
+#else
+        const float* d = data(in);
+        const __m128 mag = _mm_sqrt_ps(_mm_set1_ps(detail::hsum(detail::dot_ps<N>(d, d))));
+
+        matrix<float, N, 1> out(uninit);
+        for (unsigned i = 0; i < N; i += 4)
+            _mm_store_ps(data(out) + i, _mm_div_ps(_mm_load_ps(d + i), mag));
+        return out;
+#endif
+    }
+
+    /// @return normalized vector, from a reciprocal square root estimate
+    ///         refined by one Newton-Raphson step (relative error about 1e-7)
+    template <unsigned N>
+    inline matrix<float, N, 1> normal_fast(const matrix<float, N, 1>& in)
+    {
+#ifdef __NO_USE_SIMD__
+        return normal(in);
+#else
+        const float* d = data(in);
+        const __m128 r = detail::sse4_kernels::rsqrt_nr(_mm_set1_ps(detail::hsum(detail::dot_ps<N>(d, d))));
+
+        matrix<float, N, 1> out(uninit);
+        for (unsigned i = 0; i < N; i += 4)
+            _mm_store_ps(data(out) + i, _mm_mul_ps(_mm_load_ps(d + i), r));
+        return out;
+#endif
     }
 
     /// @return transposed matrix
     template <typename T,
               unsigned N,
               unsigned M>
-    inline matrix<T, M, N> transpose(const matrix<T, N, M>& in)
+    constexpr matrix<T, M, N> transpose(const matrix<T, N, M>& in)
     {
         matrix<T, M, N> out;
 
         std::size_t i = 0;
         for ( ; i != in.size(); ++i)
         {
-            std::size_t r = i / N;
-            std::size_t c = i % N;
+            std::size_t r = i / M;
+            std::size_t c = i % M;
             out(c, r) = in(r, c);
         }
 
         return out;
     }
+#ifndef __NO_USE_SIMD__
+    /// @overload
+    /// In registers at run time, the scalar template in constant expressions
+    constexpr mat4f transpose(const mat4f& in)
+    {
+        return __builtin_is_constant_evaluated() ? transpose<float, 4, 4>(in) : detail::transpose_ps(in);
+    }
+#endif
+    /// Batched transpose: out[i] = transpose(in[i]) for i < size, e.g. to
+    /// produce column-major matrices for upload; out may alias in
+    inline void transpose(const mat4f* in, mat4f* out, const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        for (std::size_t i = 0; i != size; ++i)
+            out[i] = transpose(in[i]);
+#else
+        detail::kernels().transpose_4x4(reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size);
+#endif
+    }
+
+    /// @return determinant
+    template <typename T>
+    inline T determinant(const matrix<T, 2, 2>& m)
+    {
+        return m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0);
+    }
+
+    /// @return determinant
+    template <typename T>
+    inline T determinant(const matrix<T, 3, 3>& m)
+    {
+        return m(0, 0) * (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1))
+             - m(0, 1) * (m(1, 0) * m(2, 2) - m(1, 2) * m(2, 0))
+             + m(0, 2) * (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0));
+    }
+
+    /// @return determinant, by Laplace expansion over the 2x2 minors of the
+    ///         top and bottom row pairs
+    template <typename T>
+    inline T determinant(const matrix<T, 4, 4>& m)
+    {
+        const T s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+        const T s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+        const T s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+        const T s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+        const T s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+        const T s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+
+        const T c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+        const T c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+        const T c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+        const T c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+        const T c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+        const T c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+
+        return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    }
+
+    /// @return inverse; not finite if m is singular
+    template <typename T>
+    inline matrix<T, 2, 2> inverse(const matrix<T, 2, 2>& m)
+    {
+        const T inv = T(1) / determinant(m);
+
+        matrix<T, 2, 2> out(uninit);
+        out(0, 0) =  m(1, 1) * inv;
+        out(0, 1) = -m(0, 1) * inv;
+        out(1, 0) = -m(1, 0) * inv;
+        out(1, 1) =  m(0, 0) * inv;
+        return out;
+    }
+
+    /// @return inverse; not finite if m is singular
+    template <typename T>
+    inline matrix<T, 3, 3> inverse(const matrix<T, 3, 3>& m)
+    {
+        matrix<T, 3, 3> out(uninit);
+
+        // Transposed cofactors over the determinant
+        out(0, 0) = m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1);
+        out(0, 1) = m(0, 2) * m(2, 1) - m(0, 1) * m(2, 2);
+        out(0, 2) = m(0, 1) * m(1, 2) - m(0, 2) * m(1, 1);
+        out(1, 0) = m(1, 2) * m(2, 0) - m(1, 0) * m(2, 2);
+        out(1, 1) = m(0, 0) * m(2, 2) - m(0, 2) * m(2, 0);
+        out(1, 2) = m(0, 2) * m(1, 0) - m(0, 0) * m(1, 2);
+        out(2, 0) = m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0);
+        out(2, 1) = m(0, 1) * m(2, 0) - m(0, 0) * m(2, 1);
+        out(2, 2) = m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0);
+
+        const T inv = T(1) / (m(0, 0) * out(0, 0) + m(0, 1) * out(1, 0) + m(0, 2) * out(2, 0));
+
+        T* d = data(out);
+        for (unsigned i = 0; i != 9; ++i)
+            d[i] *= inv;
+        return out;
+    }
+
+    /// @return inverse; not finite if m is singular
+    template <typename T>
+    inline matrix<T, 4, 4> inverse(const matrix<T, 4, 4>& m)
+    {
+        const T s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+        const T s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+        const T s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+        const T s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+        const T s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+        const T s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+
+        const T c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+        const T c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+        const T c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+        const T c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+        const T c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+        const T c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+
+        const T inv = T(1) / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+        matrix<T, 4, 4> out(uninit);
+        out(0, 0) = ( m(1, 1) * c5 - m(1, 2) * c4 + m(1, 3) * c3) * inv;
+        out(0, 1) = (-m(0, 1) * c5 + m(0, 2) * c4 - m(0, 3) * c3) * inv;
+        out(0, 2) = ( m(3, 1) * s5 - m(3, 2) * s4 + m(3, 3) * s3) * inv;
+        out(0, 3) = (-m(2, 1) * s5 + m(2, 2) * s4 - m(2, 3) * s3) * inv;
+
+        out(1, 0) = (-m(1, 0) * c5 + m(1, 2) * c2 - m(1, 3) * c1) * inv;
+        out(1, 1) = ( m(0, 0) * c5 - m(0, 2) * c2 + m(0, 3) * c1) * inv;
+        out(1, 2) = (-m(3, 0) * s5 + m(3, 2) * s2 - m(3, 3) * s1) * inv;
+        out(1, 3) = ( m(2, 0) * s5 - m(2, 2) * s2 + m(2, 3) * s1) * inv;
+
+        out(2, 0) = ( m(1, 0) * c4 - m(1, 1) * c2 + m(1, 3) * c0) * inv;
+        out(2, 1) = (-m(0, 0) * c4 + m(0, 1) * c2 - m(0, 3) * c0) * inv;
+        out(2, 2) = ( m(3, 0) * s4 - m(3, 1) * s2 + m(3, 3) * s0) * inv;
+        out(2, 3) = (-m(2, 0) * s4 + m(2, 1) * s2 - m(2, 3) * s0) * inv;
+
+        out(3, 0) = (-m(1, 0) * c3 + m(1, 1) * c1 - m(1, 2) * c0) * inv;
+        out(3, 1) = ( m(0, 0) * c3 - m(0, 1) * c1 + m(0, 2) * c0) * inv;
+        out(3, 2) = (-m(3, 0) * s3 + m(3, 1) * s1 - m(3, 2) * s0) * inv;
+        out(3, 3) = ( m(2, 0) * s3 - m(2, 1) * s1 + m(2, 2) * s0) * inv;
+        return out;
+    }
+#ifndef __NO_USE_SIMD__
+    /// @overload
+    inline float determinant(const mat4f& m)
+    {
+        return _mm_cvtss_f32(detail::inverse_ps(m, nullptr));
+    }
+
+    /// @overload
+    /// In registers, from 2x2 blocks; for rigid and affine transforms
+    /// inverse_rigid() and inverse_affine() are cheaper
+    inline mat4f inverse(const mat4f& m)
+    {
+        mat4f out(uninit);
+        detail::inverse_ps(m, &out);
+        return out;
+    }
+#endif
+    /// @return lhs * rhs, evaluated in a constant expression where possible;
+    ///         at run time the SIMD operator* is faster
+    template <typename T,
+              unsigned N,
+              unsigned M,
+              unsigned M1>
+    constexpr matrix<T, N, M1> static_product(const matrix<T, N, M>& lhs, const matrix<T, M, M1>& rhs)
+    {
+        matrix<T, N, M1> out;
+        for (unsigned r = 0; r != N; ++r)
+        {
+            for (unsigned c = 0; c != M1; ++c)
+            {
+                T sum = 0;
+                for (unsigned i = 0; i != M; ++i)
+                    sum += lhs(r, i) * rhs(i, c);
+                out(r, c) = sum;
+            }
+        }
+
+        return out;
+    }
 
     /// @return absolute-valued matrix
     template <typename T,
@@ -94,7 +467,7 @@ namespace calc {
               unsigned M>
     inline matrix<T, N, M> abs(const matrix<T, N, M>& inp)
     {
-        matrix<T, N, M> out;
+        matrix<T, N, M> out(uninit);
         for (unsigned r = 0; r != N; ++r)
         {
             for (unsigned c = 0; c != M; ++c) {
@@ -104,26 +477,47 @@ namespace calc {
 
         return out;
     }
+#ifndef __NO_USE_SIMD__
+    /// @overload
+    template <unsigned N,
+              unsigned M>
+    inline matrix<float, N, M> abs(const matrix<float, N, M>& inp)
+    {
+        const __m128 sign = _mm_set1_ps(-0.0f);
 
+        matrix<float, N, M> out(uninit);
+        for (unsigned i = 0; i < N * M; i += 4)
+            _mm_store_ps(data(out) + i, _mm_andnot_ps(sign, _mm_load_ps(data(inp) + i)));
+        return out;
+    }
+#endif
     template <unsigned N>
     inline matrix<float, N, 1> max(const matrix<float, N, 1>& lhs, const matrix<float, N, 1>& rhs)
     {
-        matrix<float, N, 1> out;
-
+        matrix<float, N, 1> out(uninit);
+#ifdef __NO_USE_SIMD__
         unsigned i = 0;
         for ( ; i != N; ++i)
             out[i] = (lhs[i] >= rhs[i]) ? lhs[i] : rhs[i];
+#else
+        for (unsigned i = 0; i < N; i += 4)
+            _mm_store_ps(data(out) + i, _mm_max_ps(_mm_load_ps(data(lhs) + i), _mm_load_ps(data(rhs) + i)));
+#endif
         return out;
     }
 
     template <unsigned N>
     inline matrix<float, N, 1> min(const matrix<float, N, 1>& lhs, const matrix<float, N, 1>& rhs)
     {
-        matrix<float, N, 1> out;
-
+        matrix<float, N, 1> out(uninit);
+#ifdef __NO_USE_SIMD__
         unsigned i = 0;
         for ( ; i != N; ++i)
             out[i] = (lhs[i] <= rhs[i]) ? lhs[i] : rhs[i];
+#else
+        for (unsigned i = 0; i < N; i += 4)
+            _mm_store_ps(data(out) + i, _mm_min_ps(_mm_load_ps(data(lhs) + i), _mm_load_ps(data(rhs) + i)));
+#endif
         return out;
     }
 
@@ -131,12 +525,62 @@ namespace calc {
     template <unsigned N>
     inline float dot(const matrix<float, N, 1>& lhs, const matrix<float, N, 1>& rhs)
     {
+#ifdef __NO_USE_SIMD__
         float sum = 0;
 
         unsigned i = 0;
         for ( ; i != lhs.size(); ++i)
             sum += lhs[i] * rhs[i];
         return sum;
+#else
+        return detail::hsum(detail::dot_ps<N>(data(lhs), data(rhs)));
+#endif
+    }
+
+    /// Batched dot: out[i] = dot(lhs[i], rhs[i]) for i < size, for vec3f and
+    /// vec4f arrays; 4 or 8 vectors per pass
+    template <unsigned N>
+    inline typename std::enable_if<N == 3 || N == 4>::type dot(const matrix<float, N, 1>* lhs,
+                                                               const matrix<float, N, 1>* rhs,
+                                                               float* out,
+                                                               const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        for (std::size_t i = 0; i != size; ++i)
+            out[i] = dot(lhs[i], rhs[i]);
+#else
+        detail::kernels().dot4(reinterpret_cast<const float*>(lhs), reinterpret_cast<const float*>(rhs), out, size);
+#endif
+    }
+
+    /// Batched normal: out[i] = normal(in[i]) for i < size, for vec3f and vec4f
+    /// arrays; out may alias in
+    template <unsigned N>
+    inline typename std::enable_if<N == 3 || N == 4>::type normal(const matrix<float, N, 1>* in,
+                                                                  matrix<float, N, 1>* out,
+                                                                  const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        for (std::size_t i = 0; i != size; ++i)
+            out[i] = normal(in[i]);
+#else
+        detail::kernels().normal4(reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size);
+#endif
+    }
+
+    /// Batched normal_fast: out[i] = normal_fast(in[i]) for i < size; out may
+    /// alias in
+    template <unsigned N>
+    inline typename std::enable_if<N == 3 || N == 4>::type normal_fast(const matrix<float, N, 1>* in,
+                                                                       matrix<float, N, 1>* out,
+                                                                       const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        for (std::size_t i = 0; i != size; ++i)
+            out[i] = normal_fast(in[i]);
+#else
+        detail::kernels().normal4_fast(reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size);
+#endif
     }
 
     /// @return dot product: lhs * rhs
@@ -0,0 +1,280 @@
+#pragma once
+
+#ifndef _CALC_MATRIX_QUATERNION_HPP
+#define _CALC_MATRIX_QUATERNION_HPP
+
+#include <cmath>
+#include <cstring>
+
+#include "matrix_affine.hpp"
+#include "matrix_nxm.hpp"
+#include "matrix_operation.hpp"
+#include "matrix_transform.hpp"
+
+namespace calc {
+
+    /// class quatf
+    /*! Rotation quaternion, stored (x, y, z, w) in one 16-byte register.
+     *! Products compose like the matching rotation matrices:
+     *! to_mat4(a * b) == to_mat4(a) * to_mat4(b)
+     */
+    class quatf {
+
+        // x, y, z (vector part), w (scalar part)
+        float buffer_[4] __attribute__((aligned(16)));
+
+    public:
+
+        static quatf identity() {
+            return quatf(0, 0, 0, 1);
+        }
+
+        /// @return rotation by rad about axis (normalized here)
+        static quatf from_axis_angle(const vec3f& axis, const float rad) {
+
+            const vec3f n = normal(axis);
+            float s, c;
+            sincos(rad / 2, s, c);
+            return quatf(n[0] * s, n[1] * s, n[2] * s, c);
+        }
+
+        /// @return rotation equal to rotate_4x(x) * rotate_4y(y) * rotate_4z(z)
+        static quatf from_euler(const float x, const float y, const float z) {
+
+            float s[4] __attribute__((aligned(16)));
+            float c[4] __attribute__((aligned(16)));
+#ifdef __NO_USE_SIMD__
+            sincos(x / 2, s[0], c[0]);
+            sincos(y / 2, s[1], c[1]);
+            sincos(z / 2, s[2], c[2]);
+#else
+            // All three half angles in one evaluation
+            __m128 vs, vc;
+            detail::sse4_kernels::sincos4(_mm_setr_ps(x / 2, y / 2, z / 2, 0), vs, vc);
+            _mm_store_ps(s, vs);
+            _mm_store_ps(c, vc);
+#endif
+            const float sx = s[0], cx = c[0];
+            const float sy = s[1], cy = c[1];
+            const float sz = s[2], cz = c[2];
+
+            // (sx, 0, 0, cx) * (0, sy, 0, cy) * (0, 0, sz, cz), expanded
+            return quatf(sx * cy * cz + cx * sy * sz,
+                         cx * sy * cz - sx * cy * sz,
+                         cx * cy * sz + sx * sy * cz,
+                         cx * cy * cz - sx * sy * sz);
+        }
+
+        operator float*() {
+            return buffer_;
+        }
+
+        operator const float*() const {
+            return buffer_;
+        }
+
+        /// ctor.
+        quatf() {
+            std::memset(buffer_, 0, sizeof(buffer_));
+        }
+
+        /// ctor.
+        /// Elements are indeterminate until written
+        explicit quatf(uninit_t) {}
+
+        /// ctor.
+        quatf(const float x, const float y, const float z, const float w) {
+
+            buffer_[0] = x;
+            buffer_[1] = y;
+            buffer_[2] = z;
+            buffer_[3] = w;
+        }
+
+        /// @overload
+        float& operator[](const unsigned i) {
+            return buffer_[i];
+        }
+
+        /// @overload
+        const float& operator[](const unsigned i) const {
+            return buffer_[i];
+        }
+
+        /// @return Hamilton product: rhs applied first
+        quatf operator*(const quatf& rhs) const {
+
+            quatf out(uninit);
+#ifdef __NO_USE_SIMD__
+            const float* a = buffer_;
+            const float* b = rhs.buffer_;
+
+            out[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+            out[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+            out[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+            out[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+#else
+            const __m128 a = _mm_load_ps(buffer_);
+            const __m128 b = _mm_load_ps(rhs.buffer_);
+
+            // Sign masks for the ax, ay, az terms
+            const __m128 sx = _mm_setr_ps(+0.0f, -0.0f, +0.0f, -0.0f);
+            const __m128 sy = _mm_setr_ps(+0.0f, +0.0f, -0.0f, -0.0f);
+            const __m128 sz = _mm_setr_ps(-0.0f, +0.0f, +0.0f, -0.0f);
+
+            // aw * (bx, by, bz, bw)
+            __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, 0xff), b);
+            // ax * (bw, bz, by, bx)
+            r = _mm_add_ps(r, _mm_xor_ps(sx, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)))));
+            // ay * (bz, bw, bx, by)
+            r = _mm_add_ps(r, _mm_xor_ps(sy, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)))));
+            // az * (by, bx, bw, bz)
+            r = _mm_add_ps(r, _mm_xor_ps(sz, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)))));
+
+            _mm_store_ps(out.buffer_, r);
+#endif
+            return out;
+        }
+
+        /// @overload
+        quatf& operator*=(const quatf& rhs) {
+            return (*this = (*this * rhs));
+        }
+    };
+
+    /// @return pointer to the data
+    inline float* data(quatf& q) { return static_cast<float*>(q); }
+
+    /// @return pointer to the data
+    inline const float* data(const quatf& q) { return static_cast<const float*>(q); }
+
+    /// @return 4D dot product
+    inline float dot(const quatf& a, const quatf& b)
+    {
+#ifdef __NO_USE_SIMD__
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+#else
+        return _mm_cvtss_f32(_mm_dp_ps(_mm_load_ps(data(a)), _mm_load_ps(data(b)), 0xf1));
+#endif
+    }
+
+    /// @return inverse rotation of a unit quaternion
+    inline quatf conjugate(const quatf& q) {
+        return quatf(-q[0], -q[1], -q[2], q[3]);
+    }
+
+    /// @return unit quaternion
+    inline quatf normal(const quatf& q)
+    {
+        quatf out(uninit);
+#ifdef __NO_USE_SIMD__
+        const float mag = std::sqrt(dot(q, q));
+        for (unsigned i = 0; i != 4; ++i)
+            out[i] = q[i] / mag;
+#else
+        const __m128 v = _mm_load_ps(data(q));
+        _mm_store_ps(data(out), _mm_div_ps(v, _mm_sqrt_ps(_mm_dp_ps(v, v, 0xff))));
+#endif
+        return out;
+    }
+
+    namespace detail {
+
+        /// @return normal(wa * a + wb * b)
+        inline quatf quat_blend(const quatf& a, const float wa, const quatf& b, const float wb, const bool normalize)
+        {
+            quatf out(uninit);
+#ifdef __NO_USE_SIMD__
+            for (unsigned i = 0; i != 4; ++i)
+                out[i] = wa * a[i] + wb * b[i];
+            return normalize ? normal(out) : out;
+#else
+            __m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(wa), _mm_load_ps(data(a))),
+                                  _mm_mul_ps(_mm_set1_ps(wb), _mm_load_ps(data(b))));
+            if (normalize) {
+                v = _mm_div_ps(v, _mm_sqrt_ps(_mm_dp_ps(v, v, 0xff)));
+            }
+
+            _mm_store_ps(data(out), v);
+            return out;
+#endif
+        }
+    }
+
+    /// @return normalized linear interpolation between unit quaternions, along the shorter arc
+    inline quatf nlerp(const quatf& a, const quatf& b, const float t)
+    {
+        const float sign = (dot(a, b) < 0) ? -1 : 1;
+        return detail::quat_blend(a, 1 - t, b, sign * t, true);
+    }
+
+    /// @return spherical linear interpolation between unit quaternions, along the shorter arc
+    inline quatf slerp(const quatf& a, const quatf& b, const float t)
+    {
+        float cosine = dot(a, b);
+        const float sign = (cosine < 0) ? -1 : 1;
+        cosine *= sign;
+
+        // Nearly parallel: sin(theta) vanishes, nlerp is accurate
+        if (cosine > 0.9995f) {
+            return detail::quat_blend(a, 1 - t, b, sign * t, true);
+        }
+
+        const float theta = std::acos(cosine);
+        const float sine = std::sin(theta);
+
+        return detail::quat_blend(a, std::sin((1 - t) * theta) / sine, b, sign * std::sin(t * theta) / sine, false);
+    }
+
+    /// @return rotation of q with translation t, as an affine transform
+    inline affine3f to_affine(const quatf& q, const vec3f& t = vec3f())
+    {
+        affine3f out(uninit);
+        float* o = data(out);
+#ifdef __NO_USE_SIMD__
+        const float x = q[0], y = q[1], z = q[2], w = q[3];
+
+        const float d[3] = { 1 - 2 * (y * y + z * z), 1 - 2 * (x * x + z * z), 1 - 2 * (x * x + y * y) };
+        const float p[3] = { 2 * (x * y + z * w), 2 * (x * z + y * w), 2 * (y * z + x * w) };
+        const float m[3] = { 2 * (x * y - z * w), 2 * (x * z - y * w), 2 * (y * z - x * w) };
+#else
+        const __m128 v = _mm_load_ps(data(q));
+        const __m128 v2 = _mm_add_ps(v, v);
+
+        // 2 * (xx, yy, zz), then the diagonal 1 - 2 * (yy + zz, xx + zz, xx + yy)
+        const __m128 sq = _mm_mul_ps(v, v2);
+        const __m128 diag = _mm_sub_ps(_mm_set1_ps(1),
+                                       _mm_add_ps(_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(3, 0, 0, 1)),
+                                                  _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(3, 1, 2, 2))));
+
+        // 2 * (xy, xz, yz) and 2 * (zw, yw, xw)
+        const __m128 pr = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 0, 0)), _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 2, 2, 1)));
+        const __m128 wr = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2)), _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 3, 3, 3)));
+
+        float d[4] __attribute__((aligned(16)));
+        float p[4] __attribute__((aligned(16)));
+        float m[4] __attribute__((aligned(16)));
+
+        _mm_store_ps(d, diag);
+        _mm_store_ps(p, _mm_add_ps(pr, wr));
+        _mm_store_ps(m, _mm_sub_ps(pr, wr));
+#endif
+        o[ 0] = d[0]; o[ 1] = m[0]; o[ 2] = p[1]; o[ 3] = t[0];
+        o[ 4] = p[0]; o[ 5] = d[1]; o[ 6] = m[2]; o[ 7] = t[1];
+        o[ 8] = m[1]; o[ 9] = p[2]; o[10] = d[2]; o[11] = t[2];
+
+        return out;
+    }
+
+    /// @return rotation matrix of q
+    inline mat4f to_mat4(const quatf& q) {
+        return to_affine(q).to_mat4();
+    }
+
+    /// @return v rotated by q
+    inline vec3f rotate(const quatf& q, const vec3f& v) {
+        return transform_vector(to_affine(q), v);
+    }
+}
+
+#endif
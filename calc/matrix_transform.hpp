@@ -3,92 +3,392 @@
 #ifndef _CALC_TRANSFORM_HPP
 #define _CALC_TRANSFORM_HPP
 
-#include "calc/matrix.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "matrix_affine.hpp"
+#include "matrix_nxm.hpp"
 
 namespace calc {
 
     /// 3.1415926...
-    static const float PI = ::atan(1.0) * 4;
+    static constexpr float PI = 3.14159265358979323846f;
 
     /// @return angle in radians
-    static inline float radians(const float deg) {
+    static constexpr float radians(const float deg) {
         return PI * deg / 180.0;
     }
 
+    /// Sine and cosine of one angle in a single evaluation
+    /// Max error 1.5 ulp for |rad| <= pi, absolute error below 8e-8 for |rad| <= 8192
+    /// (see sse4_kernels::sincos4)
+    static inline void sincos(const float rad, float& s, float& c)
+    {
+#ifdef __NO_USE_SIMD__
+        s = std::sin(rad);
+        c = std::cos(rad);
+#else
+        __m128 vs, vc;
+        detail::sse4_kernels::sincos4(_mm_set_ss(rad), vs, vc);
+        s = _mm_cvtss_f32(vs);
+        c = _mm_cvtss_f32(vc);
+#endif
+    }
+
+    /// s[i], c[i] = sin(rad[i]), cos(rad[i]) for i < size, 4 or 8 angles per instruction
+    /// Max error 1.5 ulp for |rad| <= pi, absolute error below 8e-8 for |rad| <= 8192
+    /// (see sse4_kernels::sincos4)
+    static inline void sincos(const float* rad, float* s, float* c, const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        for (std::size_t i = 0; i != size; ++i)
+            sincos(rad[i], s[i], c[i]);
+#else
+        detail::kernels().sincos(rad, s, c, size);
+#endif
+    }
+
+    namespace detail {
+        /// @return rotation matrix from sin and cos of the angle
+        inline mat4f rotate_4x(const float s, const float c)
+        {
+            const float r[] = {
+                1, 0, 0, 0,
+                0, c, -s, 0,
+                0, s, +c, 0,
+                0, 0, 0, 1,
+            };
+
+            return mat4f(r);
+        }
+
+        /// @return rotation matrix from sin and cos of the angle
+        inline mat3f rotate_3x(const float s, const float c)
+        {
+            const float r[] = {
+                1, 0, 0,
+                0, c, -s,
+                0, s, +c,
+            };
+
+            return mat3f(r);
+        }
+
+        /// @return rotation matrix from sin and cos of the angle
+        inline mat4f rotate_4y(const float s, const float c)
+        {
+            const float r[] = {
+                +c, 0, s, 0,
+                0, 1, 0, 0,
+                -s, 0, c, 0,
+                0, 0, 0, 1,
+            };
+
+            return mat4f(r);
+        }
+
+        /// @return rotation matrix from sin and cos of the angle
+        inline mat3f rotate_3y(const float s, const float c)
+        {
+            const float r[] = {
+                +c, 0, s,
+                0, 1, 0,
+                -s, 0, c,
+            };
+
+            return mat3f(r);
+        }
+
+        /// @return rotation matrix from sin and cos of the angle
+        inline mat4f rotate_4z(const float s, const float c)
+        {
+            const float r[] = {
+                c, -s, 0, 0,
+                s, +c, 0, 0,
+                0, 0, 1, 0,
+                0, 0, 0, 1,
+            };
+
+            return mat4f(r);
+        }
+
+        /// @return rotation matrix from sin and cos of the angle
+        inline mat3f rotate_3z(const float s, const float c)
+        {
+            const float r[] = {
+                c, -s, 0,
+                s, +c, 0,
+                0, 0, 1,
+            };
+
+            return mat3f(r);
+        }
+
+        /// Calls fill(i, sin(rad[i]), cos(rad[i])) for i < size; the sines and
+        /// cosines are evaluated in batches on the stack
+        template <typename F>
+        inline void for_each_sincos(const float* rad, const std::size_t size, F fill)
+        {
+            const std::size_t batch = 64;
+            float s[batch], c[batch];
+
+            for (std::size_t i = 0; i < size; i += batch)
+            {
+                const std::size_t n = std::min(batch, size - i);
+                sincos(rad + i, s, c, n);
+
+                for (std::size_t k = 0; k != n; ++k)
+                    fill(i + k, s[k], c[k]);
+            }
+        }
+    }
+
     /// @return rotation matrix
     static inline mat4f rotate_4x(const float rad)
     {
-        const float r[] = {
-            1, 0, 0, 0,
-            0, static_cast<float>(std::cos(rad)), static_cast<float>(-std::sin(rad)), 0,
-            0, static_cast<float>(std::sin(rad)), static_cast<float>(+std::cos(rad)), 0,
-            0, 0, 0, 1,
-        };
+        float s, c;
+        sincos(rad, s, c);
+        return detail::rotate_4x(s, c);
+    }
 
-        return mat4f(r);
+    /// Batched rotate_4x: out[i] = rotate_4x(rad[i]) for i < size
+    static inline void rotate_4x(const float* rad, mat4f* out, const std::size_t size)
+    {
+        detail::for_each_sincos(rad, size, [out](const std::size_t i, const float s, const float c) {
+            out[i] = detail::rotate_4x(s, c);
+        });
     }
 
     /// @return rotation matrix
     static inline mat3f rotate_3x(const float rad)
     {
-        const float r[] = {
-            1, 0, 0,
-            0, static_cast<float>(std::cos(rad)), static_cast<float>(-std::sin(rad)),
-            0, static_cast<float>(std::sin(rad)), static_cast<float>(+std::cos(rad)),
-        };
+        float s, c;
+        sincos(rad, s, c);
+        return detail::rotate_3x(s, c);
+    }
 
-        return mat3f(r);
+    /// Batched rotate_3x: out[i] = rotate_3x(rad[i]) for i < size
+    static inline void rotate_3x(const float* rad, mat3f* out, const std::size_t size)
+    {
+        detail::for_each_sincos(rad, size, [out](const std::size_t i, const float s, const float c) {
+            out[i] = detail::rotate_3x(s, c);
+        });
     }
 
     /// @return rotation matrix
     static inline mat4f rotate_4y(const float rad)
     {
-        const float r[] = {
-            static_cast<float>(+std::cos(rad)), 0, static_cast<float>(std::sin(rad)), 0,
-            0, 1, 0, 0,
-            static_cast<float>(-std::sin(rad)), 0, static_cast<float>(std::cos(rad)), 0,
-            0, 0, 0, 1,
-        };
+        float s, c;
+        sincos(rad, s, c);
+        return detail::rotate_4y(s, c);
+    }
 
-        return mat4f(r);
+    /// Batched rotate_4y: out[i] = rotate_4y(rad[i]) for i < size
+    static inline void rotate_4y(const float* rad, mat4f* out, const std::size_t size)
+    {
+        detail::for_each_sincos(rad, size, [out](const std::size_t i, const float s, const float c) {
+            out[i] = detail::rotate_4y(s, c);
+        });
     }
 
     /// @return rotation matrix
-    static inline mat3f rotate_3y(float rad)
+    static inline mat3f rotate_3y(const float rad)
     {
-        const float r[] = {
-            static_cast<float>(+std::cos(rad)), 0, static_cast<float>(std::sin(rad)),
-            0, 1, 0,
-            static_cast<float>(-std::sin(rad)), 0, static_cast<float>(std::cos(rad)),
-            0, 0, 1,
-        };
+        float s, c;
+        sincos(rad, s, c);
+        return detail::rotate_3y(s, c);
+    }
 
-        return mat3f(r);
+    /// Batched rotate_3y: out[i] = rotate_3y(rad[i]) for i < size
+    static inline void rotate_3y(const float* rad, mat3f* out, const std::size_t size)
+    {
+        detail::for_each_sincos(rad, size, [out](const std::size_t i, const float s, const float c) {
+            out[i] = detail::rotate_3y(s, c);
+        });
     }
 
     /// @return rotation matrix
     static inline mat4f rotate_4z(const float rad)
     {
-        const float r[] = {
-            static_cast<float>(std::cos(rad)), static_cast<float>(-std::sin(rad)), 0, 0,
-            static_cast<float>(std::sin(rad)), static_cast<float>(+std::cos(rad)), 0, 0,
-            0, 0, 1, 0,
-            0, 0, 0, 1,
-        };
+        float s, c;
+        sincos(rad, s, c);
+        return detail::rotate_4z(s, c);
+    }
 
-        return mat4f(r);
+    /// Batched rotate_4z: out[i] = rotate_4z(rad[i]) for i < size
+    static inline void rotate_4z(const float* rad, mat4f* out, const std::size_t size)
+    {
+        detail::for_each_sincos(rad, size, [out](const std::size_t i, const float s, const float c) {
+            out[i] = detail::rotate_4z(s, c);
+        });
     }
 
     /// @return rotation matrix
     static inline mat3f rotate_3z(const float rad)
     {
-        const float r[] = {
-            static_cast<float>(std::cos(rad)), static_cast<float>(-std::sin(rad)), 0,
-            static_cast<float>(std::sin(rad)), static_cast<float>(+std::cos(rad)), 0,
-            0, 0, 1,
-        };
+        float s, c;
+        sincos(rad, s, c);
+        return detail::rotate_3z(s, c);
+    }
 
-        return mat3f(r);
+    /// Batched rotate_3z: out[i] = rotate_3z(rad[i]) for i < size
+    static inline void rotate_3z(const float* rad, mat3f* out, const std::size_t size)
+    {
+        detail::for_each_sincos(rad, size, [out](const std::size_t i, const float s, const float c) {
+            out[i] = detail::rotate_3z(s, c);
+        });
+    }
+
+    /// @return translation matrix; usable in constant expressions
+    static constexpr mat4f translate_4(const float x, const float y, const float z)
+    {
+        return mat4f(1, 0, 0, x,
+                     0, 1, 0, y,
+                     0, 0, 1, z,
+                     0, 0, 0, 1);
+    }
+
+    /// @return scale matrix; usable in constant expressions
+    static constexpr mat4f scale_4(const float x, const float y, const float z)
+    {
+        return mat4f(x, 0, 0, 0,
+                     0, y, 0, 0,
+                     0, 0, z, 0,
+                     0, 0, 0, 1);
+    }
+
+    /// Batched rotate_4x(rad[i][0]) * rotate_4y(rad[i][1]) * rotate_4z(rad[i][2]),
+    /// e.g. for per-instance spin; the translation of out[i] is zero
+    static inline void rotate_xyz(const vec3f* rad, affine3f* out, const std::size_t size)
+    {
+        const std::size_t batch = 64;
+        float a[3][batch], s[3][batch], c[3][batch];
+
+        for (std::size_t i = 0; i < size; i += batch)
+        {
+            const std::size_t n = std::min(batch, size - i);
+            for (std::size_t k = 0; k != n; ++k)
+            {
+                a[0][k] = rad[i + k][0];
+                a[1][k] = rad[i + k][1];
+                a[2][k] = rad[i + k][2];
+            }
+
+            for (unsigned j = 0; j != 3; ++j)
+                sincos(a[j], s[j], c[j], n);
+
+            for (std::size_t k = 0; k != n; ++k)
+            {
+                const float sx = s[0][k], cx = c[0][k];
+                const float sy = s[1][k], cy = c[1][k];
+                const float sz = s[2][k], cz = c[2][k];
+
+                affine3f& m = out[i + k];
+
+                m(0, 0) =  cy * cz;
+                m(0, 1) = -cy * sz;
+                m(0, 2) =  sy;
+                m(0, 3) =  0;
+
+                m(1, 0) =  sx * sy * cz + cx * sz;
+                m(1, 1) =  cx * cz - sx * sy * sz;
+                m(1, 2) = -sx * cy;
+                m(1, 3) =  0;
+
+                m(2, 0) =  sx * sz - cx * sy * cz;
+                m(2, 1) =  cx * sy * sz + sx * cz;
+                m(2, 2) =  cx * cy;
+                m(2, 3) =  0;
+            }
+        }
+    }
+#ifdef __NO_USE_SIMD__
+    namespace detail {
+
+        /// out[i] = m * (in[i][0..2], w), or m * in[i] if vec4, over arrays of
+        /// 4-float vectors; divided by the result's w if divide is set, lane 3
+        /// cleared unless vec4
+        inline void transform4(const mat4f& m,
+                               const float* in,
+                               float* out,
+                               const std::size_t size,
+                               const float w,
+                               const bool vec4,
+                               const bool divide)
+        {
+            for (std::size_t i = 0; i != size; ++i)
+            {
+                const float* v = in + i * 4;
+                const float vw = vec4 ? v[3] : w;
+
+                float r[4];
+                for (unsigned j = 0; j != 4; ++j)
+                    r[j] = m(j, 0) * v[0] + m(j, 1) * v[1] + m(j, 2) * v[2] + m(j, 3) * vw;
+
+                float* o = out + i * 4;
+                for (unsigned j = 0; j != 3; ++j)
+                    o[j] = divide ? r[j] / r[3] : r[j];
+                o[3] = vec4 ? r[3] : 0;
+            }
+        }
+    }
+#endif
+    /// Batched points: out[i] = m * (in[i], 1) for i < size, e.g. model to world
+    /// space for culling or debug lines; out may alias in
+    static inline void transform_points(const mat4f& m, const vec3f* in, vec3f* out, const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        detail::transform4(m, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size, 1, false, false);
+#else
+        detail::kernels().transform4(data(m), reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size, detail::TRANSFORM_POINTS);
+#endif
+    }
+
+    /// @overload
+    static inline void transform_points(const affine3f& a, const vec3f* in, vec3f* out, const std::size_t size)
+    {
+        transform_points(a.to_mat4(), in, out, size);
+    }
+
+    /// Batched homogeneous vectors: out[i] = m * in[i] for i < size, w included
+    /// and kept; out may alias in
+    static inline void transform_points(const mat4f& m, const vec4f* in, vec4f* out, const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        detail::transform4(m, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size, 0, true, false);
+#else
+        detail::kernels().transform4(data(m), reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size, detail::TRANSFORM_VEC4);
+#endif
+    }
+
+    /// Batched directions: out[i] = m * (in[i], 0) for i < size, translation
+    /// ignored; normals need the inverse transpose of m instead. out may alias in
+    static inline void transform_dirs(const mat4f& m, const vec3f* in, vec3f* out, const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        detail::transform4(m, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size, 0, false, false);
+#else
+        detail::kernels().transform4(data(m), reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size, detail::TRANSFORM_DIRS);
+#endif
+    }
+
+    /// @overload
+    static inline void transform_dirs(const affine3f& a, const vec3f* in, vec3f* out, const std::size_t size)
+    {
+        transform_dirs(a.to_mat4(), in, out, size);
+    }
+
+    /// Batched projection: out[i] = (x, y, z) / w of m * (in[i], 1) for i < size,
+    /// e.g. world space to normalized device coordinates with the scene matrix;
+    /// not finite where w is 0. out may alias in
+    static inline void project_points(const mat4f& m, const vec3f* in, vec3f* out, const std::size_t size)
+    {
+#ifdef __NO_USE_SIMD__
+        detail::transform4(m, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size, 1, false, true);
+#else
+        detail::kernels().transform4(data(m), reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), size, detail::PROJECT_POINTS);
+#endif
     }
 }
 
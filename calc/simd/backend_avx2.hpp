@@ -0,0 +1,474 @@
+#pragma once
+
+#ifndef _CALC_SIMD_BACKEND_AVX2_HPP
+#define _CALC_SIMD_BACKEND_AVX2_HPP
+
+#include <cstddef>
+
+#include "backend_sse4.hpp"
+#include "common.hpp"
+#include "cpu.hpp"
+
+namespace calc {
+
+    namespace detail {
+
+        /// struct avx2_kernels
+        /*! 256-bit AVX2 + FMA kernels
+         *! Matrix buffers are only 16-byte aligned, so all accesses are unaligned
+         */
+        struct avx2_kernels {
+
+            /// 3x3 rows sit at offsets 0, 3, 6; see sse4_kernels::mul_3x3x3
+            __target_avx2__
+            static void mul_3x3x3(const float* dat1, const float* dat2, float* out) {
+
+                const __m128 b0 = _mm_loadu_ps(dat2);
+                const __m128 b1 = _mm_loadu_ps(dat2 + 3);
+                const __m128 b2 = _mm_loadu_ps(dat2 + 6);
+
+                const __m128 a0 = _mm_loadu_ps(dat1);
+                const __m128 a1 = _mm_loadu_ps(dat1 + 3);
+                const __m128 a2 = _mm_loadu_ps(dat1 + 6);
+
+                __m128 r0 = _mm_mul_ps(_mm_permute_ps(a0, 0x00), b0);
+                __m128 r1 = _mm_mul_ps(_mm_permute_ps(a1, 0x00), b0);
+                __m128 r2 = _mm_mul_ps(_mm_permute_ps(a2, 0x00), b0);
+
+                r0 = _mm_fmadd_ps(_mm_permute_ps(a0, 0x55), b1, r0);
+                r1 = _mm_fmadd_ps(_mm_permute_ps(a1, 0x55), b1, r1);
+                r2 = _mm_fmadd_ps(_mm_permute_ps(a2, 0x55), b1, r2);
+
+                r0 = _mm_fmadd_ps(_mm_permute_ps(a0, 0xaa), b2, r0);
+                r1 = _mm_fmadd_ps(_mm_permute_ps(a1, 0xaa), b2, r1);
+                r2 = _mm_fmadd_ps(_mm_permute_ps(a2, 0xaa), b2, r2);
+
+                _mm_storeu_ps(out, r0);
+                _mm_storeu_ps(out + 3, r1);
+                _mm_storeu_ps(out + 6, _mm_blend_ps(r2, _mm_setzero_ps(), 0x8));
+            }
+
+            __target_avx2__
+            static void soa_mul_4x4(const float* w,
+                                    float* dat,
+                                    std::size_t stride,
+                                    std::size_t size,
+                                    std::size_t inner,
+                                    std::size_t outer) {
+
+                for (std::size_t i = 0; i < size; i += 8)
+                {
+                    for (std::size_t l = 0; l != 4; ++l)
+                    {
+                        float* s0 = dat + l * outer * stride + i;
+                        float* s1 = s0 + inner * stride;
+                        float* s2 = s1 + inner * stride;
+                        float* s3 = s2 + inner * stride;
+
+                        const __m256 x0 = _mm256_loadu_ps(s0);
+                        const __m256 x1 = _mm256_loadu_ps(s1);
+                        const __m256 x2 = _mm256_loadu_ps(s2);
+                        const __m256 x3 = _mm256_loadu_ps(s3);
+
+                        float* out[] = { s0, s1, s2, s3 };
+                        for (unsigned j = 0; j != 4; ++j)
+                        {
+                            const float* r = w + j * 4;
+
+                            __m256 sum = _mm256_mul_ps(_mm256_set1_ps(r[0]), x0);
+                            sum = _mm256_fmadd_ps(_mm256_set1_ps(r[1]), x1, sum);
+                            sum = _mm256_fmadd_ps(_mm256_set1_ps(r[2]), x2, sum);
+                            sum = _mm256_fmadd_ps(_mm256_set1_ps(r[3]), x3, sum);
+                            _mm256_storeu_ps(out[j], sum);
+                        }
+                    }
+                }
+            }
+
+            /// sse4_kernels::sincos4 on 8 angles, polynomials evaluated with FMA
+            __target_avx2__
+            static inline void sincos8(const __m256 rad, __m256& s, __m256& c) {
+
+                const __m256 sign = _mm256_set1_ps(-0.0f);
+
+                __m256 x = _mm256_andnot_ps(sign, rad);
+                __m256 sinSign = _mm256_and_ps(sign, rad);
+
+                __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f)));
+                j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+                const __m256 y = _mm256_cvtepi32_ps(j);
+
+                sinSign = _mm256_xor_ps(sinSign, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29)));
+                const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+                const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+
+                x = _mm256_fnmadd_ps(y, _mm256_set1_ps(0.78515625f), x);
+                x = _mm256_fnmadd_ps(y, _mm256_set1_ps(2.4187564849853515625e-4f), x);
+                x = _mm256_fnmadd_ps(y, _mm256_set1_ps(3.77489497744594108e-8f), x);
+
+                const __m256 z = _mm256_mul_ps(x, x);
+
+                __m256 pc = _mm256_set1_ps(2.443315711809948e-5f);
+                pc = _mm256_fmadd_ps(pc, z, _mm256_set1_ps(-1.388731625493765e-3f));
+                pc = _mm256_fmadd_ps(pc, z, _mm256_set1_ps(4.166664568298827e-2f));
+                pc = _mm256_mul_ps(_mm256_mul_ps(pc, z), z);
+                pc = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), pc), _mm256_set1_ps(1));
+
+                __m256 ps = _mm256_set1_ps(-1.9515295891e-4f);
+                ps = _mm256_fmadd_ps(ps, z, _mm256_set1_ps(8.3321608736e-3f));
+                ps = _mm256_fmadd_ps(ps, z, _mm256_set1_ps(-1.6666654611e-1f));
+                ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, z), x, x);
+
+                s = _mm256_xor_ps(sinSign, _mm256_blendv_ps(pc, ps, swap));
+                c = _mm256_xor_ps(cosSign, _mm256_blendv_ps(ps, pc, swap));
+            }
+
+            __target_avx2__
+            static void sincos(const float* rad, float* s, float* c, std::size_t size) {
+
+                __m256 vs, vc;
+
+                std::size_t i = 0;
+                for ( ; i + 8 <= size; i += 8)
+                {
+                    sincos8(_mm256_loadu_ps(rad + i), vs, vc);
+                    _mm256_storeu_ps(s + i, vs);
+                    _mm256_storeu_ps(c + i, vc);
+                }
+
+                if (i != size) {
+                    sse4_kernels::sincos(rad + i, s + i, c + i, size - i);
+                }
+            }
+
+            /// Horizontal sums of eight 4-float vectors held in pairs p01, p23,
+            /// p45, p67, as (v0, v2, v4, v6 | v1, v3, v5, v7): lane k of each
+            /// half belongs to pair k
+            __target_avx2__
+            static inline __m256 hsum8(const __m256 p01, const __m256 p23, const __m256 p45, const __m256 p67) {
+                return _mm256_hadd_ps(_mm256_hadd_ps(p01, p23), _mm256_hadd_ps(p45, p67));
+            }
+
+            /// See sse4_kernels::dot4; eight vectors per pass
+            __target_avx2__
+            static void dot4(const float* a, const float* b, float* out, std::size_t size) {
+
+                std::size_t i = 0;
+                for ( ; i + 8 <= size; i += 8)
+                {
+                    const float* x = a + i * 4;
+                    const float* y = b + i * 4;
+
+                    const __m256 p01 = _mm256_mul_ps(_mm256_loadu_ps(x),      _mm256_loadu_ps(y));
+                    const __m256 p23 = _mm256_mul_ps(_mm256_loadu_ps(x +  8), _mm256_loadu_ps(y +  8));
+                    const __m256 p45 = _mm256_mul_ps(_mm256_loadu_ps(x + 16), _mm256_loadu_ps(y + 16));
+                    const __m256 p67 = _mm256_mul_ps(_mm256_loadu_ps(x + 24), _mm256_loadu_ps(y + 24));
+
+                    const __m256 d = hsum8(p01, p23, p45, p67);
+                    const __m128 even = _mm256_castps256_ps128(d);
+                    const __m128 odd = _mm256_extractf128_ps(d, 1);
+
+                    _mm_storeu_ps(out + i,     _mm_unpacklo_ps(even, odd));
+                    _mm_storeu_ps(out + i + 4, _mm_unpackhi_ps(even, odd));
+                }
+
+                if (i != size) {
+                    sse4_kernels::dot4(a + i * 4, b + i * 4, out + i, size - i);
+                }
+            }
+
+            /// See sse4_kernels::normal4; eight vectors per pass
+            __target_avx2__
+            static void normal4(const float* in, float* out, std::size_t size) {
+                normal4(in, out, size, std::false_type());
+            }
+
+            /// See sse4_kernels::normal4_fast; eight vectors per pass
+            __target_avx2__
+            static void normal4_fast(const float* in, float* out, std::size_t size) {
+                normal4(in, out, size, std::true_type());
+            }
+
+            template <bool Fast>
+            __target_avx2__
+            static inline void normal4(const float* in, float* out, std::size_t size, std::integral_constant<bool, Fast>) {
+
+                std::size_t i = 0;
+                for ( ; i + 8 <= size; i += 8)
+                {
+                    const float* x = in + i * 4;
+                    float* o = out + i * 4;
+
+                    const __m256 v01 = _mm256_loadu_ps(x);
+                    const __m256 v23 = _mm256_loadu_ps(x +  8);
+                    const __m256 v45 = _mm256_loadu_ps(x + 16);
+                    const __m256 v67 = _mm256_loadu_ps(x + 24);
+
+                    const __m256 d = hsum8(_mm256_mul_ps(v01, v01), _mm256_mul_ps(v23, v23),
+                                           _mm256_mul_ps(v45, v45), _mm256_mul_ps(v67, v67));
+                    if (Fast)
+                    {
+                        // One Newton-Raphson step: r * (1.5 - 0.5 * d * r * r)
+                        const __m256 r0 = _mm256_rsqrt_ps(d);
+                        const __m256 hd = _mm256_mul_ps(_mm256_mul_ps(d, _mm256_set1_ps(0.5f)), r0);
+                        const __m256 r = _mm256_mul_ps(r0, _mm256_fnmadd_ps(hd, r0, _mm256_set1_ps(1.5f)));
+
+                        _mm256_storeu_ps(o,      _mm256_mul_ps(v01, _mm256_permute_ps(r, 0x00)));
+                        _mm256_storeu_ps(o +  8, _mm256_mul_ps(v23, _mm256_permute_ps(r, 0x55)));
+                        _mm256_storeu_ps(o + 16, _mm256_mul_ps(v45, _mm256_permute_ps(r, 0xaa)));
+                        _mm256_storeu_ps(o + 24, _mm256_mul_ps(v67, _mm256_permute_ps(r, 0xff)));
+                    }
+                    else
+                    {
+                        const __m256 n = _mm256_sqrt_ps(d);
+
+                        _mm256_storeu_ps(o,      _mm256_div_ps(v01, _mm256_permute_ps(n, 0x00)));
+                        _mm256_storeu_ps(o +  8, _mm256_div_ps(v23, _mm256_permute_ps(n, 0x55)));
+                        _mm256_storeu_ps(o + 16, _mm256_div_ps(v45, _mm256_permute_ps(n, 0xaa)));
+                        _mm256_storeu_ps(o + 24, _mm256_div_ps(v67, _mm256_permute_ps(n, 0xff)));
+                    }
+                }
+
+                if (i != size) {
+                    sse4_kernels::normal4(in + i * 4, out + i * 4, size - i, std::integral_constant<bool, Fast>());
+                }
+            }
+
+            /// See sse4_kernels::transform4; two vectors per register, eight per pass
+            __target_avx2__
+            static void transform4(const float* m, const float* in, float* out, std::size_t size, transform_mode mode) {
+
+                switch (mode)
+                {
+                    case TRANSFORM_POINTS: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_POINTS>()); break;
+                    case TRANSFORM_DIRS: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_DIRS>()); break;
+                    case TRANSFORM_VEC4: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_VEC4>()); break;
+                    case PROJECT_POINTS: transform4(m, in, out, size, std::integral_constant<transform_mode, PROJECT_POINTS>()); break;
+                }
+            }
+
+            /// @return m * v for two vectors, the columns of m repeated in both halves
+            template <transform_mode Mode>
+            __target_avx2__
+            static inline __m256 transform2(const __m256 v, const __m256 c0, const __m256 c1, const __m256 c2, const __m256 c3) {
+
+                __m256 r;
+                if (Mode == TRANSFORM_VEC4) {
+                    r = _mm256_mul_ps(_mm256_permute_ps(v, 0xff), c3);
+                } else if (Mode == TRANSFORM_DIRS) {
+                    r = _mm256_setzero_ps();
+                } else {
+                    r = c3;
+                }
+
+                r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0x00), c0, r);
+                r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0x55), c1, r);
+                r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0xaa), c2, r);
+
+                if (Mode == PROJECT_POINTS) {
+                    r = _mm256_blend_ps(_mm256_div_ps(r, _mm256_permute_ps(r, 0xff)), _mm256_setzero_ps(), 0x88);
+                }
+
+                return r;
+            }
+
+            template <transform_mode Mode>
+            __target_avx2__
+            static inline void transform4(const float* m, const float* in, float* out, std::size_t size, std::integral_constant<transform_mode, Mode>) {
+
+                __m128 k0, k1, k2, k3;
+                sse4_kernels::transform_columns(m, Mode, k0, k1, k2, k3);
+
+                const __m256 c0 = _mm256_insertf128_ps(_mm256_castps128_ps256(k0), k0, 1);
+                const __m256 c1 = _mm256_insertf128_ps(_mm256_castps128_ps256(k1), k1, 1);
+                const __m256 c2 = _mm256_insertf128_ps(_mm256_castps128_ps256(k2), k2, 1);
+                const __m256 c3 = _mm256_insertf128_ps(_mm256_castps128_ps256(k3), k3, 1);
+
+                std::size_t i = 0;
+                for ( ; i + 8 <= size; i += 8)
+                {
+                    const float* x = in + i * 4;
+                    float* o = out + i * 4;
+
+                    const __m256 v01 = _mm256_loadu_ps(x);
+                    const __m256 v23 = _mm256_loadu_ps(x +  8);
+                    const __m256 v45 = _mm256_loadu_ps(x + 16);
+                    const __m256 v67 = _mm256_loadu_ps(x + 24);
+
+                    _mm256_storeu_ps(o,      transform2<Mode>(v01, c0, c1, c2, c3));
+                    _mm256_storeu_ps(o +  8, transform2<Mode>(v23, c0, c1, c2, c3));
+                    _mm256_storeu_ps(o + 16, transform2<Mode>(v45, c0, c1, c2, c3));
+                    _mm256_storeu_ps(o + 24, transform2<Mode>(v67, c0, c1, c2, c3));
+                }
+
+                for ( ; i + 2 <= size; i += 2) {
+                    _mm256_storeu_ps(out + i * 4, transform2<Mode>(_mm256_loadu_ps(in + i * 4), c0, c1, c2, c3));
+                }
+
+                if (i != size) {
+                    sse4_kernels::transform4(m, in + i * 4, out + i * 4, size - i, std::integral_constant<transform_mode, Mode>());
+                }
+            }
+
+            /// See sse4_kernels::transpose_4x4; four shuffles per matrix instead of eight
+            __target_avx2__
+            static void transpose_4x4(const float* in, float* out, std::size_t size) {
+
+                // Rows (0, 1) -> (a00 a10 a02 a12 | a01 a11 a03 a13), likewise rows (2, 3);
+                // the 64-bit unpacks then pair up whole columns
+                const __m256i order = _mm256_setr_epi32(0, 4, 2, 6, 1, 5, 3, 7);
+
+                for (std::size_t i = 0; i != size; ++i)
+                {
+                    const __m256 r01 = _mm256_permutevar8x32_ps(_mm256_loadu_ps(in + i * 16), order);
+                    const __m256 r23 = _mm256_permutevar8x32_ps(_mm256_loadu_ps(in + i * 16 + 8), order);
+
+                    const __m256d c01 = _mm256_unpacklo_pd(_mm256_castps_pd(r01), _mm256_castps_pd(r23));
+                    const __m256d c23 = _mm256_unpackhi_pd(_mm256_castps_pd(r01), _mm256_castps_pd(r23));
+
+                    _mm256_storeu_ps(out + i * 16,     _mm256_castpd_ps(c01));
+                    _mm256_storeu_ps(out + i * 16 + 8, _mm256_castpd_ps(c23));
+                }
+            }
+
+            /// Register tile of gemm_ps: 12 accumulators, two B registers and
+            /// one broadcast fill the 16 ymm registers
+            static const std::size_t GEMM_MR = 6;
+            static const std::size_t GEMM_NR = 16;
+
+            /// See sse4_kernels::gemm_ps
+            __target_avx2__
+            static void gemm_ps(const std::size_t kc,
+                                const float* a,
+                                const float* b,
+                                float* c,
+                                const std::size_t ldc,
+                                const std::size_t mr,
+                                const std::size_t nr,
+                                const bool accumulate) {
+
+                __m256 acc[GEMM_MR][2];
+#pragma GCC unroll 6
+                for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    acc[i][0] = acc[i][1] = _mm256_setzero_ps();
+
+                for (std::size_t p = 0; p != kc; ++p)
+                {
+                    const __m256 b0 = _mm256_loadu_ps(b);
+                    const __m256 b1 = _mm256_loadu_ps(b + 8);
+#pragma GCC unroll 6
+                    for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    {
+                        const __m256 x = _mm256_broadcast_ss(a + i);
+                        acc[i][0] = _mm256_fmadd_ps(x, b0, acc[i][0]);
+                        acc[i][1] = _mm256_fmadd_ps(x, b1, acc[i][1]);
+                    }
+
+                    a += GEMM_MR;
+                    b += GEMM_NR;
+                }
+
+                if (mr == GEMM_MR && nr == GEMM_NR)
+                {
+#pragma GCC unroll 6
+                    for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    {
+                        float* row = c + i * ldc;
+                        _mm256_storeu_ps(row,     accumulate ? _mm256_add_ps(_mm256_loadu_ps(row),     acc[i][0]) : acc[i][0]);
+                        _mm256_storeu_ps(row + 8, accumulate ? _mm256_add_ps(_mm256_loadu_ps(row + 8), acc[i][1]) : acc[i][1]);
+                    }
+
+                    return;
+                }
+
+                float t[GEMM_MR * GEMM_NR];
+                for (std::size_t i = 0; i != GEMM_MR; ++i)
+                {
+                    _mm256_storeu_ps(t + i * GEMM_NR,     acc[i][0]);
+                    _mm256_storeu_ps(t + i * GEMM_NR + 8, acc[i][1]);
+                }
+
+                sse4_kernels::gemm_store(t, GEMM_NR, c, ldc, mr, nr, accumulate);
+            }
+
+            // Double precision; 4 lanes per register
+
+            /// Dynamic double product; see sse4_kernels::gemm_pd
+            __target_avx2__
+            static void gemm_pd(const double* dat1,
+                                const double* dat2,
+                                double* out,
+                                std::size_t N0,
+                                std::size_t N1,
+                                std::size_t M1) {
+
+                for (std::size_t i = 0; i != N0; ++i)
+                {
+                    const double* row = dat1 + i * N1;
+
+                    std::size_t j = 0;
+                    for ( ; j + 4 <= M1; j += 4)
+                    {
+                        __m256d sum = _mm256_setzero_pd();
+                        for (std::size_t k = 0; k != N1; ++k) {
+                            sum = _mm256_fmadd_pd(_mm256_set1_pd(row[k]), _mm256_loadu_pd(dat2 + k * M1 + j), sum);
+                        }
+
+                        _mm256_storeu_pd(out + i * M1 + j, sum);
+                    }
+
+                    for ( ; j + 2 <= M1; j += 2)
+                    {
+                        __m128d sum = _mm_setzero_pd();
+                        for (std::size_t k = 0; k != N1; ++k) {
+                            sum = _mm_fmadd_pd(_mm_set1_pd(row[k]), _mm_loadu_pd(dat2 + k * M1 + j), sum);
+                        }
+
+                        _mm_storeu_pd(out + i * M1 + j, sum);
+                    }
+
+                    for ( ; j != M1; ++j)
+                    {
+                        double sum = 0;
+                        for (std::size_t k = 0; k != N1; ++k) {
+                            sum += row[k] * dat2[k * M1 + j];
+                        }
+
+                        out[i * M1 + j] = sum;
+                    }
+                }
+            }
+
+            /// Dynamic double matrix x vector product; see sse4_kernels::gemv_pd
+            __target_avx2__
+            static void gemv_pd(const double* dat1,
+                                const double* dat2,
+                                double* out,
+                                std::size_t N0,
+                                std::size_t N1) {
+
+                for (std::size_t i = 0; i != N0; ++i)
+                {
+                    const double* row = dat1 + i * N1;
+
+                    __m256d sum = _mm256_setzero_pd();
+
+                    std::size_t k = 0;
+                    for ( ; k + 4 <= N1; k += 4) {
+                        sum = _mm256_fmadd_pd(_mm256_loadu_pd(row + k), _mm256_loadu_pd(dat2 + k), sum);
+                    }
+
+                    double tail = 0;
+                    for ( ; k != N1; ++k) {
+                        tail += row[k] * dat2[k];
+                    }
+
+                    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+                    out[i] = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half))) + tail;
+                }
+            }
+        };
+    }
+}
+
+#endif
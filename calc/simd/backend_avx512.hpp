@@ -0,0 +1,222 @@
+#pragma once
+
+#ifndef _CALC_SIMD_BACKEND_AVX512_HPP
+#define _CALC_SIMD_BACKEND_AVX512_HPP
+
+#include <cstddef>
+
+#include "backend_avx2.hpp"
+#include "backend_sse4.hpp"
+#include "common.hpp"
+#include "cpu.hpp"
+
+// GCC < 13 flags _mm512_undefined_ps() inside its own intrinsics (PR 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+namespace calc {
+
+    namespace detail {
+
+        /// struct avx512_kernels
+        /*! 512-bit AVX-512F kernels
+         *! Matrix buffers are only 16-byte aligned, so all accesses are unaligned
+         */
+        struct avx512_kernels {
+
+            __target_avx512__
+            static void soa_mul_4x4(const float* w,
+                                    float* dat,
+                                    std::size_t stride,
+                                    std::size_t size,
+                                    std::size_t inner,
+                                    std::size_t outer) {
+
+                for (std::size_t i = 0; i < size; i += 16)
+                {
+                    for (std::size_t l = 0; l != 4; ++l)
+                    {
+                        float* s0 = dat + l * outer * stride + i;
+                        float* s1 = s0 + inner * stride;
+                        float* s2 = s1 + inner * stride;
+                        float* s3 = s2 + inner * stride;
+
+                        const __m512 x0 = _mm512_loadu_ps(s0);
+                        const __m512 x1 = _mm512_loadu_ps(s1);
+                        const __m512 x2 = _mm512_loadu_ps(s2);
+                        const __m512 x3 = _mm512_loadu_ps(s3);
+
+                        float* out[] = { s0, s1, s2, s3 };
+                        for (unsigned j = 0; j != 4; ++j)
+                        {
+                            const float* r = w + j * 4;
+
+                            __m512 sum = _mm512_mul_ps(_mm512_set1_ps(r[0]), x0);
+                            sum = _mm512_fmadd_ps(_mm512_set1_ps(r[1]), x1, sum);
+                            sum = _mm512_fmadd_ps(_mm512_set1_ps(r[2]), x2, sum);
+                            sum = _mm512_fmadd_ps(_mm512_set1_ps(r[3]), x3, sum);
+                            _mm512_storeu_ps(out[j], sum);
+                        }
+                    }
+                }
+            }
+
+            /// See sse4_kernels::transform4; four vectors per register, sixteen per pass
+            __target_avx512__
+            static void transform4(const float* m, const float* in, float* out, std::size_t size, transform_mode mode) {
+
+                switch (mode)
+                {
+                    case TRANSFORM_POINTS: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_POINTS>()); break;
+                    case TRANSFORM_DIRS: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_DIRS>()); break;
+                    case TRANSFORM_VEC4: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_VEC4>()); break;
+                    case PROJECT_POINTS: transform4(m, in, out, size, std::integral_constant<transform_mode, PROJECT_POINTS>()); break;
+                }
+            }
+
+            /// @return m * v for four vectors, the columns of m repeated in every 128-bit lane
+            template <transform_mode Mode>
+            __target_avx512__
+            static inline __m512 transform4x4(const __m512 v, const __m512 c0, const __m512 c1, const __m512 c2, const __m512 c3) {
+
+                __m512 r;
+                if (Mode == TRANSFORM_VEC4) {
+                    r = _mm512_mul_ps(_mm512_permute_ps(v, 0xff), c3);
+                } else if (Mode == TRANSFORM_DIRS) {
+                    r = _mm512_setzero_ps();
+                } else {
+                    r = c3;
+                }
+
+                r = _mm512_fmadd_ps(_mm512_permute_ps(v, 0x00), c0, r);
+                r = _mm512_fmadd_ps(_mm512_permute_ps(v, 0x55), c1, r);
+                r = _mm512_fmadd_ps(_mm512_permute_ps(v, 0xaa), c2, r);
+
+                if (Mode == PROJECT_POINTS) {
+                    r = _mm512_maskz_div_ps(0x7777, r, _mm512_permute_ps(r, 0xff));
+                }
+
+                return r;
+            }
+
+            template <transform_mode Mode>
+            __target_avx512__
+            static inline void transform4(const float* m, const float* in, float* out, std::size_t size, std::integral_constant<transform_mode, Mode>) {
+
+                __m128 k0, k1, k2, k3;
+                sse4_kernels::transform_columns(m, Mode, k0, k1, k2, k3);
+
+                const __m512 c0 = _mm512_broadcast_f32x4(k0);
+                const __m512 c1 = _mm512_broadcast_f32x4(k1);
+                const __m512 c2 = _mm512_broadcast_f32x4(k2);
+                const __m512 c3 = _mm512_broadcast_f32x4(k3);
+
+                std::size_t i = 0;
+                for ( ; i + 16 <= size; i += 16)
+                {
+                    const float* x = in + i * 4;
+                    float* o = out + i * 4;
+
+                    const __m512 v0 = _mm512_loadu_ps(x);
+                    const __m512 v1 = _mm512_loadu_ps(x + 16);
+                    const __m512 v2 = _mm512_loadu_ps(x + 32);
+                    const __m512 v3 = _mm512_loadu_ps(x + 48);
+
+                    _mm512_storeu_ps(o,      transform4x4<Mode>(v0, c0, c1, c2, c3));
+                    _mm512_storeu_ps(o + 16, transform4x4<Mode>(v1, c0, c1, c2, c3));
+                    _mm512_storeu_ps(o + 32, transform4x4<Mode>(v2, c0, c1, c2, c3));
+                    _mm512_storeu_ps(o + 48, transform4x4<Mode>(v3, c0, c1, c2, c3));
+                }
+
+                for ( ; i + 4 <= size; i += 4) {
+                    _mm512_storeu_ps(out + i * 4, transform4x4<Mode>(_mm512_loadu_ps(in + i * 4), c0, c1, c2, c3));
+                }
+
+                if (i != size) {
+                    avx2_kernels::transform4(m, in + i * 4, out + i * 4, size - i, std::integral_constant<transform_mode, Mode>());
+                }
+            }
+
+            /// See sse4_kernels::transpose_4x4; one permute per matrix (the two-source
+            /// form; the one-source intrinsic trips -Wmaybe-uninitialized in GCC 12)
+            __target_avx512__
+            static void transpose_4x4(const float* in, float* out, std::size_t size) {
+
+                const __m512i order = _mm512_setr_epi32(0, 4,  8, 12,
+                                                        1, 5,  9, 13,
+                                                        2, 6, 10, 14,
+                                                        3, 7, 11, 15);
+
+                for (std::size_t i = 0; i != size; ++i)
+                {
+                    const __m512 m = _mm512_loadu_ps(in + i * 16);
+                    _mm512_storeu_ps(out + i * 16, _mm512_permutex2var_ps(m, order, m));
+                }
+            }
+
+            /// Register tile of gemm_ps: 12 zmm accumulators
+            static const std::size_t GEMM_MR = 6;
+            static const std::size_t GEMM_NR = 32;
+
+            /// See sse4_kernels::gemm_ps
+            __target_avx512__
+            static void gemm_ps(const std::size_t kc,
+                                const float* a,
+                                const float* b,
+                                float* c,
+                                const std::size_t ldc,
+                                const std::size_t mr,
+                                const std::size_t nr,
+                                const bool accumulate) {
+
+                __m512 acc[GEMM_MR][2];
+#pragma GCC unroll 6
+                for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    acc[i][0] = acc[i][1] = _mm512_setzero_ps();
+
+                for (std::size_t p = 0; p != kc; ++p)
+                {
+                    const __m512 b0 = _mm512_loadu_ps(b);
+                    const __m512 b1 = _mm512_loadu_ps(b + 16);
+#pragma GCC unroll 6
+                    for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    {
+                        const __m512 x = _mm512_set1_ps(a[i]);
+                        acc[i][0] = _mm512_fmadd_ps(x, b0, acc[i][0]);
+                        acc[i][1] = _mm512_fmadd_ps(x, b1, acc[i][1]);
+                    }
+
+                    a += GEMM_MR;
+                    b += GEMM_NR;
+                }
+
+                if (mr == GEMM_MR && nr == GEMM_NR)
+                {
+#pragma GCC unroll 6
+                    for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    {
+                        float* row = c + i * ldc;
+                        _mm512_storeu_ps(row,      accumulate ? _mm512_add_ps(_mm512_loadu_ps(row),      acc[i][0]) : acc[i][0]);
+                        _mm512_storeu_ps(row + 16, accumulate ? _mm512_add_ps(_mm512_loadu_ps(row + 16), acc[i][1]) : acc[i][1]);
+                    }
+
+                    return;
+                }
+
+                float t[GEMM_MR * GEMM_NR];
+                for (std::size_t i = 0; i != GEMM_MR; ++i)
+                {
+                    _mm512_storeu_ps(t + i * GEMM_NR,      acc[i][0]);
+                    _mm512_storeu_ps(t + i * GEMM_NR + 16, acc[i][1]);
+                }
+
+                sse4_kernels::gemm_store(t, GEMM_NR, c, ldc, mr, nr, accumulate);
+            }
+        };
+    }
+}
+
+#pragma GCC diagnostic pop
+
+#endif
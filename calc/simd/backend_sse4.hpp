@@ -0,0 +1,555 @@
+#pragma once
+
+#ifndef _CALC_SIMD_BACKEND_SSE4_HPP
+#define _CALC_SIMD_BACKEND_SSE4_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#include "common.hpp"
+
+namespace calc {
+
+    namespace detail {
+
+        /// struct sse4_kernels
+        /*! 128-bit kernels; the build baseline, always available
+         *! Elementwise operations are not here: see elementwise.hpp
+         */
+        struct sse4_kernels {
+
+            /// @return sum_k a[k] * b_k, a's lanes broadcast in turn
+            static inline __m128 lincomb(const __m128 a,
+                                         const __m128 b0,
+                                         const __m128 b1,
+                                         const __m128 b2,
+                                         const __m128 b3) {
+
+                __m128 sum = _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), b0);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), b1));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), b2));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xff), b3));
+
+                return sum;
+            }
+
+            /// @return sum_k a[k] * b_k over the first three lanes of a
+            static inline __m128 lincomb(const __m128 a,
+                                         const __m128 b0,
+                                         const __m128 b1,
+                                         const __m128 b2) {
+
+                __m128 sum = _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), b0);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), b1));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), b2));
+
+                return sum;
+            }
+
+            /// @return (sum p0, sum p1, sum p2, sum p3), reduced by transposition
+            static inline __m128 hsum4(const __m128 p0,
+                                       const __m128 p1,
+                                       const __m128 p2,
+                                       const __m128 p3) {
+
+                // (p0[0] + p0[2], p1[0] + p1[2], p0[1] + p0[3], p1[1] + p1[3]), ditto p2 | p3
+                const __m128 s01 = _mm_add_ps(_mm_unpacklo_ps(p0, p1), _mm_unpackhi_ps(p0, p1));
+                const __m128 s23 = _mm_add_ps(_mm_unpacklo_ps(p2, p3), _mm_unpackhi_ps(p2, p3));
+
+                return _mm_add_ps(_mm_movelh_ps(s01, s23), _mm_movehl_ps(s23, s01));
+            }
+
+            static void mul_4x4x1(const float* dat1, const float* dat2, float* out) {
+
+                const __m128 c0 = _mm_load_ps(dat2);
+
+                const __m128 p0 = _mm_mul_ps(_mm_load_ps(dat1), c0);
+                const __m128 p1 = _mm_mul_ps(_mm_load_ps(dat1 +  4), c0);
+                const __m128 p2 = _mm_mul_ps(_mm_load_ps(dat1 +  8), c0);
+                const __m128 p3 = _mm_mul_ps(_mm_load_ps(dat1 + 12), c0);
+
+                _mm_store_ps(out, hsum4(p0, p1, p2, p3));
+            }
+
+            static void mul_4x4x4(const float* dat1, const float* dat2, float* out) {
+
+                const __m128 b0 = _mm_load_ps(dat2);
+                const __m128 b1 = _mm_load_ps(dat2 +  4);
+                const __m128 b2 = _mm_load_ps(dat2 +  8);
+                const __m128 b3 = _mm_load_ps(dat2 + 12);
+
+                // LHS rows; loaded before any store so out may alias
+                const __m128 a0 = _mm_load_ps(dat1);
+                const __m128 a1 = _mm_load_ps(dat1 +  4);
+                const __m128 a2 = _mm_load_ps(dat1 +  8);
+                const __m128 a3 = _mm_load_ps(dat1 + 12);
+
+                // out row i = sum_k lhs(i, k) * rhs row k
+                _mm_store_ps(out,      lincomb(a0, b0, b1, b2, b3));
+                _mm_store_ps(out +  4, lincomb(a1, b0, b1, b2, b3));
+                _mm_store_ps(out +  8, lincomb(a2, b0, b1, b2, b3));
+                _mm_store_ps(out + 12, lincomb(a3, b0, b1, b2, b3));
+            }
+
+            /// 3x3 rows sit at offsets 0, 3, 6; lane 3 of each load belongs to the
+            /// next row (or the padding) and is cleared before the multiply, on
+            /// both sides: 0 * Inf would put a NaN into the sum
+            static void mul_3x3x1(const float* dat1, const float* dat2, float* out) {
+
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 c0 = _mm_blend_ps(_mm_loadu_ps(dat2), zero, 0x8);
+
+                const __m128 p0 = _mm_mul_ps(_mm_blend_ps(_mm_loadu_ps(dat1), zero, 0x8), c0);
+                const __m128 p1 = _mm_mul_ps(_mm_blend_ps(_mm_loadu_ps(dat1 + 3), zero, 0x8), c0);
+                const __m128 p2 = _mm_mul_ps(_mm_blend_ps(_mm_loadu_ps(dat1 + 6), zero, 0x8), c0);
+
+                _mm_storeu_ps(out, hsum4(p0, p1, p2, zero));
+            }
+
+            static void mul_3x3x3(const float* dat1, const float* dat2, float* out) {
+
+                const __m128 b0 = _mm_loadu_ps(dat2);
+                const __m128 b1 = _mm_loadu_ps(dat2 + 3);
+                const __m128 b2 = _mm_loadu_ps(dat2 + 6);
+
+                const __m128 a0 = _mm_loadu_ps(dat1);
+                const __m128 a1 = _mm_loadu_ps(dat1 + 3);
+                const __m128 a2 = _mm_loadu_ps(dat1 + 6);
+
+                const __m128 r0 = lincomb(a0, b0, b1, b2);
+                const __m128 r1 = lincomb(a1, b0, b1, b2);
+                const __m128 r2 = lincomb(a2, b0, b1, b2);
+
+                // Each store spills one lane into the next row, overwritten by
+                // the following store; the last one lands in the padding, kept zero
+                _mm_storeu_ps(out, r0);
+                _mm_storeu_ps(out + 3, r1);
+                _mm_storeu_ps(out + 6, _mm_blend_ps(r2, _mm_setzero_ps(), 0x8));
+            }
+
+            /// SoA 4x4 product over a batch: for each line l and lane i,
+            /// x(l, j) = sum_k w(j, k) * x(l, k), where stream (l, k) starts at
+            /// dat + (l * outer + k * inner) * stride
+            static void soa_mul_4x4(const float* w,
+                                    float* dat,
+                                    std::size_t stride,
+                                    std::size_t size,
+                                    std::size_t inner,
+                                    std::size_t outer) {
+
+                for (std::size_t i = 0; i < size; i += 4)
+                {
+                    for (std::size_t l = 0; l != 4; ++l)
+                    {
+                        float* s0 = dat + l * outer * stride + i;
+                        float* s1 = s0 + inner * stride;
+                        float* s2 = s1 + inner * stride;
+                        float* s3 = s2 + inner * stride;
+
+                        const __m128 x0 = _mm_loadu_ps(s0);
+                        const __m128 x1 = _mm_loadu_ps(s1);
+                        const __m128 x2 = _mm_loadu_ps(s2);
+                        const __m128 x3 = _mm_loadu_ps(s3);
+
+                        float* out[] = { s0, s1, s2, s3 };
+                        for (unsigned j = 0; j != 4; ++j)
+                        {
+                            const float* r = w + j * 4;
+
+                            __m128 sum = _mm_mul_ps(_mm_set1_ps(r[0]), x0);
+                            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(r[1]), x1));
+                            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(r[2]), x2));
+                            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(r[3]), x3));
+                            _mm_storeu_ps(out[j], sum);
+                        }
+                    }
+                }
+            }
+
+            /// Cephes-style sincos of 4 angles: reduction by pi/4 in three parts
+            /// (Cody-Waite), then degree 7 sine and degree 8 cosine polynomials.
+            /// Max error 1.5 ulp for |x| <= pi; up to |x| = 8192 the absolute error
+            /// stays below 8e-8, but near the zeros of sin and cos the error in ulp
+            /// grows with |x| (hundreds of ulp at 8192)
+            static inline void sincos4(const __m128 rad, __m128& s, __m128& c) {
+
+                const __m128 sign = _mm_set1_ps(-0.0f);
+
+                __m128 x = _mm_andnot_ps(sign, rad);
+                __m128 sinSign = _mm_and_ps(sign, rad);
+
+                // Octant j, rounded up to even: x is reduced into [-pi/4, pi/4]
+                __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+                j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+                const __m128 y = _mm_cvtepi32_ps(j);
+
+                // Quadrant bits: sine sign flip, cosine sign flip, sine/cosine swap
+                sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+                const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+                const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+
+                x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+                x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+                x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+
+                const __m128 z = _mm_mul_ps(x, x);
+
+                // cos(x) on [-pi/4, pi/4]
+                __m128 pc = _mm_set1_ps(2.443315711809948e-5f);
+                pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(-1.388731625493765e-3f));
+                pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(4.166664568298827e-2f));
+                pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+                pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1));
+
+                // sin(x) on [-pi/4, pi/4]
+                __m128 ps = _mm_set1_ps(-1.9515295891e-4f);
+                ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(8.3321608736e-3f));
+                ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(-1.6666654611e-1f));
+                ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), x), x);
+
+                s = _mm_xor_ps(sinSign, _mm_blendv_ps(pc, ps, swap));
+                c = _mm_xor_ps(cosSign, _mm_blendv_ps(ps, pc, swap));
+            }
+
+            /// s[i], c[i] = sin(rad[i]), cos(rad[i]); arrays need no padding
+            static void sincos(const float* rad, float* s, float* c, std::size_t size) {
+
+                __m128 vs, vc;
+
+                std::size_t i = 0;
+                for ( ; i + 4 <= size; i += 4)
+                {
+                    sincos4(_mm_loadu_ps(rad + i), vs, vc);
+                    _mm_storeu_ps(s + i, vs);
+                    _mm_storeu_ps(c + i, vc);
+                }
+
+                if (i != size)
+                {
+                    float tail[12] __attribute__((aligned(16))) = {};
+                    std::copy(rad + i, rad + size, tail);
+
+                    sincos4(_mm_load_ps(tail), vs, vc);
+                    _mm_store_ps(tail + 4, vs);
+                    _mm_store_ps(tail + 8, vc);
+
+                    std::copy(tail + 4, tail + 4 + (size - i), s + i);
+                    std::copy(tail + 8, tail + 8 + (size - i), c + i);
+                }
+            }
+
+            /// @return 1 / sqrt(d): estimate refined by one Newton-Raphson step,
+            ///         about 22 bits, against 12 for rsqrt alone
+            static inline __m128 rsqrt_nr(const __m128 d) {
+
+                const __m128 r = _mm_rsqrt_ps(d);
+                const __m128 drr = _mm_mul_ps(_mm_mul_ps(d, r), r);
+                return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r), _mm_sub_ps(_mm_set1_ps(3), drr));
+            }
+
+            /// out[i] = dot(a[i], b[i]) over arrays of 4-float vectors (vec3f
+            /// with its zero padding lane, or vec4f)
+            static void dot4(const float* a, const float* b, float* out, std::size_t size) {
+
+                std::size_t i = 0;
+                for ( ; i + 4 <= size; i += 4)
+                {
+                    const float* x = a + i * 4;
+                    const float* y = b + i * 4;
+
+                    const __m128 p0 = _mm_mul_ps(_mm_loadu_ps(x),      _mm_loadu_ps(y));
+                    const __m128 p1 = _mm_mul_ps(_mm_loadu_ps(x +  4), _mm_loadu_ps(y +  4));
+                    const __m128 p2 = _mm_mul_ps(_mm_loadu_ps(x +  8), _mm_loadu_ps(y +  8));
+                    const __m128 p3 = _mm_mul_ps(_mm_loadu_ps(x + 12), _mm_loadu_ps(y + 12));
+
+                    _mm_storeu_ps(out + i, hsum4(p0, p1, p2, p3));
+                }
+
+                for ( ; i != size; ++i) {
+                    _mm_store_ss(out + i, _mm_dp_ps(_mm_loadu_ps(a + i * 4), _mm_loadu_ps(b + i * 4), 0xf1));
+                }
+            }
+
+            /// out[i] = in[i] / |in[i]| over arrays of 4-float vectors; out may alias in
+            static void normal4(const float* in, float* out, std::size_t size) {
+                normal4(in, out, size, std::false_type());
+            }
+
+            /// normal4 with rsqrt_nr in place of the square root and division
+            static void normal4_fast(const float* in, float* out, std::size_t size) {
+                normal4(in, out, size, std::true_type());
+            }
+
+            template <bool Fast>
+            static inline void normal4(const float* in, float* out, std::size_t size, std::integral_constant<bool, Fast>) {
+
+                std::size_t i = 0;
+                for ( ; i + 4 <= size; i += 4)
+                {
+                    const __m128 v0 = _mm_loadu_ps(in + i * 4);
+                    const __m128 v1 = _mm_loadu_ps(in + i * 4 +  4);
+                    const __m128 v2 = _mm_loadu_ps(in + i * 4 +  8);
+                    const __m128 v3 = _mm_loadu_ps(in + i * 4 + 12);
+
+                    // Four squared lengths at once, then one lane per vector
+                    const __m128 d = hsum4(_mm_mul_ps(v0, v0), _mm_mul_ps(v1, v1), _mm_mul_ps(v2, v2), _mm_mul_ps(v3, v3));
+
+                    if (Fast)
+                    {
+                        const __m128 r = rsqrt_nr(d);
+                        _mm_storeu_ps(out + i * 4,      _mm_mul_ps(v0, _mm_shuffle_ps(r, r, 0x00)));
+                        _mm_storeu_ps(out + i * 4 +  4, _mm_mul_ps(v1, _mm_shuffle_ps(r, r, 0x55)));
+                        _mm_storeu_ps(out + i * 4 +  8, _mm_mul_ps(v2, _mm_shuffle_ps(r, r, 0xaa)));
+                        _mm_storeu_ps(out + i * 4 + 12, _mm_mul_ps(v3, _mm_shuffle_ps(r, r, 0xff)));
+                    }
+                    else
+                    {
+                        const __m128 n = _mm_sqrt_ps(d);
+                        _mm_storeu_ps(out + i * 4,      _mm_div_ps(v0, _mm_shuffle_ps(n, n, 0x00)));
+                        _mm_storeu_ps(out + i * 4 +  4, _mm_div_ps(v1, _mm_shuffle_ps(n, n, 0x55)));
+                        _mm_storeu_ps(out + i * 4 +  8, _mm_div_ps(v2, _mm_shuffle_ps(n, n, 0xaa)));
+                        _mm_storeu_ps(out + i * 4 + 12, _mm_div_ps(v3, _mm_shuffle_ps(n, n, 0xff)));
+                    }
+                }
+
+                for ( ; i != size; ++i)
+                {
+                    const __m128 v = _mm_loadu_ps(in + i * 4);
+                    const __m128 d = _mm_dp_ps(v, v, 0xff);
+                    _mm_storeu_ps(out + i * 4, Fast ? _mm_mul_ps(v, rsqrt_nr(d)) : _mm_div_ps(v, _mm_sqrt_ps(d)));
+                }
+            }
+
+            /// Loads the columns of the row-major 4x4 matrix m; for the modes with
+            /// vec3f results, lane 3 of c0..c2 (and of c3 unless projecting) is cleared
+            static inline void transform_columns(const float* m,
+                                                 const transform_mode mode,
+                                                 __m128& c0,
+                                                 __m128& c1,
+                                                 __m128& c2,
+                                                 __m128& c3) {
+
+                c0 = _mm_loadu_ps(m);
+                c1 = _mm_loadu_ps(m + 4);
+                c2 = _mm_loadu_ps(m + 8);
+                c3 = _mm_loadu_ps(m + 12);
+                _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+                if (mode == TRANSFORM_POINTS || mode == TRANSFORM_DIRS)
+                {
+                    c0 = _mm_blend_ps(c0, _mm_setzero_ps(), 0x8);
+                    c1 = _mm_blend_ps(c1, _mm_setzero_ps(), 0x8);
+                    c2 = _mm_blend_ps(c2, _mm_setzero_ps(), 0x8);
+                    c3 = _mm_blend_ps(c3, _mm_setzero_ps(), 0x8);
+                }
+            }
+
+            /// out[i] = m * in[i] over arrays of 4-float vectors (vec3f with its
+            /// zero padding lane, or vec4f), m a row-major 4x4 matrix; mode picks
+            /// the w multiplied and whether to divide by the result's w. out may
+            /// alias in
+            static void transform4(const float* m, const float* in, float* out, std::size_t size, transform_mode mode) {
+
+                switch (mode)
+                {
+                    case TRANSFORM_POINTS: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_POINTS>()); break;
+                    case TRANSFORM_DIRS: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_DIRS>()); break;
+                    case TRANSFORM_VEC4: transform4(m, in, out, size, std::integral_constant<transform_mode, TRANSFORM_VEC4>()); break;
+                    case PROJECT_POINTS: transform4(m, in, out, size, std::integral_constant<transform_mode, PROJECT_POINTS>()); break;
+                }
+            }
+
+            template <transform_mode Mode>
+            static inline void transform4(const float* m, const float* in, float* out, std::size_t size, std::integral_constant<transform_mode, Mode>) {
+
+                __m128 c0, c1, c2, c3;
+                transform_columns(m, Mode, c0, c1, c2, c3);
+
+                for (std::size_t i = 0; i != size; ++i)
+                {
+                    const __m128 v = _mm_loadu_ps(in + i * 4);
+
+                    __m128 r = lincomb(v, c0, c1, c2);
+                    if (Mode == TRANSFORM_VEC4) {
+                        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, 0xff), c3));
+                    } else if (Mode != TRANSFORM_DIRS) {
+                        r = _mm_add_ps(r, c3);
+                    }
+
+                    if (Mode == PROJECT_POINTS) {
+                        r = _mm_blend_ps(_mm_div_ps(r, _mm_shuffle_ps(r, r, 0xff)), _mm_setzero_ps(), 0x8);
+                    }
+
+                    _mm_storeu_ps(out + i * 4, r);
+                }
+            }
+
+            /// out[i] = transpose(in[i]) over arrays of 4x4 matrices, 16 floats
+            /// each; out may alias in
+            static void transpose_4x4(const float* in, float* out, std::size_t size) {
+
+                for (std::size_t i = 0; i != size; ++i)
+                {
+                    __m128 r0 = _mm_loadu_ps(in + i * 16);
+                    __m128 r1 = _mm_loadu_ps(in + i * 16 +  4);
+                    __m128 r2 = _mm_loadu_ps(in + i * 16 +  8);
+                    __m128 r3 = _mm_loadu_ps(in + i * 16 + 12);
+
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+                    _mm_storeu_ps(out + i * 16,      r0);
+                    _mm_storeu_ps(out + i * 16 +  4, r1);
+                    _mm_storeu_ps(out + i * 16 +  8, r2);
+                    _mm_storeu_ps(out + i * 16 + 12, r3);
+                }
+            }
+
+            /// Register tile of gemm_ps, rows x columns
+            static const std::size_t GEMM_MR = 4;
+            static const std::size_t GEMM_NR = 8;
+
+            /// Writes the mr x nr corner of a whole tile t (row stride nr_t) to c,
+            /// adding to c when accumulate is set
+            static inline void gemm_store(const float* t,
+                                          const std::size_t nr_t,
+                                          float* c,
+                                          const std::size_t ldc,
+                                          const std::size_t mr,
+                                          const std::size_t nr,
+                                          const bool accumulate) {
+
+                for (std::size_t i = 0; i != mr; ++i)
+                    for (std::size_t j = 0; j != nr; ++j)
+                        c[i * ldc + j] = accumulate ? c[i * ldc + j] + t[i * nr_t + j] : t[i * nr_t + j];
+            }
+
+            /// GEMM micro-kernel: the mr x nr block of C at c (row stride ldc) is
+            /// set to, or with accumulate incremented by, the product of a packed
+            /// A sliver (kc columns of GEMM_MR values) and a packed B sliver (kc
+            /// rows of GEMM_NR values). Slivers are zero-padded, so the whole
+            /// tile is computed and only the mr x nr corner is written
+            static void gemm_ps(const std::size_t kc,
+                                const float* a,
+                                const float* b,
+                                float* c,
+                                const std::size_t ldc,
+                                const std::size_t mr,
+                                const std::size_t nr,
+                                const bool accumulate) {
+
+                __m128 acc[GEMM_MR][2];
+#pragma GCC unroll 4
+                for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    acc[i][0] = acc[i][1] = _mm_setzero_ps();
+
+                for (std::size_t p = 0; p != kc; ++p)
+                {
+                    const __m128 b0 = _mm_load_ps(b);
+                    const __m128 b1 = _mm_load_ps(b + 4);
+#pragma GCC unroll 4
+                    for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    {
+                        const __m128 x = _mm_set1_ps(a[i]);
+                        acc[i][0] = _mm_add_ps(acc[i][0], _mm_mul_ps(x, b0));
+                        acc[i][1] = _mm_add_ps(acc[i][1], _mm_mul_ps(x, b1));
+                    }
+
+                    a += GEMM_MR;
+                    b += GEMM_NR;
+                }
+
+                if (mr == GEMM_MR && nr == GEMM_NR)
+                {
+#pragma GCC unroll 4
+                    for (std::size_t i = 0; i != GEMM_MR; ++i)
+                    {
+                        float* row = c + i * ldc;
+                        _mm_storeu_ps(row,     accumulate ? _mm_add_ps(_mm_loadu_ps(row),     acc[i][0]) : acc[i][0]);
+                        _mm_storeu_ps(row + 4, accumulate ? _mm_add_ps(_mm_loadu_ps(row + 4), acc[i][1]) : acc[i][1]);
+                    }
+
+                    return;
+                }
+
+                float t[GEMM_MR * GEMM_NR] __attribute__((aligned(16)));
+                for (std::size_t i = 0; i != GEMM_MR; ++i)
+                {
+                    _mm_store_ps(t + i * GEMM_NR,     acc[i][0]);
+                    _mm_store_ps(t + i * GEMM_NR + 4, acc[i][1]);
+                }
+
+                gemm_store(t, GEMM_NR, c, ldc, mr, nr, accumulate);
+            }
+
+            // Double precision; 2 lanes per register
+
+            /// Dynamic double product (N0 x N1) x (N1 x M1), row-major; out must not
+            /// alias either operand. Each pair of output columns accumulates
+            /// sum_k lhs(i, k) * rhs(k, j..j+1) in a register, odd columns are scalar
+            static void gemm_pd(const double* dat1,
+                                const double* dat2,
+                                double* out,
+                                std::size_t N0,
+                                std::size_t N1,
+                                std::size_t M1) {
+
+                for (std::size_t i = 0; i != N0; ++i)
+                {
+                    const double* row = dat1 + i * N1;
+
+                    std::size_t j = 0;
+                    for ( ; j + 2 <= M1; j += 2)
+                    {
+                        __m128d sum = _mm_setzero_pd();
+                        for (std::size_t k = 0; k != N1; ++k) {
+                            sum = _mm_add_pd(sum, _mm_mul_pd(_mm_set1_pd(row[k]), _mm_loadu_pd(dat2 + k * M1 + j)));
+                        }
+
+                        _mm_storeu_pd(out + i * M1 + j, sum);
+                    }
+
+                    for ( ; j != M1; ++j)
+                    {
+                        double sum = 0;
+                        for (std::size_t k = 0; k != N1; ++k) {
+                            sum += row[k] * dat2[k * M1 + j];
+                        }
+
+                        out[i * M1 + j] = sum;
+                    }
+                }
+            }
+
+            /// Dynamic double matrix x vector product (N0 x N1) x (N1 x 1); out must
+            /// not alias either operand
+            static void gemv_pd(const double* dat1,
+                                const double* dat2,
+                                double* out,
+                                std::size_t N0,
+                                std::size_t N1) {
+
+                for (std::size_t i = 0; i != N0; ++i)
+                {
+                    const double* row = dat1 + i * N1;
+
+                    __m128d sum = _mm_setzero_pd();
+
+                    std::size_t k = 0;
+                    for ( ; k + 2 <= N1; k += 2) {
+                        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(row + k), _mm_loadu_pd(dat2 + k)));
+                    }
+
+                    double tail = 0;
+                    for ( ; k != N1; ++k) {
+                        tail += row[k] * dat2[k];
+                    }
+
+                    out[i] = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum))) + tail;
+                }
+            }
+        };
+    }
+}
+
+#endif
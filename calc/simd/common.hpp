@@ -3,6 +3,10 @@
 #ifndef _CALC_SIMD_COMMON_HPP
 #define _CALC_SIMD_COMMON_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
 #include <immintrin.h>
 
 #define __stride__(a) (16 / (a))
@@ -38,6 +42,97 @@ namespace calc {
 
         template <> inline void store(float* dat, __m128 fill) { _mm_store_ps(dat, fill); }
         template <> inline void store(double* dat, __m128d fill) { _mm_store_pd(dat, fill); }
+
+        /// @return floats p[0..count), count < 4, in the low lanes; the rest zero.
+        ///         Reads nothing past p + count
+        template <unsigned Count>
+        inline __m128 load_partial(const float* p) {
+
+            switch (Count)
+            {
+                case 1: return _mm_load_ss(p);
+                case 2: return _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(p));
+                case 3: return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(p)), _mm_load_ss(p + 2));
+                default: return _mm_loadu_ps(p);
+            }
+        }
+
+        /// @overload
+        /// Count known at run time; folds to load_partial<Count> when constant
+        inline __m128 load_partial(const float* p, const unsigned count) {
+
+            switch (count)
+            {
+                case 1: return load_partial<1>(p);
+                case 2: return load_partial<2>(p);
+                case 3: return load_partial<3>(p);
+                default: return _mm_loadu_ps(p);
+            }
+        }
+
+        /// @overload
+        inline __m128d load_partial(const double* p, const unsigned count) {
+            return (count == 1) ? _mm_load_sd(p) : _mm_loadu_pd(p);
+        }
+
+        /// Stores the low count lanes of v, count <= 4; writes nothing past
+        /// p + count. Folds to a single store when count is a constant
+        inline void store_partial(float* p, const __m128 v, const unsigned count) {
+
+            switch (count)
+            {
+                case 1: _mm_store_ss(p, v); break;
+                case 2: _mm_storel_pi(reinterpret_cast<__m64*>(p), v); break;
+                case 3: _mm_storel_pi(reinterpret_cast<__m64*>(p), v); _mm_store_ss(p + 2, _mm_movehl_ps(v, v)); break;
+                default: _mm_storeu_ps(p, v); break;
+            }
+        }
+
+        /// @overload
+        inline void store_partial(double* p, const __m128d v, const unsigned count) {
+
+            if (count == 1) {
+                _mm_store_sd(p, v);
+            }
+            else {
+                _mm_storeu_pd(p, v);
+            }
+        }
+
+        /// @return v with the lanes from count on cleared
+        inline __m128 keep_low(const __m128 v, const unsigned count) {
+            return _mm_and_ps(v, _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(int(count)), _mm_setr_epi32(0, 1, 2, 3))));
+        }
+
+        /// @overload
+        inline __m128d keep_low(const __m128d v, const unsigned count) {
+            return (count == 1) ? _mm_move_sd(_mm_setzero_pd(), v) : v;
+        }
+
+        /// enum transform_mode
+        /*! What the transform4 kernels multiply by the matrix and what they keep
+         */
+        enum transform_mode {
+            TRANSFORM_POINTS, //> (x, y, z, 1); lane 3 of the result cleared (vec3f)
+            TRANSFORM_DIRS,   //> (x, y, z, 0); lane 3 of the result cleared
+            TRANSFORM_VEC4,   //> (x, y, z, w); all four lanes kept
+            PROJECT_POINTS    //> (x, y, z, 1), divided by the result's w; lane 3 cleared
+        };
+
+        /// @return per-thread, 16-byte aligned scratch space for at least size floats;
+        ///         grows geometrically and is never released, so steady-state use does not allocate
+        inline float* scratch(const std::size_t size) {
+
+            struct block { float dat[4]; } __attribute__((aligned(16)));
+            static thread_local std::vector<block> buffer;
+
+            const std::size_t registers = (size + 3) / 4;
+            if (buffer.size() < registers) {
+                buffer.resize(std::max(registers, 2 * buffer.size()));
+            }
+
+            return reinterpret_cast<float*>(buffer.data());
+        }
     }
 }
 
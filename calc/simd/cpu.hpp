@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef _CALC_SIMD_CPU_HPP
+#define _CALC_SIMD_CPU_HPP
+
+#include <cpuid.h>
+
+// Compiles a function for an instruction set above the build baseline;
+// such functions may only be reached through the dispatch table
+#define __target_avx2__   __attribute__((target("avx2,fma")))
+#define __target_avx512__ __attribute__((target("avx512f,avx2,fma")))
+
+namespace calc {
+
+    /// enum backend
+    /*! SIMD kernel sets, ordered by register width
+     */
+    enum backend {
+        BACKEND_SSE4   = 0, //> 128-bit, build baseline
+        BACKEND_AVX2   = 1, //> 256-bit + FMA
+        BACKEND_AVX512 = 2  //> 512-bit + FMA
+    };
+
+    namespace detail {
+
+        /// @return true if the OS saves every register state in mask (XCR0)
+        inline bool xcr0_enabled(const unsigned mask) {
+
+            unsigned eax, edx;
+            __asm__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (eax & mask) == mask;
+        }
+
+        /// @return the widest backend supported by both the cpu and the OS
+        inline backend detect_backend() {
+
+            unsigned eax, ebx, ecx, edx;
+            if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+                return BACKEND_SSE4;
+            }
+
+            // AVX state (xmm | ymm) must be enabled by the OS
+            const bool avx = (ecx & bit_OSXSAVE) && (ecx & bit_AVX) && (ecx & bit_FMA);
+            if (!avx || !xcr0_enabled(0x06)) {
+                return BACKEND_SSE4;
+            }
+
+            if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_AVX2)) {
+                return BACKEND_SSE4;
+            }
+
+            // AVX-512 state (opmask | zmm_hi256 | hi16_zmm) must be enabled by the OS
+            if ((ebx & bit_AVX512F) && xcr0_enabled(0xe6)) {
+                return BACKEND_AVX512;
+            }
+
+            return BACKEND_AVX2;
+        }
+
+        /// @return the widest backend of the host, detected once
+        inline backend host_backend() {
+
+            static const backend b = detect_backend();
+            return b;
+        }
+    }
+}
+
+#endif
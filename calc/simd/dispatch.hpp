@@ -0,0 +1,151 @@
+#pragma once
+
+#ifndef _CALC_SIMD_DISPATCH_HPP
+#define _CALC_SIMD_DISPATCH_HPP
+
+#include <cstddef>
+
+#include "backend_avx2.hpp"
+#include "backend_avx512.hpp"
+#include "backend_sse4.hpp"
+#include "cpu.hpp"
+
+namespace calc {
+
+    namespace detail {
+
+        /// struct kernel_table
+        /*! Float and double kernels of a single backend
+         */
+        struct kernel_table {
+
+            backend type;
+            const char* name;
+
+            void (*mul_4x4x1)(const float*, const float*, float*);
+            void (*mul_4x4x4)(const float*, const float*, float*);
+            void (*mul_3x3x1)(const float*, const float*, float*);
+            void (*mul_3x3x3)(const float*, const float*, float*);
+
+            void (*soa_mul_4x4)(const float*, float*, std::size_t, std::size_t, std::size_t, std::size_t);
+            void (*transpose_4x4)(const float*, float*, std::size_t);
+
+            // GEMM micro-kernel and its register tile, rows x columns
+            void (*gemm_ps)(std::size_t, const float*, const float*, float*, std::size_t, std::size_t, std::size_t, bool);
+            std::size_t gemm_mr;
+            std::size_t gemm_nr;
+
+            void (*sincos)(const float*, float*, float*, std::size_t);
+
+            void (*dot4)(const float*, const float*, float*, std::size_t);
+            void (*normal4)(const float*, float*, std::size_t);
+            void (*normal4_fast)(const float*, float*, std::size_t);
+            void (*transform4)(const float*, const float*, float*, std::size_t, transform_mode);
+
+            void (*gemm_pd)(const double*, const double*, double*, std::size_t, std::size_t, std::size_t);
+            void (*gemv_pd)(const double*, const double*, double*, std::size_t, std::size_t);
+        };
+
+        /// @return the kernel table of backend b
+        inline const kernel_table& table_for(const backend b) {
+
+            static const kernel_table tables[] = {
+                {
+                    BACKEND_SSE4, "sse4",
+                    &sse4_kernels::mul_4x4x1,
+                    &sse4_kernels::mul_4x4x4,
+                    &sse4_kernels::mul_3x3x1,
+                    &sse4_kernels::mul_3x3x3,
+                    &sse4_kernels::soa_mul_4x4,
+                    &sse4_kernels::transpose_4x4,
+                    &sse4_kernels::gemm_ps,
+                    sse4_kernels::GEMM_MR,
+                    sse4_kernels::GEMM_NR,
+                    &sse4_kernels::sincos,
+                    &sse4_kernels::dot4,
+                    &sse4_kernels::normal4,
+                    &sse4_kernels::normal4_fast,
+                    &sse4_kernels::transform4,
+                    &sse4_kernels::gemm_pd,
+                    &sse4_kernels::gemv_pd
+                },
+                {
+                    BACKEND_AVX2, "avx2",
+                    &sse4_kernels::mul_4x4x1, //> ymm pairs of rows cost a cross-lane fold; slower in calc_bench
+                    &sse4_kernels::mul_4x4x4,
+                    &sse4_kernels::mul_3x3x1, //> a single horizontal reduction; no gain from FMA
+                    &avx2_kernels::mul_3x3x3,
+                    &avx2_kernels::soa_mul_4x4,
+                    &avx2_kernels::transpose_4x4,
+                    &avx2_kernels::gemm_ps,
+                    avx2_kernels::GEMM_MR,
+                    avx2_kernels::GEMM_NR,
+                    &avx2_kernels::sincos,
+                    &avx2_kernels::dot4,
+                    &avx2_kernels::normal4,
+                    &avx2_kernels::normal4_fast,
+                    &avx2_kernels::transform4,
+                    &avx2_kernels::gemm_pd,
+                    &avx2_kernels::gemv_pd
+                },
+                {
+                    BACKEND_AVX512, "avx512",
+                    &sse4_kernels::mul_4x4x1, //> as for avx2; a zmm product is slower still
+                    &sse4_kernels::mul_4x4x4,
+                    &sse4_kernels::mul_3x3x1,
+                    &avx2_kernels::mul_3x3x3,
+                    &avx512_kernels::soa_mul_4x4,
+                    &avx512_kernels::transpose_4x4,
+                    &avx512_kernels::gemm_ps,
+                    avx512_kernels::GEMM_MR,
+                    avx512_kernels::GEMM_NR,
+                    &avx2_kernels::sincos,
+                    &avx2_kernels::dot4, //> 16-byte vectors; zmm shuffles would cost more than they save
+                    &avx2_kernels::normal4,
+                    &avx2_kernels::normal4_fast,
+                    &avx512_kernels::transform4,
+                    &avx2_kernels::gemm_pd, //> rows of small matrices rarely fill a zmm
+                    &avx2_kernels::gemv_pd
+                }
+            };
+
+            return tables[b];
+        }
+
+        /// @return reference to the active table, initialized from cpuid on first use
+        inline const kernel_table*& active_table() {
+
+            static const kernel_table* table = &table_for(host_backend());
+            return table;
+        }
+
+        /// @return the active kernel table
+        inline const kernel_table& kernels() {
+            return *active_table();
+        }
+    }
+
+    /// @return the backend used by the calc::matrix operators
+    inline backend get_backend() {
+        return detail::kernels().type;
+    }
+
+    /// @return printable backend name
+    inline const char* get_backend_name(const backend b) {
+        return detail::table_for(b).name;
+    }
+
+    /// Overrides the backend picked at startup (e.g. to compare backends)
+    /// @return false, leaving the active backend unchanged, if the host cannot run b
+    inline bool set_backend(const backend b) {
+
+        if (b > detail::host_backend()) {
+            return false;
+        }
+
+        detail::active_table() = &detail::table_for(b);
+        return true;
+    }
+}
+
+#endif
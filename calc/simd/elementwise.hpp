@@ -0,0 +1,449 @@
+#pragma once
+
+#ifndef _CALC_SIMD_ELEMENTWISE_HPP
+#define _CALC_SIMD_ELEMENTWISE_HPP
+
+#include <cstddef>
+#include <type_traits>
+
+#ifndef __NO_USE_SIMD__
+#include "common.hpp"
+#include "dispatch.hpp"
+#endif
+
+/*! Elementwise kernel engine
+ *!
+ *! out[i] = f(a[i], b[i], ..., s, ...) over exactly size elements, for any
+ *! tree f of +, -, * and / on float or double arrays and scalars. The tree is
+ *! evaluated a register at a time in a single pass: a * s + b - c reads a, b
+ *! and c once and writes out once, with no temporaries.
+ *!
+ *! The widest registers of the active backend cover as much as they can;
+ *! the remainder steps down through narrower registers to one partial
+ *! 128-bit load and store, so nothing is read or written past size and the
+ *! buffers need no padding. A calc::matrix result is padded to a whole
+ *! register, and its last register is stored whole with the spare lanes
+ *! cleared instead: a partial store, like a masked AVX-512 one, blocks
+ *! store forwarding into the next whole-register read of the matrix.
+ *!
+ *! out may be any of the inputs; element i only depends on element i.
+ *! Without SIMD the same trees are evaluated one element at a time.
+ */
+
+namespace calc {
+
+    namespace detail {
+
+        /// Elementwise operations
+        struct ew_add {
+            template <typename T> static T apply(const T a, const T b) { return a + b; }
+#ifndef __NO_USE_SIMD__
+            static __m128 apply(const __m128 a, const __m128 b) { return _mm_add_ps(a, b); }
+            static __m128d apply(const __m128d a, const __m128d b) { return _mm_add_pd(a, b); }
+            __target_avx2__ static __m256 apply(const __m256 a, const __m256 b) { return _mm256_add_ps(a, b); }
+            __target_avx2__ static __m256d apply(const __m256d a, const __m256d b) { return _mm256_add_pd(a, b); }
+            __target_avx512__ static __m512 apply(const __m512 a, const __m512 b) { return _mm512_add_ps(a, b); }
+            __target_avx512__ static __m512d apply(const __m512d a, const __m512d b) { return _mm512_add_pd(a, b); }
+#endif
+        };
+
+        struct ew_sub {
+            template <typename T> static T apply(const T a, const T b) { return a - b; }
+#ifndef __NO_USE_SIMD__
+            static __m128 apply(const __m128 a, const __m128 b) { return _mm_sub_ps(a, b); }
+            static __m128d apply(const __m128d a, const __m128d b) { return _mm_sub_pd(a, b); }
+            __target_avx2__ static __m256 apply(const __m256 a, const __m256 b) { return _mm256_sub_ps(a, b); }
+            __target_avx2__ static __m256d apply(const __m256d a, const __m256d b) { return _mm256_sub_pd(a, b); }
+            __target_avx512__ static __m512 apply(const __m512 a, const __m512 b) { return _mm512_sub_ps(a, b); }
+            __target_avx512__ static __m512d apply(const __m512d a, const __m512d b) { return _mm512_sub_pd(a, b); }
+#endif
+        };
+
+        struct ew_mul {
+            template <typename T> static T apply(const T a, const T b) { return a * b; }
+#ifndef __NO_USE_SIMD__
+            static __m128 apply(const __m128 a, const __m128 b) { return _mm_mul_ps(a, b); }
+            static __m128d apply(const __m128d a, const __m128d b) { return _mm_mul_pd(a, b); }
+            __target_avx2__ static __m256 apply(const __m256 a, const __m256 b) { return _mm256_mul_ps(a, b); }
+            __target_avx2__ static __m256d apply(const __m256d a, const __m256d b) { return _mm256_mul_pd(a, b); }
+            __target_avx512__ static __m512 apply(const __m512 a, const __m512 b) { return _mm512_mul_ps(a, b); }
+            __target_avx512__ static __m512d apply(const __m512d a, const __m512d b) { return _mm512_mul_pd(a, b); }
+#endif
+        };
+
+        struct ew_div {
+            template <typename T> static T apply(const T a, const T b) { return a / b; }
+#ifndef __NO_USE_SIMD__
+            static __m128 apply(const __m128 a, const __m128 b) { return _mm_div_ps(a, b); }
+            static __m128d apply(const __m128d a, const __m128d b) { return _mm_div_pd(a, b); }
+            __target_avx2__ static __m256 apply(const __m256 a, const __m256 b) { return _mm256_div_ps(a, b); }
+            __target_avx2__ static __m256d apply(const __m256d a, const __m256d b) { return _mm256_div_pd(a, b); }
+            __target_avx512__ static __m512 apply(const __m512 a, const __m512 b) { return _mm512_div_ps(a, b); }
+            __target_avx512__ static __m512d apply(const __m512d a, const __m512d b) { return _mm512_div_pd(a, b); }
+#endif
+        };
+#ifndef __NO_USE_SIMD__
+        /// struct ew_regs
+        /*! Registers of each width for T, and their unaligned loads, stores
+         *! and broadcasts
+         */
+        template <typename T>
+        struct ew_regs;
+
+        template <>
+        struct ew_regs<float> {
+
+            typedef __m128 r128;
+            typedef __m256 r256;
+            typedef __m512 r512;
+
+            static r128 load128(const float* p) { return _mm_loadu_ps(p); }
+            static r128 set128(const float s) { return _mm_set1_ps(s); }
+            static void store128(float* p, const r128 v) { _mm_storeu_ps(p, v); }
+
+            __target_avx2__ static r256 load256(const float* p) { return _mm256_loadu_ps(p); }
+            __target_avx2__ static r256 set256(const float s) { return _mm256_set1_ps(s); }
+            __target_avx2__ static void store256(float* p, const r256 v) { _mm256_storeu_ps(p, v); }
+
+            __target_avx512__ static r512 load512(const float* p) { return _mm512_loadu_ps(p); }
+            __target_avx512__ static r512 set512(const float s) { return _mm512_set1_ps(s); }
+            __target_avx512__ static void store512(float* p, const r512 v) { _mm512_storeu_ps(p, v); }
+        };
+
+        template <>
+        struct ew_regs<double> {
+
+            typedef __m128d r128;
+            typedef __m256d r256;
+            typedef __m512d r512;
+
+            static r128 load128(const double* p) { return _mm_loadu_pd(p); }
+            static r128 set128(const double s) { return _mm_set1_pd(s); }
+            static void store128(double* p, const r128 v) { _mm_storeu_pd(p, v); }
+
+            __target_avx2__ static r256 load256(const double* p) { return _mm256_loadu_pd(p); }
+            __target_avx2__ static r256 set256(const double s) { return _mm256_set1_pd(s); }
+            __target_avx2__ static void store256(double* p, const r256 v) { _mm256_storeu_pd(p, v); }
+
+            __target_avx512__ static r512 load512(const double* p) { return _mm512_loadu_pd(p); }
+            __target_avx512__ static r512 set512(const double s) { return _mm512_set1_pd(s); }
+            __target_avx512__ static void store512(double* p, const r512 v) { _mm512_storeu_pd(p, v); }
+        };
+#endif
+        /// struct ew_input
+        /*! An array operand
+         */
+        template <typename T>
+        struct ew_input {
+
+            typedef T value_type;
+
+            const T* p;
+
+            explicit ew_input(const T* p) : p(p) {}
+
+            T at(const std::size_t i) const {
+                return p[i];
+            }
+#ifndef __NO_USE_SIMD__
+            typedef ew_regs<T> regs;
+
+            typename regs::r128 packet128(const std::size_t i) const {
+                return regs::load128(p + i);
+            }
+
+            /// The first count lanes, count below one register; the rest zero
+            typename regs::r128 packet128(const std::size_t i, const unsigned count) const {
+                return load_partial(p + i, count);
+            }
+
+            __target_avx2__
+            typename regs::r256 packet256(const std::size_t i) const {
+                return regs::load256(p + i);
+            }
+
+            __target_avx512__
+            typename regs::r512 packet512(const std::size_t i) const {
+                return regs::load512(p + i);
+            }
+#endif
+        };
+
+        /// struct ew_scalar
+        /*! A scalar operand, broadcast to every lane
+         */
+        template <typename T>
+        struct ew_scalar {
+
+            typedef T value_type;
+
+            T s;
+
+            explicit ew_scalar(const T s) : s(s) {}
+
+            T at(std::size_t) const {
+                return s;
+            }
+#ifndef __NO_USE_SIMD__
+            typedef ew_regs<T> regs;
+
+            typename regs::r128 packet128(std::size_t) const {
+                return regs::set128(s);
+            }
+
+            typename regs::r128 packet128(std::size_t, unsigned) const {
+                return regs::set128(s);
+            }
+
+            __target_avx2__
+            typename regs::r256 packet256(std::size_t) const {
+                return regs::set256(s);
+            }
+
+            __target_avx512__
+            typename regs::r512 packet512(std::size_t) const {
+                return regs::set512(s);
+            }
+#endif
+        };
+
+        /// struct ew_binary
+        /*! lhs (op) rhs
+         */
+        template <typename L,
+                  typename R,
+                  typename Op>
+        struct ew_binary {
+
+            static_assert(std::is_same<typename L::value_type, typename R::value_type>::value, "mixed element types");
+
+            typedef typename L::value_type value_type;
+
+            L lhs;
+            R rhs;
+
+            ew_binary(const L& lhs, const R& rhs) : lhs(lhs), rhs(rhs) {}
+
+            value_type at(const std::size_t i) const {
+                return Op::apply(lhs.at(i), rhs.at(i));
+            }
+#ifndef __NO_USE_SIMD__
+            typedef ew_regs<value_type> regs;
+
+            typename regs::r128 packet128(const std::size_t i) const {
+                return Op::apply(lhs.packet128(i), rhs.packet128(i));
+            }
+
+            typename regs::r128 packet128(const std::size_t i, const unsigned count) const {
+                return Op::apply(lhs.packet128(i, count), rhs.packet128(i, count));
+            }
+
+            __target_avx2__
+            typename regs::r256 packet256(const std::size_t i) const {
+                return Op::apply(lhs.packet256(i), rhs.packet256(i));
+            }
+
+            __target_avx512__
+            typename regs::r512 packet512(const std::size_t i) const {
+                return Op::apply(lhs.packet512(i), rhs.packet512(i));
+            }
+#endif
+        };
+
+        template <typename E>
+        inline void ew_run_scalar(const E& e, typename E::value_type* out, const std::size_t size) {
+
+            for (std::size_t i = 0; i != size; ++i)
+                out[i] = e.at(i);
+        }
+#ifndef __NO_USE_SIMD__
+        /// Elements [i, size) with 128-bit registers, the last one partial;
+        /// padded: out has room for the whole last register, lanes past size
+        /// are written as zero. e is taken by value: a local copy cannot
+        /// alias out, so its pointers stay in registers
+        template <bool Padded,
+                  typename E>
+        inline void ew_run_sse4(const E e, typename E::value_type* out, std::size_t i, const std::size_t size) {
+
+            typedef typename E::value_type T;
+            const std::size_t lanes = 16 / sizeof(T);
+
+            for ( ; i + lanes <= size; i += lanes)
+                ew_regs<T>::store128(out + i, e.packet128(i));
+
+            // Fewer than lanes remain; the modulo tells the compiler as much
+            const unsigned rest = unsigned(size - i) % lanes;
+            if (rest != 0)
+            {
+                if (Padded) {
+                    ew_regs<T>::store128(out + i, keep_low(e.packet128(i, rest), rest));
+                }
+                else {
+                    store_partial(out + i, e.packet128(i, rest), rest);
+                }
+            }
+        }
+
+        template <bool Padded,
+                  typename E>
+        __target_avx2__
+        inline void ew_run_avx2(const E e, typename E::value_type* out, std::size_t i, const std::size_t size) {
+
+            typedef typename E::value_type T;
+            const std::size_t lanes = 32 / sizeof(T);
+
+            for ( ; i + lanes <= size; i += lanes)
+                ew_regs<T>::store256(out + i, e.packet256(i));
+
+            // At most one whole 128-bit register remains, then a partial one
+            ew_run_sse4<Padded>(e, out, i, size);
+        }
+
+        template <bool Padded,
+                  typename E>
+        __target_avx512__
+        inline void ew_run_avx512(const E e, typename E::value_type* out, std::size_t i, const std::size_t size) {
+
+            typedef typename E::value_type T;
+            const std::size_t lanes = 64 / sizeof(T);
+
+            for ( ; i + lanes <= size; i += lanes)
+                ew_regs<T>::store512(out + i, e.packet512(i));
+
+            if (i + lanes / 2 <= size)
+            {
+                ew_regs<T>::store256(out + i, e.packet256(i));
+                i += lanes / 2;
+            }
+
+            ew_run_avx2<Padded>(e, out, i, size);
+        }
+#endif
+        /// out[i] = e at i for i in [0, size), with the active backend;
+        /// padded: out is a calc::matrix buffer, whose padding lanes must stay
+        /// zero (see calc::uninit)
+        template <bool Padded = false,
+                  typename E>
+        inline void elementwise(const E& e, typename E::value_type* out, const std::size_t size) {
+#ifdef __NO_USE_SIMD__
+            ew_run_scalar(e, out, size);
+#else
+            switch (kernels().type)
+            {
+                case BACKEND_AVX512: ew_run_avx512<Padded>(e, out, 0, size); break;
+                case BACKEND_AVX2:   ew_run_avx2<Padded>(e, out, 0, size); break;
+                default:             ew_run_sse4<Padded>(e, out, 0, size); break;
+            }
+#endif
+        }
+    }
+
+    /// class elementwise_expr
+    /*! Fused elementwise expression over arrays; see calc::elements
+     */
+    template <typename E>
+    class elementwise_expr {
+
+        E node_;
+
+    public:
+
+        typedef typename E::value_type value_type;
+
+        /// ctor.
+        explicit elementwise_expr(const E& node) : node_(node) {}
+
+        const E& node() const {
+            return node_;
+        }
+    };
+
+    /// @return the array p as an operand of a fused elementwise expression:
+    ///
+    ///   calc::elementwise(out, size, calc::elements(a) * s + calc::elements(b) - calc::elements(c));
+    ///
+    template <typename T>
+    inline elementwise_expr<detail::ew_input<T> > elements(const T* p) {
+        return elementwise_expr<detail::ew_input<T> >(detail::ew_input<T>(p));
+    }
+
+    /// Evaluates e into out[0..size) in one pass; out may be one of e's arrays
+    template <typename E>
+    inline void elementwise(typename E::value_type* out, const std::size_t size, const elementwise_expr<E>& e) {
+        detail::elementwise(e.node(), out, size);
+    }
+
+    /// @return lhs (op) rhs, elementwise
+    template <typename Op,
+              typename L,
+              typename R>
+    inline elementwise_expr<detail::ew_binary<L, R, Op> > make_elementwise(const elementwise_expr<L>& lhs, const elementwise_expr<R>& rhs) {
+        return elementwise_expr<detail::ew_binary<L, R, Op> >(detail::ew_binary<L, R, Op>(lhs.node(), rhs.node()));
+    }
+
+    /// @return e (op) s, elementwise
+    template <typename Op,
+              typename E>
+    inline elementwise_expr<detail::ew_binary<E, detail::ew_scalar<typename E::value_type>, Op> > make_elementwise(const elementwise_expr<E>& e, const typename E::value_type s) {
+        typedef detail::ew_binary<E, detail::ew_scalar<typename E::value_type>, Op> node;
+        return elementwise_expr<node>(node(e.node(), detail::ew_scalar<typename E::value_type>(s)));
+    }
+
+    /// @overload
+    template <typename L, typename R>
+    inline elementwise_expr<detail::ew_binary<L, R, detail::ew_add> > operator+(const elementwise_expr<L>& lhs, const elementwise_expr<R>& rhs) {
+        return make_elementwise<detail::ew_add>(lhs, rhs);
+    }
+
+    /// @overload
+    template <typename L, typename R>
+    inline elementwise_expr<detail::ew_binary<L, R, detail::ew_sub> > operator-(const elementwise_expr<L>& lhs, const elementwise_expr<R>& rhs) {
+        return make_elementwise<detail::ew_sub>(lhs, rhs);
+    }
+
+    /// @overload
+    /// Schur (Hadamard) product
+    template <typename L, typename R>
+    inline elementwise_expr<detail::ew_binary<L, R, detail::ew_mul> > operator*(const elementwise_expr<L>& lhs, const elementwise_expr<R>& rhs) {
+        return make_elementwise<detail::ew_mul>(lhs, rhs);
+    }
+
+    /// @overload
+    template <typename L, typename R>
+    inline elementwise_expr<detail::ew_binary<L, R, detail::ew_div> > operator/(const elementwise_expr<L>& lhs, const elementwise_expr<R>& rhs) {
+        return make_elementwise<detail::ew_div>(lhs, rhs);
+    }
+
+    /// @overload
+    template <typename E>
+    inline elementwise_expr<detail::ew_binary<E, detail::ew_scalar<typename E::value_type>, detail::ew_add> > operator+(const elementwise_expr<E>& e, const typename E::value_type s) {
+        return make_elementwise<detail::ew_add>(e, s);
+    }
+
+    /// @overload
+    template <typename E>
+    inline elementwise_expr<detail::ew_binary<E, detail::ew_scalar<typename E::value_type>, detail::ew_sub> > operator-(const elementwise_expr<E>& e, const typename E::value_type s) {
+        return make_elementwise<detail::ew_sub>(e, s);
+    }
+
+    /// @overload
+    template <typename E>
+    inline elementwise_expr<detail::ew_binary<E, detail::ew_scalar<typename E::value_type>, detail::ew_mul> > operator*(const elementwise_expr<E>& e, const typename E::value_type s) {
+        return make_elementwise<detail::ew_mul>(e, s);
+    }
+
+    /// @overload
+    template <typename E>
+    inline elementwise_expr<detail::ew_binary<E, detail::ew_scalar<typename E::value_type>, detail::ew_mul> > operator*(const typename E::value_type s, const elementwise_expr<E>& e) {
+        return make_elementwise<detail::ew_mul>(e, s);
+    }
+
+    /// @overload
+    /// Divides by s in every lane, as scalar division does; no reciprocal
+    template <typename E>
+    inline elementwise_expr<detail::ew_binary<E, detail::ew_scalar<typename E::value_type>, detail::ew_div> > operator/(const elementwise_expr<E>& e, const typename E::value_type s) {
+        return make_elementwise<detail::ew_div>(e, s);
+    }
+}
+
+#endif
@@ -0,0 +1,421 @@
+#pragma once
+
+#ifndef _CALC_SIMD_GEMM_HPP
+#define _CALC_SIMD_GEMM_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+#include "dispatch.hpp"
+
+namespace calc {
+
+    namespace detail {
+
+        /// struct gemm_blocking
+        /*! Cache blocking of the packed GEMM: a KC x NC panel of B (2 MB) is
+         *! packed once per pass and stays in L3, an MC x KC block of A (about
+         *! 120 KB) is packed per pass over it and stays in L2, and one KC x NR
+         *! sliver of B stays in L1 while the micro-kernel sweeps the block
+         */
+        struct gemm_blocking {
+
+            static const std::size_t KC = 256;
+            static const std::size_t NC = 2048;
+            static const std::size_t MC = 120;
+
+            /// Work per thread below which another thread costs more than it
+            /// saves (a wake-up and two barriers per B panel)
+            static const std::size_t MIN_FLOPS = std::size_t(1) << 22;
+        };
+
+        /// class gemm_buffer
+        /*! Packing space aligned to 64 bytes by hand: std::allocator need not
+         *! honour an over-aligned block type in C++14, so it over-allocates
+         *! through operator new (still seen by allocation counters) and
+         *! rounds up; grows only, so steady-state products do not allocate
+         */
+        class gemm_buffer {
+
+        public:
+
+            gemm_buffer() : raw_(nullptr), dat_(nullptr), size_(0) {}
+            ~gemm_buffer() { ::operator delete(raw_); }
+
+            gemm_buffer(const gemm_buffer&) = delete;
+            gemm_buffer& operator=(const gemm_buffer&) = delete;
+
+            /// @return space for at least size floats; earlier contents are lost on growth
+            float* reserve(const std::size_t size) {
+
+                if (size_ < size)
+                {
+                    void* raw = ::operator new(size * sizeof(float) + 63);
+
+                    ::operator delete(raw_);
+                    raw_ = raw;
+                    dat_ = reinterpret_cast<float*>((reinterpret_cast<std::uintptr_t>(raw) + 63) & ~std::uintptr_t(63));
+                    size_ = size;
+                }
+
+                return dat_;
+            }
+
+            float* data() const {
+                return dat_;
+            }
+
+        private:
+
+            void* raw_;
+            float* dat_;
+            std::size_t size_;
+        };
+
+        /// Packs the mc x kc block of A at a (row stride lda) into slivers of
+        /// mr rows, column by column; rows past mc are zero
+        inline void gemm_pack_a(const float* a,
+                                const std::size_t lda,
+                                const std::size_t mc,
+                                const std::size_t kc,
+                                const std::size_t mr,
+                                float* out) {
+
+            for (std::size_t ir = 0; ir < mc; ir += mr)
+            {
+                const std::size_t rows = std::min(mr, mc - ir);
+                for (std::size_t p = 0; p != kc; ++p)
+                {
+                    std::size_t i = 0;
+                    for ( ; i != rows; ++i)
+                        *out++ = a[(ir + i) * lda + p];
+                    for ( ; i != mr; ++i)
+                        *out++ = 0;
+                }
+            }
+        }
+
+        /// Packs the kc x nc panel of B at b (row stride ldb) into slivers of
+        /// nr columns, row by row; columns past nc are zero
+        inline void gemm_pack_b(const float* b,
+                                const std::size_t ldb,
+                                const std::size_t kc,
+                                const std::size_t nc,
+                                const std::size_t nr,
+                                float* out) {
+
+            for (std::size_t jr = 0; jr < nc; jr += nr)
+            {
+                const std::size_t cols = std::min(nr, nc - jr);
+                for (std::size_t p = 0; p != kc; ++p)
+                {
+                    const float* row = b + p * ldb + jr;
+
+                    std::size_t j = 0;
+                    for ( ; j != cols; ++j)
+                        *out++ = row[j];
+                    for ( ; j != nr; ++j)
+                        *out++ = 0;
+                }
+            }
+        }
+
+        /// Rows [r0, r1) of C against the packed kcur x ncur block of B at bp,
+        /// whose top-left is B(pc, jc); blocks of A are packed into ap
+        inline void gemm_block(const kernel_table& t,
+                               const float* a,
+                               const float* bp,
+                               float* ap,
+                               float* c,
+                               const std::size_t k,
+                               const std::size_t m,
+                               const std::size_t pc,
+                               const std::size_t kcur,
+                               const std::size_t jc,
+                               const std::size_t ncur,
+                               const std::size_t r0,
+                               const std::size_t r1) {
+
+            const std::size_t mr = t.gemm_mr;
+            const std::size_t nr = t.gemm_nr;
+            const std::size_t mc = gemm_blocking::MC / mr * mr;
+
+            for (std::size_t ic = r0; ic < r1; ic += mc)
+            {
+                const std::size_t mcur = std::min(mc, r1 - ic);
+                gemm_pack_a(a + ic * k + pc, k, mcur, kcur, mr, ap);
+
+                for (std::size_t jr = 0; jr < ncur; jr += nr)
+                {
+                    for (std::size_t ir = 0; ir < mcur; ir += mr)
+                    {
+                        t.gemm_ps(kcur,
+                                  ap + ir * kcur,
+                                  bp + jr * kcur,
+                                  c + (ic + ir) * m + jc + jr,
+                                  m,
+                                  std::min(mr, mcur - ir),
+                                  std::min(nr, ncur - jr),
+                                  pc != 0);
+                    }
+                }
+            }
+        }
+
+        /// C = A * B, A n x k, B k x m, all row-major and unpadded, serially
+        /// with the micro-kernel of table t
+        inline void gemm_serial(const kernel_table& t,
+                                const float* a,
+                                const float* b,
+                                float* c,
+                                const std::size_t n,
+                                const std::size_t k,
+                                const std::size_t m) {
+
+            const std::size_t nc = gemm_blocking::NC / t.gemm_nr * t.gemm_nr;
+            const std::size_t kc = gemm_blocking::KC;
+
+            static thread_local gemm_buffer buffer;
+            float* bp = buffer.reserve(gemm_blocking::KC * gemm_blocking::NC + gemm_blocking::MC * gemm_blocking::KC);
+            float* ap = bp + gemm_blocking::KC * gemm_blocking::NC;
+
+            for (std::size_t jc = 0; jc < m; jc += nc)
+            {
+                const std::size_t ncur = std::min(nc, m - jc);
+                for (std::size_t pc = 0; pc < k; pc += kc)
+                {
+                    const std::size_t kcur = std::min(kc, k - pc);
+
+                    gemm_pack_b(b + pc * m + jc, m, kcur, ncur, t.gemm_nr, bp);
+                    gemm_block(t, a, bp, ap, c, k, m, pc, kcur, jc, ncur, 0, n);
+                }
+            }
+        }
+
+        /// struct gemm_job
+        /*! One product for the pool: count participants, participant p owning
+         *! rows [p * share, (p + 1) * share) of C
+         */
+        struct gemm_job {
+
+            const kernel_table* t;
+            const float* a;
+            const float* b;
+            float* c;
+            std::size_t n;
+            std::size_t k;
+            std::size_t m;
+            std::size_t count;
+            std::size_t share;
+        };
+
+        /// class gemm_pool
+        /*! Workers kept across products, woken per job. Each KC x NC block of
+         *! B is packed once into a shared panel, its slivers split between the
+         *! participants, then each multiplies its own rows against it with its
+         *! own A block; a barrier separates the two, and another keeps the
+         *! panel until everyone is done with it. Threads and packing space
+         *! grow to the largest job seen and are kept, so steady-state
+         *! products do not allocate
+         */
+        class gemm_pool {
+
+        public:
+
+            /// @return the process-wide pool
+            static gemm_pool& instance() {
+                static gemm_pool pool;
+                return pool;
+            }
+
+            ~gemm_pool() {
+
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    stop_ = true;
+                }
+
+                wake_.notify_all();
+                for (std::thread& w : workers_)
+                    w.join();
+            }
+
+            /// Runs job with the caller as participant 0
+            /// @return false, without running it, while another caller holds the pool
+            bool run(const gemm_job& job) {
+
+                std::unique_lock<std::mutex> busy(busy_, std::try_to_lock);
+                if (!busy.owns_lock()) {
+                    return false;
+                }
+
+                // The shared B panel, then one A block per participant
+                buffer_.reserve(PANEL + job.count * BLOCK);
+
+                while (workers_.size() + 1 < job.count) {
+                    workers_.emplace_back(&gemm_pool::serve, this, workers_.size() + 1, generation_);
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    job_ = job;
+                    ++generation_;
+                }
+
+                wake_.notify_all();
+                work(0);
+
+                return true;
+            }
+
+        private:
+
+            static const std::size_t PANEL = gemm_blocking::KC * gemm_blocking::NC;
+            static const std::size_t BLOCK = gemm_blocking::MC * gemm_blocking::KC;
+
+            gemm_pool() : job_(), generation_(0), arrived_(0), phase_(0), stop_(false) {}
+
+            /// Worker loop of participant p, which has seen generation seen
+            void serve(const std::size_t p, std::size_t seen) {
+
+                for (;;)
+                {
+                    std::unique_lock<std::mutex> lock(lock_);
+                    wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+
+                    if (stop_) {
+                        return;
+                    }
+
+                    seen = generation_;
+
+                    // Idle through jobs smaller than the pool
+                    const bool participant = p < job_.count;
+                    lock.unlock();
+
+                    if (participant) {
+                        work(p);
+                    }
+                }
+            }
+
+            /// Waits for every participant of the current job
+            void barrier() {
+
+                std::unique_lock<std::mutex> lock(lock_);
+                const std::size_t phase = phase_;
+
+                if (++arrived_ == job_.count)
+                {
+                    arrived_ = 0;
+                    ++phase_;
+                    resume_.notify_all();
+                }
+                else
+                {
+                    resume_.wait(lock, [&]() { return phase_ != phase; });
+                }
+            }
+
+            /// Participant p's part of the current job
+            void work(const std::size_t p) {
+
+                const kernel_table& t = *job_.t;
+                const std::size_t nr = t.gemm_nr;
+                const std::size_t nc = gemm_blocking::NC / nr * nr;
+                const std::size_t kc = gemm_blocking::KC;
+
+                float* bp = buffer_.data();
+                float* ap = bp + PANEL + p * BLOCK;
+
+                const std::size_t r0 = std::min(job_.n, p * job_.share);
+                const std::size_t r1 = std::min(job_.n, r0 + job_.share);
+
+                for (std::size_t jc = 0; jc < job_.m; jc += nc)
+                {
+                    const std::size_t ncur = std::min(nc, job_.m - jc);
+
+                    // Whole slivers of the panel per participant
+                    const std::size_t slivers = (ncur + nr - 1) / nr;
+                    const std::size_t cols = (slivers + job_.count - 1) / job_.count * nr;
+                    const std::size_t j0 = std::min(ncur, p * cols);
+                    const std::size_t j1 = std::min(ncur, j0 + cols);
+
+                    for (std::size_t pc = 0; pc < job_.k; pc += kc)
+                    {
+                        const std::size_t kcur = std::min(kc, job_.k - pc);
+
+                        gemm_pack_b(job_.b + pc * job_.m + jc + j0, job_.m, kcur, j1 - j0, nr, bp + j0 * kcur);
+                        barrier();
+
+                        gemm_block(t, job_.a, bp, ap, job_.c, job_.k, job_.m, pc, kcur, jc, ncur, r0, r1);
+                        barrier();
+                    }
+                }
+            }
+
+            std::mutex busy_;                 //> held by the caller of a running job
+            std::mutex lock_;                 //> guards what follows
+            std::condition_variable wake_;    //> a new job, or stop
+            std::condition_variable resume_;  //> a barrier phase completed
+
+            std::vector<std::thread> workers_;
+            gemm_buffer buffer_;
+
+            gemm_job job_;
+            std::size_t generation_;
+            std::size_t arrived_;
+            std::size_t phase_;
+            bool stop_;
+        };
+
+        /// C = A * B, A n x k, B k x m, all row-major and unpadded; c must not
+        /// alias a or b. Rows of C are split between up to threads threads
+        /// (0: one per core) of the shared pool, fewer when the product is too
+        /// small to share; serial while another thread is using the pool
+        inline void gemm_ps(const float* a,
+                            const float* b,
+                            float* c,
+                            const std::size_t n,
+                            const std::size_t k,
+                            const std::size_t m,
+                            unsigned threads = 0) {
+
+            if (k == 0)
+            {
+                std::fill(c, c + n * m, 0.0f);
+                return;
+            }
+
+            // Every worker uses the caller's backend
+            const kernel_table& t = kernels();
+
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            const std::size_t flops = 2 * n * k * m;
+            const std::size_t slivers = (n + t.gemm_mr - 1) / t.gemm_mr;
+
+            std::size_t count = std::min<std::size_t>(threads, flops / gemm_blocking::MIN_FLOPS);
+            count = std::max<std::size_t>(1, std::min(count, slivers));
+
+            // Whole slivers per participant, none left without rows
+            const std::size_t share = (slivers + count - 1) / count * t.gemm_mr;
+            count = (n + share - 1) / share;
+
+            if (count == 1 || !gemm_pool::instance().run(gemm_job{&t, a, b, c, n, k, m, count, share})) {
+                gemm_serial(t, a, b, c, n, k, m);
+            }
+        }
+    }
+}
+
+#endif
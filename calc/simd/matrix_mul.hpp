@@ -3,37 +3,26 @@
 #ifndef _CALC_SIMD_MATRIX_MUL_HPP
 #define _CALC_SIMD_MATRIX_MUL_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
 #include "common.hpp"
+#include "dispatch.hpp"
+#include "gemm.hpp"
 
 namespace calc {
 
-    namespace detail {
-
-        template <typename>
-        struct matrix_mul_impl;
-
-        template <>
-        struct matrix_mul_impl<float> {
-
-            static inline void mul(const __m128& r, const __m128& c, float* out) {
-
-                __m128 tmp;
-
-                tmp = _mm_mul_ps(r, c);
-                tmp = _mm_hadd_ps(tmp, tmp);
-                tmp = _mm_hadd_ps(tmp, tmp);
-
-                *out = tmp[0];
-            }
-        };
-    }
-
     template <typename,
               unsigned,
               unsigned,
               unsigned>
     struct matrix_mul;
 
+    /*! Dynamic matrix x vector product
+     *! (N0 x N1) x (N1 x 1), row-major; the vector is staged zero-padded in
+     *! thread-local scratch, so no allocation happens after the first call
+     */
     template <>
     struct matrix_mul<float, 0, 0, 1> {
 
@@ -43,55 +32,57 @@ namespace calc {
                                const std::size_t N0,
                                const std::size_t N1) {
 
-            std::size_t registers0 = N1 / (16 / sizeof(float));
-            std::size_t registers1 = 16 / sizeof(float);
-
-            __m128* lhs = new __m128[N0 * registers0];
-            __m128* rhs = new __m128[N1 * registers1];
-
-            for (std::size_t i = 0; i != N1 * registers1; ++i)
-            {
-                std::size_t ii = i * sizeof(float);
-                rhs[i] = detail::load(dat2 + ii);
-            }
+            const std::size_t registers = (N1 + 3) / 4;
+            const std::size_t tail = N1 % 4;
 
-            for (std::size_t i = 0; i != N0 * registers0; ++i)
-            {
-                std::size_t ii = i * sizeof(float);
-                lhs[i] = detail::load(dat1 + ii);
+            // Stage RHS; out may alias it
+            float* rhs = detail::scratch(registers * 4);
+            for (std::size_t i = 0; i != registers * 4; ++i) {
+                rhs[i] = (i < N1) ? dat2[i] : 0;
             }
 
             for (std::size_t i = 0; i != N0; ++i)
             {
-                std::size_t ii =  i * registers0;
-                std::size_t  j = 0;
-                for ( ; j != N1; ++j)
+                const float* row = dat1 + i * N1;
+
+                __m128 sum = { 0, 0, 0, 0 };
+
+                std::size_t k = 0;
+                for ( ; k != N1 - tail; k += 4)
                 {
-                    __m128 sum = { 0, 0, 0, 0 };
+                    __m128 tmp;
+                    tmp = _mm_mul_ps(_mm_loadu_ps(row + k), detail::load(rhs + k));
+                    sum = _mm_add_ps(tmp, sum);
+                }
 
-                    std::size_t jj = j * registers1;
-                    std::size_t  k = 0;
-                    for ( ; k != registers1; ++k)
-                    {
-                        __m128 tmp;
-                        tmp = _mm_mul_ps(lhs[ii + k], rhs[jj + k]);
-                        sum = _mm_add_ps(tmp, sum);
-                    }
+                if (tail != 0)
+                {
+                    float last[4] __attribute__((aligned(16))) = { 0, 0, 0, 0 };
+                    for (std::size_t t = 0; t != tail; ++t)
+                        last[t] = row[k + t];
 
-                    sum = _mm_hadd_ps(sum ,sum);
-                    sum = _mm_hadd_ps(sum ,sum);
-                    *out++ = sum[0];
+                    __m128 tmp;
+                    tmp = _mm_mul_ps(detail::load(last), detail::load(rhs + k));
+                    sum = _mm_add_ps(tmp, sum);
                 }
-            }
 
-            delete[] lhs;
-            delete[] rhs;
+                sum = _mm_hadd_ps(sum ,sum);
+                sum = _mm_hadd_ps(sum ,sum);
+                out[i] = _mm_cvtss_f32(sum);
+            }
         }
     };
 
+    /*! Dynamic matrix product
+     *! (N0 x N1) x (N1 x M1), row-major; out may alias either operand.
+     *! From GEMM_MIN_SIZE multiply-adds on, the packed, cache-blocked and
+     *! multithreaded detail::gemm_ps; below it a dot product per element
+     */
     template <>
     struct matrix_mul<float, 0, 0, 0> {
 
+        static const std::size_t GEMM_MIN_SIZE = 32 * 32 * 32;
+
         static inline void mul(const float* dat1,
                                const float* dat2,
                                float* out,
@@ -99,198 +90,336 @@ namespace calc {
                                const std::size_t N1,
                                const std::size_t M1) {
 
+            if (N0 * N1 * M1 < GEMM_MIN_SIZE) {
+                mul_dot(dat1, dat2, out, N0, N1, M1);
+                return;
+            }
 
-            std::size_t registers0 = N1 / (16 / sizeof(float));
-            std::size_t registers1 = M1 / (16 / sizeof(float));
+            if (out != dat1 && out != dat2) {
+                detail::gemm_ps(dat1, dat2, out, N0, N1, M1);
+                return;
+            }
 
-            __m128* lhs  = new __m128[N0 * registers0];
-            __m128* rhs  = new __m128[N1 * registers1];
-            __m128* rhsfloat = new __m128[N1 * registers1];
+            float* tmp = detail::scratch(N0 * M1);
+            detail::gemm_ps(dat1, dat2, tmp, N0, N1, M1);
+            std::copy(tmp, tmp + N0 * M1, out);
+        }
 
-            // floatranspose
-            for (std::size_t i = 0; i != N1 * registers1; ++i)
-            {
-                std::size_t ii = i * sizeof(float);
-                rhs[i] = detail::load(dat2 + ii);
-            }
+        /// Dot product formulation: RHS columns and the current LHS row are
+        /// staged zero-padded in thread-local scratch, so no allocation happens
+        /// after the first call and out may alias either operand
+        static inline void mul_dot(const float* dat1,
+                                   const float* dat2,
+                                   float* out,
+                                   const std::size_t N0,
+                                   const std::size_t N1,
+                                   const std::size_t M1) {
 
-            for (std::size_t i = 0; i != N1; i += __stride__(sizeof(float)))
-            {
-                std::size_t ii1 =  i      * registers1;
-                std::size_t ii2 = (i + 1) * registers1;
-                std::size_t ii3 = (i + 2) * registers1;
-                std::size_t ii4 = (i + 3) * registers1;
+            const std::size_t registers = (N1 + 3) / 4;
+            const std::size_t stride = registers * 4;
 
-                for (std::size_t j = 0; j != registers1; ++j)
-                {
-                    std::size_t jj0 = ii1 + j;
-                    std::size_t jj1 = ii2 + j;
-                    std::size_t jj2 = ii3 + j;
-                    std::size_t jj3 = ii4 + j;
-
-                    __m128 y0 = _mm_unpacklo_ps(rhs[jj0], rhs[jj1]);
-                    __m128 y1 = _mm_unpackhi_ps(rhs[jj0], rhs[jj1]);
-                    __m128 y2 = _mm_unpacklo_ps(rhs[jj2], rhs[jj3]);
-                    __m128 y3 = _mm_unpackhi_ps(rhs[jj2], rhs[jj3]);
-
-                    rhsfloat[ii1] = _mm_movelh_ps(y0, y2);
-                    rhsfloat[ii2] = _mm_movehl_ps(y2, y0);
-                    rhsfloat[ii3] = _mm_movelh_ps(y1, y3);
-                    rhsfloat[ii4] = _mm_movehl_ps(y3, y1);
-                }
-            }
+            // Transposed RHS, one padded column per row, followed by one LHS row
+            float* rhs = detail::scratch((M1 + 1) * stride);
+            float* lhs = rhs + M1 * stride;
 
-            // Multiply
-            for (std::size_t i = 0; i != N0 * registers0; ++i)
+            for (std::size_t j = 0; j != M1; ++j)
             {
-                const std::size_t index = i * sizeof(float);
+                float* col = rhs + j * stride;
 
-                const float* dat = dat1 + index;
-                lhs[i] = _mm_load_ps(dat);
+                std::size_t k = 0;
+                for ( ; k != N1; ++k)
+                    col[k] = dat2[k * M1 + j];
+                for ( ; k != stride; ++k)
+                    col[k] = 0;
             }
 
             for (std::size_t i = 0; i != N0; ++i)
             {
-                std::size_t ii =  i * registers0;
-                std::size_t  j = 0;
-                for ( ; j != N1; ++j)
+                std::size_t k = 0;
+                for ( ; k != N1; ++k)
+                    lhs[k] = dat1[i * N1 + k];
+                for ( ; k != stride; ++k)
+                    lhs[k] = 0;
+
+                for (std::size_t j = 0; j != M1; ++j)
                 {
-                    __m128 sum = { 0, 0, 0, 0 };
+                    const float* col = rhs + j * stride;
 
-                    std::size_t jj = j * registers1;
-                    std::size_t  k = 0;
-                    for ( ; k != registers1; ++k)
+                    __m128 sum = { 0, 0, 0, 0 };
+                    for (k = 0; k != stride; k += 4)
                     {
                         __m128 tmp;
-                        tmp = _mm_mul_ps(lhs[ii + k], rhsfloat[jj + k]);
+                        tmp = _mm_mul_ps(detail::load(lhs + k), detail::load(col + k));
                         sum = _mm_add_ps(tmp, sum);
                     }
 
                     sum = _mm_hadd_ps(sum ,sum);
                     sum = _mm_hadd_ps(sum ,sum);
-                    *out++ = sum[0];
+                    out[i * M1 + j] = _mm_cvtss_f32(sum);
                 }
             }
-
-            delete[] lhs;
-            delete[] rhs;
-            delete[] rhsfloat;
         }
     };
 
-    template <>
-    struct matrix_mul<float, 4, 4, 1> {
+    namespace detail {
+
+        /// struct small_mul
+        /*! Fixed-shape product (N x M) x (M x M1) for N, M, M1 <= 8, unrolled at
+         *! compile time and kept in registers: output row i is the sum over k of
+         *! lhs(i, k) broadcast times RHS row k, R = ceil(M1 / 4) registers wide.
+         *! Partial RHS rows are loaded zero-extended, so the spare lanes of each
+         *! output row are zero; rows are stored in order, a whole register
+         *! spilling into the next row before that row is written, and any
+         *! register reaching past N * M1 is cut to size. Every row is computed
+         *! before the first store: out may alias either operand.
+         */
+        template <unsigned N,
+                  unsigned M,
+                  unsigned M1>
+        struct small_mul {
+
+            static const unsigned R = (M1 + 3) / 4;
+            static const unsigned TAIL = M1 - 4 * (R - 1);
+
+            /// @return register r of RHS row k
+            static inline __m128 rhs(const float* dat2, const unsigned k, const unsigned r) {
+
+                const float* p = dat2 + k * M1 + r * 4;
+                if (M1 % 4 == 0) {
+                    return _mm_load_ps(p);
+                }
+
+                return (r + 1 == R) ? load_partial<TAIL>(p) : _mm_loadu_ps(p);
+            }
+
+            static inline void mul(const float* dat1, const float* dat2, float* out) {
+
+                __m128 acc[N][R];
+
+#pragma GCC unroll 8
+                for (unsigned i = 0; i != N; ++i)
+                {
+#pragma GCC unroll 2
+                    for (unsigned r = 0; r != R; ++r)
+                    {
+                        __m128 sum = _mm_mul_ps(_mm_set1_ps(dat1[i * M]), rhs(dat2, 0, r));
+#pragma GCC unroll 8
+                        for (unsigned k = 1; k != M; ++k)
+                            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(dat1[i * M + k]), rhs(dat2, k, r)));
+                        acc[i][r] = sum;
+                    }
+                }
+
+#pragma GCC unroll 8
+                for (unsigned i = 0; i != N; ++i)
+                {
+#pragma GCC unroll 2
+                    for (unsigned r = 0; r != R; ++r)
+                    {
+                        const unsigned offset = i * M1 + r * 4;
+                        if (M1 % 4 == 0)
+                            _mm_store_ps(out + offset, acc[i][r]);
+                        else
+                            store_partial(out + offset, acc[i][r], std::min(4u, N * M1 - offset));
+                    }
+                }
+            }
+        };
+
+        /// struct small_mul
+        /*! Fixed-shape matrix x vector product for N, M <= 8: out[i] is the dot
+         *! product of LHS row i with the vector, four rows reduced at once. The
+         *! vector's zero padding fills the spare lanes of its last register;
+         *! partial LHS rows are loaded zero-extended. Out may alias either operand.
+         */
+        template <unsigned N,
+                  unsigned M>
+        struct small_mul<N, M, 1> {
+
+            static const unsigned R = (M + 3) / 4;
+            static const unsigned Q = (N + 3) / 4;
+
+            /// @return products of LHS row i with the vector, summed over registers
+            static inline __m128 row(const float* dat1, const float* dat2, const unsigned i) {
+
+                __m128 sum = _mm_setzero_ps();
+#pragma GCC unroll 2
+                for (unsigned r = 0; r != R; ++r)
+                {
+                    const float* p = dat1 + i * M + r * 4;
+                    const __m128 x = (M % 4 != 0 && r + 1 == R) ? load_partial<M % 4>(p) : _mm_loadu_ps(p);
+                    sum = _mm_add_ps(sum, _mm_mul_ps(x, _mm_load_ps(dat2 + r * 4)));
+                }
+
+                return sum;
+            }
+
+            static inline void mul(const float* dat1, const float* dat2, float* out) {
+
+                __m128 acc[Q];
+
+#pragma GCC unroll 2
+                for (unsigned q = 0; q != Q; ++q)
+                {
+                    const unsigned i = q * 4;
+                    acc[q] = sse4_kernels::hsum4(row(dat1, dat2, i),
+                                                 (i + 1 < N) ? row(dat1, dat2, i + 1) : _mm_setzero_ps(),
+                                                 (i + 2 < N) ? row(dat1, dat2, i + 2) : _mm_setzero_ps(),
+                                                 (i + 3 < N) ? row(dat1, dat2, i + 3) : _mm_setzero_ps());
+                }
+
+                // Rows past N reduce to zero and land in the padding
+#pragma GCC unroll 2
+                for (unsigned q = 0; q != Q; ++q)
+                    _mm_store_ps(out + q * 4, acc[q]);
+            }
+        };
+    }
+
+    /*! Any other float shape: unrolled up to 8 x 8 x 8, dynamic beyond
+     */
+    template <unsigned N,
+              unsigned M,
+              unsigned M1>
+    struct matrix_mul<float, N, M, M1> {
 
         static inline void mul(const float* dat1, const float* dat2, float* out) {
+            mul(dat1, dat2, out, std::integral_constant<bool, (N <= 8 && M <= 8 && M1 <= 8)>());
+        }
 
-            const __m128 c0 = _mm_load_ps(dat2);
+    private:
 
-            const __m128 r0 = _mm_load_ps(dat1);
-            const __m128 r1 = _mm_load_ps(dat1 +  4);
-            const __m128 r2 = _mm_load_ps(dat1 +  8);
-            const __m128 r3 = _mm_load_ps(dat1 + 12);
+        static inline void mul(const float* dat1, const float* dat2, float* out, std::true_type) {
+            detail::small_mul<N, M, M1>::mul(dat1, dat2, out);
+        }
 
-            detail::matrix_mul_impl<float>::mul(r0, c0, out);
-            detail::matrix_mul_impl<float>::mul(r1, c0, out + 1);
-            detail::matrix_mul_impl<float>::mul(r2, c0, out + 2);
-            detail::matrix_mul_impl<float>::mul(r3, c0, out + 3);
+        static inline void mul(const float* dat1, const float* dat2, float* out, std::false_type) {
+            matrix_mul<float, 0, 0, 0>::mul(dat1, dat2, out, N, M, M1);
         }
     };
 
-    template <>
-    struct matrix_mul<float, 3, 3, 1> {
+    /*! Any other float matrix x vector shape: unrolled up to 8 x 8, dynamic beyond
+     */
+    template <unsigned N,
+              unsigned M>
+    struct matrix_mul<float, N, M, 1> {
 
         static inline void mul(const float* dat1, const float* dat2, float* out) {
+            mul(dat1, dat2, out, std::integral_constant<bool, (N <= 8 && M <= 8)>());
+        }
 
-            const __m128 c0 = _mm_loadu_ps(dat2);
+    private:
 
-            const __m128 r0 = _mm_loadu_ps(dat1);
-            const __m128 r1 = _mm_loadu_ps(dat1 + 3);
-            const __m128 r2 = _mm_loadu_ps(dat1 + 6);
+        static inline void mul(const float* dat1, const float* dat2, float* out, std::true_type) {
+            detail::small_mul<N, M, 1>::mul(dat1, dat2, out);
+        }
 
-            detail::matrix_mul_impl<float>::mul(r0, c0, out);
-            detail::matrix_mul_impl<float>::mul(r1, c0, out + 1);
-            detail::matrix_mul_impl<float>::mul(r2, c0, out + 2);
+        static inline void mul(const float* dat1, const float* dat2, float* out, std::false_type) {
+            matrix_mul<float, 0, 0, 1>::mul(dat1, dat2, out, N, M);
         }
     };
 
+    /*! Dynamic double matrix product
+     *! (N0 x N1) x (N1 x M1), row-major; when out aliases an operand the
+     *! result is staged in thread-local scratch
+     */
     template <>
-    struct matrix_mul<float, 4, 4, 4> {
+    struct matrix_mul<double, 0, 0, 0> {
 
-        static inline void mul(const float* dat1, const float* dat2, float* out) {
+        static inline void mul(const double* dat1,
+                               const double* dat2,
+                               double* out,
+                               const std::size_t N0,
+                               const std::size_t N1,
+                               const std::size_t M1) {
+
+            if (out != dat1 && out != dat2) {
+                detail::kernels().gemm_pd(dat1, dat2, out, N0, N1, M1);
+                return;
+            }
 
-            // detail::load & transpose RHS matrix
-            const __m128 x0 = detail::load(dat2);
-            const __m128 x1 = detail::load(dat2 +  4);
-            const __m128 x2 = detail::load(dat2 +  8);
-            const __m128 x3 = detail::load(dat2 + 12);
-
-            const __m128 y0 = _mm_unpacklo_ps(x0, x1);
-            const __m128 y1 = _mm_unpackhi_ps(x0, x1);
-            const __m128 y2 = _mm_unpacklo_ps(x2, x3);
-            const __m128 y3 = _mm_unpackhi_ps(x2, x3);
-
-            const __m128 c0 = _mm_movelh_ps(y0, y2);
-            const __m128 c1 = _mm_movehl_ps(y2, y0);
-            const __m128 c2 = _mm_movelh_ps(y1, y3);
-            const __m128 c3 = _mm_movehl_ps(y3, y1);
-
-            // detail::load LHS matrix
-            const __m128 r0 = detail::load(dat1);
-            const __m128 r1 = detail::load(dat1 +  4);
-            const __m128 r2 = detail::load(dat1 +  8);
-            const __m128 r3 = detail::load(dat1 + 12);
-
-            detail::matrix_mul_impl<float>::mul(r0, c0, out);
-            detail::matrix_mul_impl<float>::mul(r0, c1, out +  1);
-            detail::matrix_mul_impl<float>::mul(r0, c2, out +  2);
-            detail::matrix_mul_impl<float>::mul(r0, c3, out +  3);
-
-            detail::matrix_mul_impl<float>::mul(r1, c0, out +  4);
-            detail::matrix_mul_impl<float>::mul(r1, c1, out +  5);
-            detail::matrix_mul_impl<float>::mul(r1, c2, out +  6);
-            detail::matrix_mul_impl<float>::mul(r1, c3, out +  7);
-
-            detail::matrix_mul_impl<float>::mul(r2, c0, out +  8);
-            detail::matrix_mul_impl<float>::mul(r2, c1, out +  9);
-            detail::matrix_mul_impl<float>::mul(r2, c2, out + 10);
-            detail::matrix_mul_impl<float>::mul(r2, c3, out + 11);
-
-            detail::matrix_mul_impl<float>::mul(r3, c0, out + 12);
-            detail::matrix_mul_impl<float>::mul(r3, c1, out + 13);
-            detail::matrix_mul_impl<float>::mul(r3, c2, out + 14);
-            detail::matrix_mul_impl<float>::mul(r3, c3, out + 15);
+            double* tmp = reinterpret_cast<double*>(detail::scratch(2 * N0 * M1));
+            detail::kernels().gemm_pd(dat1, dat2, tmp, N0, N1, M1);
+            std::copy(tmp, tmp + N0 * M1, out);
         }
     };
 
+    /*! Dynamic double matrix x vector product
+     *! (N0 x N1) x (N1 x 1), row-major; when out aliases an operand the
+     *! result is staged in thread-local scratch
+     */
     template <>
-    struct matrix_mul<float, 3, 3, 3> {
+    struct matrix_mul<double, 0, 0, 1> {
+
+        static inline void mul(const double* dat1,
+                               const double* dat2,
+                               double* out,
+                               const std::size_t N0,
+                               const std::size_t N1) {
+
+            if (out != dat1 && out != dat2) {
+                detail::kernels().gemv_pd(dat1, dat2, out, N0, N1);
+                return;
+            }
+
+            double* tmp = reinterpret_cast<double*>(detail::scratch(2 * N0));
+            detail::kernels().gemv_pd(dat1, dat2, tmp, N0, N1);
+            std::copy(tmp, tmp + N0, out);
+        }
+    };
+
+    /*! Any double shape
+     */
+    template <unsigned N,
+              unsigned M,
+              unsigned M1>
+    struct matrix_mul<double, N, M, M1> {
+
+        static inline void mul(const double* dat1, const double* dat2, double* out) {
+            matrix_mul<double, 0, 0, 0>::mul(dat1, dat2, out, N, M, M1);
+        }
+    };
+
+    /*! Any double matrix x vector shape
+     */
+    template <unsigned N,
+              unsigned M>
+    struct matrix_mul<double, N, M, 1> {
+
+        static inline void mul(const double* dat1, const double* dat2, double* out) {
+            matrix_mul<double, 0, 0, 1>::mul(dat1, dat2, out, N, M);
+        }
+    };
+
+    template <>
+    struct matrix_mul<float, 4, 4, 1> {
 
         static inline void mul(const float* dat1, const float* dat2, float* out) {
+            detail::kernels().mul_4x4x1(dat1, dat2, out);
+        }
+    };
 
-            const float datc0[4] __attribute__((aligned(16))) = { dat2[0], dat2[3], dat2[6], 0 };
-            const float datc1[4] __attribute__((aligned(16))) = { dat2[1], dat2[4], dat2[7], 0 };
-            const float datc2[4] __attribute__((aligned(16))) = { dat2[2], dat2[5], dat2[8], 0 };
+    template <>
+    struct matrix_mul<float, 3, 3, 1> {
 
-            const __m128 c0 = detail::load(datc0);
-            const __m128 c1 = detail::load(datc1);
-            const __m128 c2 = detail::load(datc2);
+        static inline void mul(const float* dat1, const float* dat2, float* out) {
+            detail::kernels().mul_3x3x1(dat1, dat2, out);
+        }
+    };
 
-            __m128 r0 = _mm_loadu_ps(dat1);
-            __m128 r1 = _mm_loadu_ps(dat1 + 3);
-            __m128 r2 = _mm_loadu_ps(dat1 + 6);
+    template <>
+    struct matrix_mul<float, 4, 4, 4> {
 
-            detail::matrix_mul_impl<float>::mul(r0, c0, out);
-            detail::matrix_mul_impl<float>::mul(r0, c1, out + 1);
-            detail::matrix_mul_impl<float>::mul(r0, c2, out + 2);
+        static inline void mul(const float* dat1, const float* dat2, float* out) {
+            detail::kernels().mul_4x4x4(dat1, dat2, out);
+        }
+    };
 
-            detail::matrix_mul_impl<float>::mul(r1, c0, out + 3);
-            detail::matrix_mul_impl<float>::mul(r1, c1, out + 4);
-            detail::matrix_mul_impl<float>::mul(r1, c2, out + 5);
+    template <>
+    struct matrix_mul<float, 3, 3, 3> {
 
-            detail::matrix_mul_impl<float>::mul(r2, c0, out + 6);
-            detail::matrix_mul_impl<float>::mul(r2, c1, out + 7);
-            detail::matrix_mul_impl<float>::mul(r2, c2, out + 8);
+        static inline void mul(const float* dat1, const float* dat2, float* out) {
+            detail::kernels().mul_3x3x3(dat1, dat2, out);
         }
     };
 }
@@ -1,5 +1,12 @@
 #include "camera.hpp"
 
+namespace {
+
+    // Default viewer basis
+    constexpr calc::vec3f Y_AXIS(0, 1, 0);
+    constexpr calc::vec3f Z_AXIS(0, 0, 1);
+}
+
 Camera::vector_pair::vector_pair(const calc::vec3f& value) : value(value)
                                                            , defaultValue(value) {}
 
@@ -12,29 +19,23 @@ Camera::Camera(const calc::vec3f& eye,
                unsigned screenWidth,
                unsigned screenHeight) : screenWidth_(screenWidth)
                                       , screenHeight_(screenHeight)
+                                      , viewRotation_(calc::quatf::identity())
+                                      , viewerRotation_(calc::quatf::identity())
                                       , fov_(fov, znear, zfar)
                                       , E_(eye)
-                                      , F_(calc::vec3f(0, 0, 1))
-                                      , U_(calc::vec3f(0, 1, 0)) {
+                                      , F_(Z_AXIS)
+                                      , U_(Y_AXIS) {
     update();
 }
 
 void Camera::move(const calc::vec3f& direction)
 {
-    const calc::mat3f rot = calc::rotate_3x(calc::radians(viewerOrientation_.pitch))
-        * calc::rotate_3y(calc::radians(viewerOrientation_.yaw))
-        * calc::rotate_3z(calc::radians(viewerOrientation_.roll));
-
-    E_.value -= rot * direction;
+    E_.value -= calc::rotate(viewerRotation_, direction);
 }
 
 void Camera::set_position(const calc::vec3f& direction)
 {
-    const calc::mat3f rot = calc::rotate_3x(calc::radians(viewerOrientation_.pitch))
-        * calc::rotate_3y(calc::radians(viewerOrientation_.yaw))
-        * calc::rotate_3z(calc::radians(viewerOrientation_.roll));
-
-    E_.value = rot * direction;
+    E_.value = calc::rotate(viewerRotation_, direction);
 }
 
 void Camera::reset()
@@ -42,6 +43,9 @@ void Camera::reset()
     viewOrientation_ = orientation();
     viewerOrientation_ = orientation();
 
+    viewRotation_ = calc::quatf::identity();
+    viewerRotation_ = calc::quatf::identity();
+
     (E_.value) = (E_.defaultValue);
     (F_.value) = (F_.defaultValue);
     (U_.value) = (U_.defaultValue);
@@ -58,6 +62,8 @@ void Camera::set_scene_rotation(const float pitch, const float yaw, const float
     viewOrientation_.pitch = pitch;
     viewOrientation_.yaw = yaw;
     viewOrientation_.roll = roll;
+
+    viewRotation_ = calc::quatf::from_euler(calc::radians(pitch), calc::radians(yaw), calc::radians(roll));
 }
 
 void Camera::rotate_viewer(const float pitch, const float yaw, const float roll)
@@ -66,12 +72,15 @@ void Camera::rotate_viewer(const float pitch, const float yaw, const float roll)
     viewerOrientation_.yaw += yaw;
     viewerOrientation_.roll += roll;
 
-    const calc::mat3f rot = calc::rotate_3z(calc::radians(viewerOrientation_.roll))
-        * calc::rotate_3y(calc::radians(viewerOrientation_.yaw))
-        * calc::rotate_3x(calc::radians(viewerOrientation_.pitch));
+    viewerRotation_ = calc::quatf::from_euler(calc::radians(viewerOrientation_.pitch),
+                                              calc::radians(viewerOrientation_.yaw),
+                                              calc::radians(viewerOrientation_.roll));
+
+    // Up and forward turn with the viewer, as move() does: one conversion
+    const calc::affine3f rot = calc::to_affine(viewerRotation_);
 
-    U_.value = rot * U_.defaultValue;
-    F_.value = rot * F_.defaultValue;
+    U_.value = calc::transform_vector(rot, U_.defaultValue);
+    F_.value = calc::transform_vector(rot, F_.defaultValue);
 }
 
 void Camera::calc_look_at()
@@ -101,10 +110,7 @@ void Camera::calc_look_at()
     lookAt(1, 3) = -calc::dot(u, E_.value);
     lookAt(2, 3) =  calc::dot(f, E_.value);
 
-    lookAt_.value = lookAt
-        * calc::rotate_4x(calc::radians(viewOrientation_.pitch))
-        * calc::rotate_4y(calc::radians(viewOrientation_.yaw))
-        * calc::rotate_4z(calc::radians(viewOrientation_.roll));
+    lookAt_.value = lookAt * calc::to_mat4(viewRotation_);
     lookAt_.deviceValue = calc::transpose(lookAt_.value);
 }
 
@@ -129,97 +135,14 @@ void Camera::calc_projection()
 namespace {
 
     // Helper
-    // Hadamard product
-    /* TODO: move this */
-    inline calc::vec4f operator*(const calc::vec4f& v1, const calc::vec4f& v2)
-    {
-        float a = v1[0] * v2[0];
-        float b = v1[1] * v2[1];
-        float c = v1[2] * v2[2];
-        float d = v1[3] * v2[3];
-
-        return calc::vec4f(a, b, c, d);
-    }
-
-    // Helper
-    // @param m matrix
-    // @return inverse of m
-    calc::mat4f inverse(const calc::mat4f& m)
-    {
-        float coef00 = m(2, 2) * m(3, 3) - m(2, 3) * m(3, 2);
-        float coef02 = m(2, 1) * m(3, 3) - m(2, 3) * m(3, 1);
-        float coef03 = m(2, 1) * m(3, 2) - m(2, 2) * m(3, 1);
-
-        float coef04 = m(1, 2) * m(3, 3) - m(1, 3) * m(3, 2);
-        float coef06 = m(1, 1) * m(3, 3) - m(1, 3) * m(3, 1);
-        float coef07 = m(1, 1) * m(3, 2) - m(1, 2) * m(3, 1);
-
-        float coef08 = m(1, 2) * m(2, 3) - m(1, 3) * m(2, 2);
-        float coef10 = m(1, 1) * m(2, 3) - m(1, 3) * m(2, 1);
-        float coef11 = m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1);
-
-        float coef12 = m(0, 2) * m(3, 3) - m(0, 3) * m(3, 2);
-        float coef14 = m(0, 1) * m(3, 3) - m(0, 3) * m(3, 1);
-        float coef15 = m(0, 1) * m(3, 2) - m(0, 2) * m(3, 1);
-
-        float coef16 = m(0, 2) * m(2, 3) - m(0, 3) * m(2, 2);
-        float coef18 = m(0, 1) * m(2, 3) - m(0, 3) * m(2, 1);
-        float coef19 = m(0, 1) * m(2, 2) - m(0, 2) * m(2, 1);
-
-        float coef20 = m(0, 2) * m(1, 3) - m(0, 3) * m(1, 2);
-        float coef22 = m(0, 1) * m(1, 3) - m(0, 3) * m(1, 1);
-        float coef23 = m(0, 1) * m(1, 2) - m(0, 2) * m(1, 1);
-
-        calc::vec4f fac0(coef00, coef00, coef02, coef03);
-        calc::vec4f fac1(coef04, coef04, coef06, coef07);
-        calc::vec4f fac2(coef08, coef08, coef10, coef11);
-        calc::vec4f fac3(coef12, coef12, coef14, coef15);
-        calc::vec4f fac4(coef16, coef16, coef18, coef19);
-        calc::vec4f fac5(coef20, coef20, coef22, coef23);
-
-        calc::vec4f vec0(m(0, 1), m(0, 0), m(0, 0), m(0, 0));
-        calc::vec4f vec1(m(1, 1), m(1, 0), m(1, 0), m(1, 0));
-        calc::vec4f vec2(m(2, 1), m(2, 0), m(2, 0), m(2, 0));
-        calc::vec4f vec3(m(3, 1), m(3, 0), m(3, 0), m(3, 0));
-
-        calc::vec4f inv0(vec1 * fac0 - vec2 * fac1 + vec3 * fac2);
-        calc::vec4f inv1(vec0 * fac0 - vec2 * fac3 + vec3 * fac4);
-        calc::vec4f inv2(vec0 * fac1 - vec1 * fac3 + vec3 * fac5);
-        calc::vec4f inv3(vec0 * fac2 - vec1 * fac4 + vec2 * fac5);
-
-        calc::vec4f signA(+1, -1, +1, -1);
-        calc::vec4f signB(-1, +1, -1, +1);
-
-        const calc::vec4f is0 = inv0 * signA;
-        const calc::vec4f is1 = inv1 * signB;
-        const calc::vec4f is2 = inv2 * signA;
-        const calc::vec4f is3 = inv3 * signB;
-
-        const calc::mat4f inverseMat(is0[0], is1[0], is2[0], is3[0],
-                                     is0[1], is1[1], is2[1], is3[1],
-                                     is0[2], is1[2], is2[2], is3[2],
-                                     is0[3], is1[3], is2[3], is3[3]);
-
-        const calc::vec4f row0(inverseMat(0, 0), inverseMat(0, 1), inverseMat(0, 2), inverseMat(0, 3));
-
-        const calc::vec4f dot0(calc::vec4f(m(0,0), m(0,1), m(0, 2), m(0, 3)) * row0);
-
-        float dot1 = (dot0[0] + dot0[1]) + (dot0[2] + dot0[3]);
-        float oneOverDeterminant = 1.0 / dot1;
-
-        return inverseMat * oneOverDeterminant;
-    }
-
-    // Helper
-    ray unproject_impl(float x, float y, float screenWidth, float screenHeight, const calc::mat4f& scene)
+    // @param inv inverse of the projection x view matrix
+    ray unproject_impl(float x, float y, float screenWidth, float screenHeight, const calc::mat4f& inv)
     {
         y = screenHeight - y - 1;
 
         x = 2 * x / screenWidth - 1;
         y = 2 * y / screenHeight - 1;
 
-        const calc::mat4f inv = inverse(scene);
-
         ray r;
         r.x = x;
         r.y = y;
@@ -240,14 +163,13 @@ namespace {
 
 ray Camera::unproject(float x, float y) const
 {
-    const calc::mat4f& scene = scene_.value;
-    return unproject_impl(x, y, screenWidth_, screenHeight_, scene);
+    return unproject_impl(x, y, screenWidth_, screenHeight_, sceneInverse_);
 }
 
 ray Camera::unproject(float x, float y, const calc::mat4f& lookAt, const calc::mat4f& projection) const {
 
     const calc::mat4f scene = projection * lookAt;
-    return unproject_impl(x, y, screenWidth_, screenHeight_, scene);
+    return unproject_impl(x, y, screenWidth_, screenHeight_, calc::inverse(scene));
 }
 
 void Camera::update()
@@ -255,8 +177,11 @@ void Camera::update()
     calc_look_at();
     calc_projection();
 
-    scene_.value = projection_.value * lookAt_.value;
+    calc::assign(scene_.value, calc::lazy(projection_.value) * lookAt_.value);
     scene_.deviceValue = calc::transpose(scene_.value);
+
+    // The view matrix is rigid: its inverse is a transpose
+    sceneInverse_ = calc::inverse_rigid(lookAt_.value) * calc::inverse(projection_.value);
 }
 
 float Camera::get_screen_width() const {
@@ -276,7 +201,7 @@ const calc::mat4f& Camera::get_scene() const {
 }
 
 const calc::mat4f& Camera::get_device_scene() const {
-    return scene_.value;
+    return scene_.deviceValue;
 }
 
 const calc::mat4f& Camera::get_look_at() const {
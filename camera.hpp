@@ -100,6 +100,9 @@ private:
     orientation viewOrientation_; //> Current 3d orientation of scene
     orientation viewerOrientation_; //> Current 3d orientation of first-person viewer
 
+    calc::quatf viewRotation_; //> viewOrientation_ as a single rotation
+    calc::quatf viewerRotation_; //> viewerOrientation_ as a single rotation
+
     //! struct fov
     /*! Field of view
      */
@@ -133,6 +136,7 @@ private:
     matrix_pair lookAt_; //> View matrix
     matrix_pair projection_; //> Perspective projection matrix
     matrix_pair scene_; //> Perspective x view
+    calc::mat4f sceneInverse_; //> Inverse of scene_, for unproject
 };
 
 #endif
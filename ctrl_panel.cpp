@@ -8,6 +8,7 @@
 #include "ball_data.hpp"
 #include "camera.hpp"
 #include "ctrl_panel.hpp"
+#include "render_queue.hpp"
 
 /*! ctor.
  */
@@ -30,7 +31,11 @@ CtrlPanel::CtrlPanel(SDL_Window* window) : window(window)
 
 /*! Renders all ctrl panel
  */
-void CtrlPanel::render(BallData& refballData, Camera& refcamera, unsigned* skinHandles, unsigned skinHandlesCount)
+void CtrlPanel::render(BallData& refballData,
+                       Camera& refcamera,
+                       unsigned* skinHandles,
+                       unsigned skinHandlesCount,
+                       const render::render_stats& stats)
 {
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
@@ -60,6 +65,12 @@ void CtrlPanel::render(BallData& refballData, Camera& refcamera, unsigned* skinH
     // Scene...
     render_scene_subpanel(refcamera);
 
+    ImGui::Separator();
+    ImGui::Dummy(ImVec2(0, 30));
+
+    // Render statistics...
+    render_stats_subpanel(stats);
+
     ImGui::End();
 
     // Render imgui
@@ -235,3 +246,17 @@ bool CtrlPanel::render_scene_position_subpanel(Camera& refcamera)
     else
         return false; // Nothing to do
 }
+
+/*! Renders subpanel
+ */
+void CtrlPanel::render_stats_subpanel(const render::render_stats& stats)
+{
+    ImGui::Text("Render Statistics");
+    ImGui::Separator();
+
+    // State changes of the last frame, and those the render queue saved
+    ImGui::Text("Draw packets: %u", stats.packets);
+    ImGui::Text("Program binds: %u (%u saved)", stats.programBinds, stats.programBindsSaved);
+    ImGui::Text("Vertex array binds: %u (%u saved)", stats.arrayBinds, stats.arrayBindsSaved);
+    ImGui::Text("Texture binds: %u (%u saved)", stats.textureBinds, stats.textureBindsSaved);
+}
@@ -6,6 +6,11 @@
 // Fwd. decl.
 struct BallData;
 
+namespace render {
+    // Fwd. decl.
+    struct render_stats;
+}
+
 struct CtrlPanel {
 
     SDL_Window* window;
@@ -28,7 +33,11 @@ struct CtrlPanel {
 
     /*! Renders entire panel
      */
-    void render(BallData& refballData, Camera& refcamera, unsigned* skinHandles, unsigned skinHandlesCount);
+    void render(BallData& refballData,
+                Camera& refcamera,
+                unsigned* skinHandles,
+                unsigned skinHandlesCount,
+                const render::render_stats& stats);
 
     void stop(BallData& refballData) const;
     void reset(BallData& refballData) const;
@@ -43,6 +52,8 @@ struct CtrlPanel {
     bool render_scene_angle_subpanel(Camera& refcamera);
     // Helper
     bool render_scene_position_subpanel(Camera& refcamera);
+    // Helper
+    void render_stats_subpanel(const render::render_stats& stats);
 };
 
 #endif
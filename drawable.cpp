@@ -1,55 +1,547 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
 #include "glad/glad.h"
 
 #include "drawable.hpp"
 
-void render::modify(vbo& refvbo, const float* mat, unsigned instanceIndex)
+namespace {
+
+    // Vertex array bound last through render::bind_vertex_array; 0 is bound
+    // when a context is created
+    unsigned boundArray = 0;
+
+    // Helper
+    // @return first instance in [i, end) whose dirty bit equals value, or end
+    unsigned find_bit(const std::uint64_t* bits, unsigned i, const unsigned end, const bool value)
+    {
+        while (i < end)
+        {
+            std::uint64_t word = value ? bits[i / 64] : ~bits[i / 64];
+            word &= ~std::uint64_t(0) << (i % 64);
+
+            if (word != 0) {
+                return std::min(end, (i / 64) * 64 + unsigned(__builtin_ctzll(word)));
+            }
+
+            i = (i / 64 + 1) * 64;
+        }
+
+        return end;
+    }
+
+    // Helper
+    // Allocates instance storage for refvbo.capacity instances: a range of
+    // instance_arena(), or a ring buffer of STREAM_FRAMES times that
+    void create_storage(render::vbo& refvbo)
+    {
+        static const unsigned instanceBytes = render::INSTANCE_SIZE * sizeof(float);
+
+        const std::size_t nbytes = refvbo.capacity * instanceBytes;
+
+        if (refvbo.mode == render::UPLOAD_SUBDATA)
+        {
+            refvbo.instances = render::instance_arena().allocate(nbytes, instanceBytes);
+            return;
+        }
+
+        glGenBuffers(1, &refvbo.instance);
+        glBindBuffer(GL_ARRAY_BUFFER, refvbo.instance);
+
+        // The first flush moves on to segment 0
+        refvbo.segment = render::STREAM_FRAMES - 1;
+        std::fill(refvbo.fence, refvbo.fence + render::STREAM_FRAMES, nullptr);
+
+        if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)
+        {
+            static const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+            glBufferStorage(GL_ARRAY_BUFFER, render::STREAM_FRAMES * nbytes, nullptr, flags);
+            refvbo.mapped = static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, render::STREAM_FRAMES * nbytes, flags));
+        }
+
+        else {
+            glBufferData(GL_ARRAY_BUFFER, render::STREAM_FRAMES * nbytes, nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    // Helper
+    // @return vertex array shared by the UPLOAD_SUBDATA drawables of layout
+    unsigned shared_vertex_array(const std::vector<unsigned>& layout)
+    {
+        static std::map<std::vector<unsigned>, unsigned> arrays;
+
+        unsigned& array = arrays[layout];
+        if (array == 0) {
+            glGenVertexArrays(1, &array);
+        }
+
+        return array;
+    }
+
+    // Helper
+    // Grows the shadow copy, doubling it, to hold at least count instances;
+    // the instance buffer follows at the next flush
+    void grow(render::vbo& refvbo, const unsigned count)
+    {
+        const unsigned capacity = refvbo.shadow.size() / render::INSTANCE_SIZE;
+        if (count <= capacity) {
+            return;
+        }
+
+        const unsigned next = std::max(count, 2 * capacity);
+
+        refvbo.shadow.resize(next * render::INSTANCE_SIZE, 0.0f);
+        refvbo.dirty.resize((next + 63) / 64, 0);
+    }
+
+    // Helper
+    // Marks count instances from first dirty
+    // @return the shadow copy of instance first
+    float* mark(render::vbo& refvbo, const unsigned first, const unsigned count)
+    {
+        /**/ assert((first + count) * render::INSTANCE_SIZE <= refvbo.shadow.size());
+
+        float* dst = refvbo.shadow.data() + first * render::INSTANCE_SIZE;
+        if (count == 0) {
+            return dst;
+        }
+
+        for (unsigned i = first; i != first + count; ++i)
+            refvbo.dirty[i / 64] |= std::uint64_t(1) << (i % 64);
+
+        if (refvbo.dirtyBegin == refvbo.dirtyEnd)
+        {
+            refvbo.dirtyBegin = first;
+            refvbo.dirtyEnd = first + count;
+        }
+        else
+        {
+            refvbo.dirtyBegin = std::min(refvbo.dirtyBegin, first);
+            refvbo.dirtyEnd = std::max(refvbo.dirtyEnd, first + count);
+        }
+
+        return dst;
+    }
+
+    // Helper
+    // Throws std::out_of_range unless every index names a stored instance;
+    // checked before any write, so a bad batch changes nothing
+    void check_indices(const render::vbo& refvbo, const unsigned* instanceIndices, const unsigned count)
+    {
+        unsigned i = 0;
+        for ( ; i != count; ++i)
+        {
+            if (instanceIndices[i] >= refvbo.instanceCount) {
+                throw std::out_of_range("render: instance index past the last instance");
+            }
+        }
+    }
+
+    // Helper
+    // Copies count instances to the shadow at first and marks them dirty
+    void write(render::vbo& refvbo, const float* mat, const unsigned first, const unsigned count)
+    {
+        if (count != 0) {
+            std::memcpy(mark(refvbo, first, count), mat, count * render::INSTANCE_SIZE * sizeof(float));
+        }
+    }
+
+    // Helper
+    // Points the instance attributes at byte offset of the bound instance buffer
+    void point_attributes(const render::vbo& refvbo, const std::size_t offset)
+    {
+        static const unsigned stride = render::INSTANCE_SIZE * sizeof(float);
+
+        unsigned i = 0;
+        for ( ; i != 3; ++i)
+            glVertexAttribPointer(refvbo.layout.size() + i, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + i * 4 * sizeof(float)));
+    }
+
+    // Helper
+    // Points the vertex array at the arenas' current buffers: vertices from
+    // 0, drawn from firstVertex, and the instances, from 0 with a base
+    // instance or else from their range or ring segment
+    void point_arrays(render::vbo& refvbo)
+    {
+        static const unsigned instanceBytes = render::INSTANCE_SIZE * sizeof(float);
+
+        render::bind_vertex_array(refvbo.mesh);
+        glBindBuffer(GL_ARRAY_BUFFER, render::vertex_arena().buffer());
+
+        unsigned stride = 0;
+        for (unsigned components : refvbo.layout)
+            stride += components * sizeof(float);
+
+        unsigned i = 0, offset = 0;
+        for ( ; i != refvbo.layout.size(); ++i)
+        {
+            glEnableVertexAttribArray(i);
+            glVertexAttribPointer(i, refvbo.layout[i], GL_FLOAT, GL_FALSE, stride, (void*)(std::size_t)(offset));
+            offset += refvbo.layout[i] * sizeof(float);
+        }
+
+        if (refvbo.mode == render::UPLOAD_STREAM)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, refvbo.instance);
+            point_attributes(refvbo, refvbo.segment * refvbo.capacity * instanceBytes);
+        }
+
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, render::instance_arena().buffer());
+            point_attributes(refvbo, refvbo.baseInstance ? 0 : refvbo.instances.offset);
+        }
+
+        // One mat3x4 attribute: rows 0..2 of the model matrix
+        for (i = 0; i != 3; ++i)
+        {
+            glEnableVertexAttribArray(refvbo.layout.size() + i);
+            glVertexAttribDivisor(refvbo.layout.size() + i, 1);
+        }
+
+        refvbo.vertexGeneration = render::vertex_arena().generation();
+        refvbo.instanceGeneration = render::instance_arena().generation();
+    }
+
+    // Helper
+    // Moves the instances to storage sized to the shadow copy: a new arena
+    // range, copied on the GPU, or a new ring, rewritten by the next flush
+    void reallocate(render::vbo& refvbo)
+    {
+        static const unsigned instanceBytes = render::INSTANCE_SIZE * sizeof(float);
+
+        const unsigned copied = std::min<std::size_t>(refvbo.capacity, refvbo.shadow.size() / render::INSTANCE_SIZE);
+        refvbo.capacity = refvbo.shadow.size() / render::INSTANCE_SIZE;
+
+        if (refvbo.mode == render::UPLOAD_SUBDATA)
+        {
+            // Allocated before the old range is released, so the two never overlap
+            const render::range previous = refvbo.instances;
+            create_storage(refvbo);
+
+            const unsigned buffer = render::instance_arena().buffer();
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, previous.offset, refvbo.instances.offset, copied * instanceBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+            render::instance_arena().release(previous);
+        }
+
+        else
+        {
+            // Fences of the old ring; deleting the buffer is deferred by GL
+            // until draws reading it complete
+            for (void*& fence : refvbo.fence)
+            {
+                if (fence != nullptr) {
+                    glDeleteSync(static_cast<GLsync>(fence));
+                }
+                fence = nullptr;
+            }
+
+            const unsigned previous = refvbo.instance;
+
+            refvbo.mapped = nullptr;
+            create_storage(refvbo);
+            glDeleteBuffers(1, &previous);
+
+            // A ring is written whole: have the next flush stream every instance
+            if (refvbo.instanceCount != 0)
+            {
+                refvbo.dirtyBegin = 0;
+                refvbo.dirtyEnd = std::max(refvbo.dirtyEnd, 1u);
+            }
+        }
+
+        ++refvbo.reallocations;
+
+        // Attribute pointers keep the buffer and offset they were set with
+        point_arrays(refvbo);
+    }
+
+    // Helper
+    // Writes the live instances to the next segment of a streamed ring and
+    // points the attributes at it
+    void stream(render::vbo& refvbo)
+    {
+        const std::size_t segmentBytes = refvbo.capacity * render::INSTANCE_SIZE * sizeof(float);
+
+        // Draws reading the current segment were all issued before this fence
+        if (refvbo.mapped != nullptr) {
+            refvbo.fence[refvbo.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        refvbo.segment = (refvbo.segment + 1) % render::STREAM_FRAMES;
+
+        const std::size_t offset = refvbo.segment * segmentBytes;
+        const std::size_t nbytes = refvbo.instanceCount * render::INSTANCE_SIZE * sizeof(float);
+
+        glBindBuffer(GL_ARRAY_BUFFER, refvbo.instance);
+
+        if (refvbo.mapped != nullptr)
+        {
+            // Written STREAM_FRAMES flushes ago; only waits if the GPU is that far behind
+            GLsync fence = static_cast<GLsync>(refvbo.fence[refvbo.segment]);
+            if (fence != nullptr)
+            {
+                GLenum status;
+                do {
+                    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+                } while (status == GL_TIMEOUT_EXPIRED);
+
+                // The wait itself failed (a lost context, say): nothing tells
+                // whether draws still read the segment, so let them all finish
+                if (status == GL_WAIT_FAILED) {
+                    glFinish();
+                }
+
+                glDeleteSync(fence);
+                refvbo.fence[refvbo.segment] = nullptr;
+            }
+
+            // Coherent mapping: visible to the GPU without a flush
+            std::memcpy(reinterpret_cast<char*>(refvbo.mapped) + offset, refvbo.shadow.data(), nbytes);
+        }
+
+        else
+        {
+            // Back at the start of the ring: fresh storage rather than wait
+            // for draws still reading the old
+            if (refvbo.segment == 0) {
+                glBufferData(GL_ARRAY_BUFFER, render::STREAM_FRAMES * segmentBytes, nullptr, GL_STREAM_DRAW);
+            }
+
+            if (nbytes != 0)
+            {
+                static const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+                void* dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, nbytes, flags);
+                std::memcpy(dst, refvbo.shadow.data(), nbytes);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+        }
+
+        // Attribute pointers are vertex array state; the array stays bound
+        // for the draw that follows
+        render::bind_vertex_array(refvbo.mesh);
+        point_attributes(refvbo, offset);
+    }
+}
+
+void render::allocate(vbo& refvbo,
+                      const float* vertices,
+                      unsigned size,
+                      const std::vector<unsigned>& layout,
+                      unsigned instanceSizeMax,
+                      upload_mode mode)
 {
-    static const unsigned nbytes = 16 * sizeof(float);
-    glBindBuffer(GL_ARRAY_BUFFER, refvbo.instance);
+    /**/ assert(instanceSizeMax != 0);
+
+    unsigned stride = 0;
+    for (unsigned components : layout)
+        stride += components * sizeof(float);
+
+    // Base-vertex addressing: the mesh starts on a whole vertex
+    const range r = share_mesh(vertices, size, stride);
+
+    refvbo.layout = layout;
+    refvbo.firstVertex = r.offset / stride;
+    refvbo.vertexCount = size / stride;
+
+    refvbo.mode = mode;
+    refvbo.baseInstance = (mode == UPLOAD_SUBDATA && GLAD_GL_VERSION_4_2);
+
+    refvbo.shadow.assign(instanceSizeMax * INSTANCE_SIZE, 0.0f);
+    refvbo.dirty.assign((instanceSizeMax + 63) / 64, 0);
+    refvbo.dirtyBegin = refvbo.dirtyEnd = 0;
+
+    refvbo.capacity = instanceSizeMax;
+    create_storage(refvbo);
 
-    unsigned off = instanceIndex * nbytes;
-    glBufferSubData(GL_ARRAY_BUFFER, off, nbytes, mat);
+    if (refvbo.baseInstance) {
+        refvbo.mesh = shared_vertex_array(layout);
+    }
+    else {
+        glGenVertexArrays(1, &refvbo.mesh);
+    }
+
+    point_arrays(refvbo);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool render::bind_vertex_array(unsigned array)
+{
+    if (array == boundArray) {
+        return false;
+    }
+
+    glBindVertexArray(boundArray = array);
+    return true;
+}
+
+void render::draw(const vbo& refvbo, unsigned primitive)
+{
+    bind_vertex_array(refvbo.mesh);
+    draw_bound(refvbo, primitive);
+}
+
+void render::draw_bound(const vbo& refvbo, unsigned primitive)
+{
+    static const unsigned instanceBytes = INSTANCE_SIZE * sizeof(float);
+
+    if (refvbo.baseInstance) {
+        glDrawArraysInstancedBaseInstance(primitive, refvbo.firstVertex, refvbo.vertexCount, refvbo.instanceCount, refvbo.instances.offset / instanceBytes);
+    }
+    else {
+        glDrawArraysInstanced(primitive, refvbo.firstVertex, refvbo.vertexCount, refvbo.instanceCount);
+    }
+}
+
+void render::modify(vbo& refvbo, const float* mat, unsigned instanceIndex)
+{
+    check_indices(refvbo, &instanceIndex, 1);
+    write(refvbo, mat, instanceIndex, 1);
 }
 
 void render::modify(vbo& refvbo, const float* mat, unsigned* instanceIndices, unsigned count)
 {
-    static const unsigned nbytes = 16 * sizeof(float);
-    glBindBuffer(GL_ARRAY_BUFFER, refvbo.instance);
+    check_indices(refvbo, instanceIndices, count);
 
     unsigned i = 0;
     for ( ; i != count; ++i)
-    {
-        unsigned off = instanceIndices[i] * nbytes;
-        glBufferSubData(GL_ARRAY_BUFFER, off, nbytes, mat);
-    }
+        write(refvbo, mat, instanceIndices[i], 1);
+}
+
+void render::scatter(vbo& refvbo, const float* mat, const unsigned* instanceIndices, unsigned count)
+{
+    check_indices(refvbo, instanceIndices, count);
+
+    unsigned i = 0;
+    for ( ; i != count; ++i)
+        write(refvbo, mat + i * INSTANCE_SIZE, instanceIndices[i], 1);
 }
 
 void render::reset(vbo& refvbo, const float* mat, unsigned count)
 {
-    static const unsigned nbytes = 16 * sizeof(float);
-    glBindBuffer(GL_ARRAY_BUFFER, refvbo.instance);
+    grow(refvbo, count);
+    refvbo.instanceCount = count;
+    write(refvbo, mat, 0, count);
+}
 
+float* render::reset(vbo& refvbo, unsigned count)
+{
+    grow(refvbo, count);
     refvbo.instanceCount = count;
-    glBufferSubData(GL_ARRAY_BUFFER, 0, count * nbytes, mat);
+    return mark(refvbo, 0, count);
 }
 
 void render::push_back(vbo& refvbo, const float* mat)
 {
-    static const unsigned nbytes = 16 * sizeof(float);
+    grow(refvbo, refvbo.instanceCount + 1);
+    write(refvbo, mat, refvbo.instanceCount++, 1);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, refvbo.instance);
+void render::push_back(vbo& refvbo, const float* mat, unsigned count)
+{
+    grow(refvbo, refvbo.instanceCount + count);
+    write(refvbo, mat, refvbo.instanceCount, count);
+    refvbo.instanceCount += count;
+}
 
-    unsigned off = refvbo.instanceCount++ * nbytes;
-    glBufferSubData(GL_ARRAY_BUFFER, off, nbytes, mat);
+float* render::push_back(vbo& refvbo, unsigned count)
+{
+    grow(refvbo, refvbo.instanceCount + count);
+    float* dst = mark(refvbo, refvbo.instanceCount, count);
+    refvbo.instanceCount += count;
+    return dst;
 }
 
-void render::push_back(vbo& refvbo, const float* mat, unsigned count)
+unsigned render::flush(vbo& refvbo)
 {
-    static const unsigned nbytes = 16 * sizeof(float);
+    static const unsigned nbytes = INSTANCE_SIZE * sizeof(float);
 
-    glBindBuffer(GL_ARRAY_BUFFER, refvbo.instance);
+    if (refvbo.capacity * INSTANCE_SIZE != refvbo.shadow.size()) {
+        reallocate(refvbo);
+    }
 
-    unsigned offset = refvbo.instanceCount * nbytes;
-    glBufferSubData(GL_ARRAY_BUFFER, offset, count * nbytes, mat);
-    refvbo.instanceCount += count;
+    // Either arena moved to a bigger buffer since the vertex array was set up
+    if (refvbo.vertexGeneration != vertex_arena().generation() ||
+        refvbo.instanceGeneration != instance_arena().generation()) {
+        point_arrays(refvbo);
+    }
+
+    const unsigned end = refvbo.dirtyEnd;
+    if (refvbo.dirtyBegin == end) {
+        return 0;
+    }
+
+    std::uint64_t* bits = refvbo.dirty.data();
+
+    // Every live instance goes to the next segment, dirty or not
+    if (refvbo.mode == UPLOAD_STREAM)
+    {
+        std::fill(bits + refvbo.dirtyBegin / 64, bits + (end + 63) / 64, 0);
+        refvbo.dirtyBegin = refvbo.dirtyEnd = 0;
+
+        stream(refvbo);
+        return 1;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_arena().buffer());
+
+    unsigned uploads = 0;
+    unsigned first = find_bit(bits, refvbo.dirtyBegin, end, true);
+
+    while (first != end)
+    {
+        // Extend the run over dirty instances and over short clean gaps
+        unsigned last = find_bit(bits, first, end, false);
+        unsigned next = find_bit(bits, last, end, true);
+
+        while (next != end && next - last <= FLUSH_GAP)
+        {
+            last = find_bit(bits, next, end, false);
+            next = find_bit(bits, last, end, true);
+        }
+
+        glBufferSubData(GL_ARRAY_BUFFER, refvbo.instances.offset + first * nbytes, (last - first) * nbytes, refvbo.shadow.data() + first * INSTANCE_SIZE);
+        ++uploads;
+
+        first = next;
+    }
+
+    std::fill(bits + refvbo.dirtyBegin / 64, bits + (end + 63) / 64, 0);
+    refvbo.dirtyBegin = refvbo.dirtyEnd = 0;
+    return uploads;
+}
+
+void render::shrink_to_fit(vbo& refvbo)
+{
+    const unsigned capacity = std::max(1u, refvbo.instanceCount);
+    if (capacity * INSTANCE_SIZE >= refvbo.shadow.size()) {
+        return;
+    }
+
+    refvbo.shadow.resize(capacity * INSTANCE_SIZE);
+    refvbo.shadow.shrink_to_fit();
+
+    // Drop dirty bits past the end, including those in the last word
+    refvbo.dirty.resize((capacity + 63) / 64);
+    if (capacity % 64 != 0) {
+        refvbo.dirty.back() &= ~(~std::uint64_t(0) << (capacity % 64));
+    }
+
+    refvbo.dirtyEnd = std::min(refvbo.dirtyEnd, capacity);
+    refvbo.dirtyBegin = std::min(refvbo.dirtyBegin, refvbo.dirtyEnd);
+}
+
+unsigned render::capacity(const vbo& refvbo)
+{
+    return refvbo.shadow.size() / INSTANCE_SIZE;
 }
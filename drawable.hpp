@@ -3,20 +3,97 @@
 #ifndef DRAWABLE_HPP
 #define DRAWABLE_HPP
 
+#include <cstdint>
+#include <vector>
+
+#include "arena.hpp"
+#include "render_queue.hpp"
+
 namespace render {
 
+    /// Floats per instance: an affine model transform, rows 0..2 of the 4x4
+    /// model matrix in row-major order (see calc::affine3f)
+    static const unsigned INSTANCE_SIZE = 12;
+
     /// struct tao
     /*! OpenGL textures
      */
     struct tao { unsigned tao[1024], size; };
+
+    /// Clean instances between two dirty runs that flush() uploads along
+    /// with them rather than issuing another call (8 x 48 bytes)
+    static const unsigned FLUSH_GAP = 8;
+
+    /// Segments in the ring of a streamed instance buffer: the frame being
+    /// written and up to two the GPU may still read
+    static const unsigned STREAM_FRAMES = 3;
+
+    /// How flush() gets the instances to the GPU
+    enum upload_mode {
+        /// A range of instance_arena(); dirty runs are uploaded with
+        /// glBufferSubData, which may wait on draws still reading the
+        /// buffer. For data that rarely changes
+        UPLOAD_SUBDATA,
+        /// A ring of STREAM_FRAMES buffer segments in a buffer of its own
+        /// (mapped storage cannot grow with an arena), the next one rewritten
+        /// whole by each flush that has changes and guarded by a fence. The
+        /// ring is persistently mapped on GL 4.4 or with ARB_buffer_storage,
+        /// and orphaned and mapped unsynchronized otherwise. For many
+        /// instances rewritten every frame; a single one, like the ball, is
+        /// cheaper through UPLOAD_SUBDATA
+        UPLOAD_STREAM
+    };
+
     /// struct vbo
-    /*! OpenGL vbos
+    /*! Vertex array and arena ranges of a drawable, and a CPU shadow copy of
+     *! its instances: writes go to the shadow and mark their instances
+     *! dirty, flush() uploads them. The shadow doubles when push_back or
+     *! reset outgrow it, and flush() moves the instances to a range of the
+     *! new size
      */
-    struct vbo { unsigned mesh, instance, vertex, instanceCount; };
+    struct vbo {
+
+        // Vertex array; with baseInstance, shared by every UPLOAD_SUBDATA
+        // drawable of the same layout, instances addressed by base instance
+        unsigned mesh;
+        bool baseInstance;
+        // Floats per vertex attribute 0..n-1, interleaved; the instance
+        // transform takes attributes n..n+2
+        std::vector<unsigned> layout;
+        // The mesh in vertex_arena(), drawn from firstVertex
+        unsigned firstVertex, vertexCount;
+        // UPLOAD_SUBDATA: the instances' range of instance_arena()
+        range instances;
+        // UPLOAD_STREAM: the ring buffer
+        unsigned instance;
+        // Arena generations the vertex array points at
+        unsigned vertexGeneration, instanceGeneration;
+
+        unsigned instanceCount;
+        // Instances the instance storage holds, and times it was replaced
+        unsigned capacity, reallocations;
+        upload_mode mode;
+
+        // Instance data, INSTANCE_SIZE floats per allocated instance
+        std::vector<float> shadow;
+        // One bit per instance written since the last flush
+        std::vector<std::uint64_t> dirty;
+        // Every dirty instance lies in [dirtyBegin, dirtyEnd)
+        unsigned dirtyBegin, dirtyEnd;
+
+        // UPLOAD_STREAM: segment the attributes point at, the persistent
+        // mapping of the ring (or null), and a fence per segment (GLsync)
+        unsigned segment;
+        float* mapped;
+        void* fence[STREAM_FRAMES];
+    };
 
     //! class drawable
     /*! Abstract interface for instancing-based drawing of single object type;
-     *! implemented by instanced objects that are passed to the render pipeline
+     *! implemented by instanced objects that are passed to the render pipeline.
+     *! modify, scatter, reset and push_back are deferred: they only write the
+     *! shadow copy, and draws keep the previous transforms until flush()
+     *! uploads them
      */
     class Drawable {
     public:
@@ -25,33 +102,105 @@ namespace render {
         virtual ~Drawable() {}
         /// Called by renderer to draw all stored object instances
         virtual void draw() const = 0;
-        /// @param mat model matrix
+        /// Queues a draw of all stored object instances, with program
+        virtual void submit(RenderQueue& queue, unsigned program) const = 0;
+        /// @param mat affine model transform, INSTANCE_SIZE floats
+        /// @throw std::out_of_range if instanceIndex is not below the instance count
         virtual void modify(const float* mat, unsigned  instanceIndex) = 0;
-        /// @param mat array of model matrices
+        /// @param mat affine model transform, written to every index
         /// @param size size of array
+        /// @throw std::out_of_range, writing nothing, if an index is not below the instance count
         virtual void modify(const float* mat, unsigned* instanceIndices, unsigned size) = 0;
-        /// @param mat array of model matrices
+        /// @param mat array of affine model transforms, mat[i] for instanceIndices[i]
+        /// @param size size of both arrays
+        /// @throw std::out_of_range, writing nothing, if an index is not below the instance count
+        virtual void scatter(const float* mat, const unsigned* instanceIndices, unsigned size) = 0;
+        /// @param mat array of affine model transforms
         /// @param size size of array
         virtual void reset(const float* mat, unsigned size) = 0;
-        /// @param mat model matrix
+        /// As reset(mat, size), for a caller that writes the transforms itself
+        /// @return size * INSTANCE_SIZE floats of the shadow copy, to be
+        ///         filled before the next flush(); valid until the next call
+        ///         that adds instances or shrink_to_fit()
+        virtual float* reset(unsigned size) = 0;
+        /// @param mat affine model transform
         virtual void push_back(const float* mat) = 0;
-        /// @param mat array of model matrices
+        /// @param mat array of affine model transforms
         /// @param size size of array
         virtual void push_back(const float* mat, unsigned size) = 0;
+        /// As push_back(mat, size), for a caller that writes the transforms itself
+        /// @return the shadow copy of the first new instance; see reset(size)
+        virtual float* push_back(unsigned size) = 0;
+        /// Uploads the instances changed since the last flush, adjacent ones
+        /// in one call; once per frame, before draw()
+        virtual void flush() = 0;
+        /// Releases the space past the last instance at the next flush()
+        virtual void shrink_to_fit() = 0;
+        /// @return instances that fit before the storage grows
+        virtual unsigned capacity() const = 0;
+        /// @return times the instance buffer was replaced to grow or shrink
+        virtual unsigned reallocations() const = 0;
     };
 
+    /// @impl
+    /// Shares the mesh through vertex_arena(), allocates the instance storage
+    /// and its shadow copy, and sets up the vertex array
+    /// @param vertices mesh vertices, static for the program's lifetime
+    /// @param size size of vertices in bytes
+    /// @param layout floats per vertex attribute
+    /// @param instanceSizeMax initial capacity, at least 1
+    void allocate(vbo& refvbo,
+                  const float* vertices,
+                  unsigned size,
+                  const std::vector<unsigned>& layout,
+                  unsigned instanceSizeMax,
+                  upload_mode mode);
+
+    /// @impl
+    /// Binds array unless it is the one bound last through here; every
+    /// vertex array bind of the renderer goes through it (code binding one
+    /// directly, like the ImGui backend, must restore the previous binding)
+    /// @return true if glBindVertexArray was called
+    bool bind_vertex_array(unsigned array);
+
+    /// @impl
+    /// Binds the vertex array, unless already bound, and draws the instances
+    /// @param primitive primitive type (GL_TRIANGLES, ...)
+    void draw(const vbo& refvbo, unsigned primitive);
+    /// @impl
+    /// Draws the instances, the vertex array already bound
+    /// @param primitive primitive type (GL_TRIANGLES, ...)
+    void draw_bound(const vbo& refvbo, unsigned primitive);
+
     /// @impl
     void modify(vbo& refvbo, const float* mat, unsigned instanceIndex);
     /// @impl
     void modify(vbo& refvbo, const float* mat, unsigned* instanceIndices, unsigned count);
+    /// @impl
+    void scatter(vbo& refvbo, const float* mat, const unsigned* instanceIndices, unsigned count);
 
     /// @impl
     void reset(vbo& refvbo, const float* mat, unsigned count);
+    /// @impl
+    float* reset(vbo& refvbo, unsigned count);
 
     /// @impl
     void push_back(vbo& refvbo, const float* mat);
     /// @impl
     void push_back(vbo& refvbo, const float* mat, unsigned count);
+    /// @impl
+    float* push_back(vbo& refvbo, unsigned count);
+
+    /// @impl
+    /// Resizes the instance buffer first if the shadow grew or shrank
+    /// @return number of uploads issued
+    unsigned flush(vbo& refvbo);
+
+    /// @impl
+    void shrink_to_fit(vbo& refvbo);
+
+    /// @impl
+    unsigned capacity(const vbo& refvbo);
 }
 
 #endif
@@ -8,7 +8,7 @@
 namespace {
 
     // Square
-    static const float VERTICES__[] = {
+    static constexpr float VERTICES__[] = {
 
         -0.5f, -0.5f, -0.5f,
         +0.5f, -0.5f, -0.5f,
@@ -19,58 +19,25 @@ namespace {
     };
 }
 
-render::GridSquare::GridSquare(unsigned instanceSizeMax)
+render::GridSquare::GridSquare(unsigned instanceSizeMax, upload_mode mode)
 {
-    ::memset(&vbo_, 0, sizeof(vbo_));
+    vbo_ = vbo();
 
-    // Initialize OpenGL buffers
-    glGenVertexArrays(1, &vbo_.mesh);
-    glBindVertexArray(vbo_.mesh);
-
-    glGenBuffers(1, &vbo_.vertex);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_.vertex);
-
-    // Add vertices
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VERTICES__), VERTICES__, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(0));
-
-    // Instancing
-    glGenBuffers(1, &vbo_.instance);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_.instance);
-
-    // Null buffer
-    glBufferData(GL_ARRAY_BUFFER, instanceSizeMax * 16 * sizeof(float), nullptr, GL_STREAM_DRAW);
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(0));
-
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(4  * sizeof(float)));
-
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(8  * sizeof(float)));
-
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(12 * sizeof(float)));
-
-    glVertexAttribDivisor(1, 1);
-    glVertexAttribDivisor(2, 1);
-    glVertexAttribDivisor(3, 1);
-    glVertexAttribDivisor(4, 1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Mesh, instance storage and vertex array
+    render::allocate(vbo_, VERTICES__, sizeof(VERTICES__), {3}, instanceSizeMax, mode);
 }
 
 void render::GridSquare::draw() const
 {
-    static const unsigned vertexSize = sizeof(VERTICES__) / sizeof(float) / 3;
-    glBindVertexArray(vbo_.mesh);
     glBindTexture(GL_TEXTURE_2D, 0);
     // Draw
-    glDrawArraysInstanced(GL_LINE_STRIP_ADJACENCY, 0, vertexSize, vbo_.instanceCount);
+    render::draw(vbo_, GL_LINE_STRIP_ADJACENCY);
+}
+
+void render::GridSquare::submit(RenderQueue& queue, unsigned program) const
+{
+    const packet p = { program, vbo_.mesh, nullptr, 0, &vbo_, GL_LINE_STRIP_ADJACENCY };
+    queue.submit(p);
 }
 
 void render::GridSquare::modify(const float* mat, unsigned instanceIndex)
@@ -83,10 +50,19 @@ void render::GridSquare::modify(const float* mat, unsigned* instanceIndices, uns
     render::modify(vbo_, mat, instanceIndices, count);
 }
 
+void render::GridSquare::scatter(const float* mat, const unsigned* instanceIndices, unsigned count)
+{
+    render::scatter(vbo_, mat, instanceIndices, count);
+}
+
 void render::GridSquare::reset(const float* mat, unsigned count) {
     render::reset(vbo_, mat, count);
 }
 
+float* render::GridSquare::reset(unsigned count) {
+    return render::reset(vbo_, count);
+}
+
 void render::GridSquare::push_back(const float* mat) {
     render::push_back(vbo_, mat);
 }
@@ -94,3 +70,23 @@ void render::GridSquare::push_back(const float* mat) {
 void render::GridSquare::push_back(const float* mat, unsigned count) {
     render::push_back(vbo_, mat, count);
 }
+
+float* render::GridSquare::push_back(unsigned count) {
+    return render::push_back(vbo_, count);
+}
+
+void render::GridSquare::flush() {
+    render::flush(vbo_);
+}
+
+void render::GridSquare::shrink_to_fit() {
+    render::shrink_to_fit(vbo_);
+}
+
+unsigned render::GridSquare::capacity() const {
+    return render::capacity(vbo_);
+}
+
+unsigned render::GridSquare::reallocations() const {
+    return vbo_.reallocations;
+}
@@ -13,20 +13,37 @@ namespace render {
     public:
         GridSquare() {}
         /// ctor.
-        /// @param instanceSizeMax the maximum # of instances to allocate
-        explicit GridSquare(unsigned instanceSizeMax);
+        /// @param instanceSizeMax the # of instances to allocate up front; grows as needed
+        /// @param mode how instance changes are uploaded
+        explicit GridSquare(unsigned instanceSizeMax, upload_mode mode = UPLOAD_SUBDATA);
         /// @override
         void draw() const;
         /// @override
+        void submit(RenderQueue& queue, unsigned program) const;
+        /// @override
         void modify(const float* mat, unsigned  instanceIndex);
         /// @override
         void modify(const float* mat, unsigned* instanceIndices, unsigned size);
         /// @override
+        void scatter(const float* mat, const unsigned* instanceIndices, unsigned size);
+        /// @override
         void reset(const float* mat, unsigned size);
         /// @override
+        float* reset(unsigned size);
+        /// @override
         void push_back(const float* mat);
         /// @override
         void push_back(const float* mat, unsigned size);
+        /// @override
+        float* push_back(unsigned size);
+        /// @override
+        void flush();
+        /// @override
+        void shrink_to_fit();
+        /// @override
+        unsigned capacity() const;
+        /// @override
+        unsigned reallocations() const;
 
     private:
 
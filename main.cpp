@@ -25,6 +25,7 @@
 #include "draw_instanced_no_texture.hpp"
 #include "draw_instanced_with_texture.hpp"
 #include "grid_square.hpp"
+#include "render_queue.hpp"
 #include "square.hpp"
 #include "texture.hpp"
 
@@ -89,31 +90,24 @@ namespace{
     /*! Helper
      *! Builds the vertices for the map grid
      */
-    std::vector<calc::mat4f> build_grid(int width, int length)
+    calc::mat4f_array build_grid(int width, int length)
     {
         static const float xdim = 1.0;
         static const float ydim = 1.0;
 
-        calc::mat4f model = calc::mat4f::identity();
-        float& x = model[3][0];
-        float& y = model[3][1];
-
         const int xinst = std::ceil(width / 2.0 / xdim);
         const int yinst = std::ceil(length / 2.0 / ydim);
 
-        const int size = xinst * yinst * 4;
-
-        std::vector<calc::mat4f> grid;
-        grid.resize(size);
-        calc::mat4f* ptr = &grid[0];
+        calc::mat4f_array grid(xinst * yinst * 4);
+        float* x = grid.stream(0, 3);
+        float* y = grid.stream(1, 3);
 
         for (int i = -xinst; i != xinst; ++i)
         {
             for (int j = -yinst; j != yinst; ++j)
             {
-                x = i * xdim + 0.5;
-                y = j * ydim + 0.5;
-                *ptr++ = model;
+                *x++ = i * xdim + 0.5;
+                *y++ = j * ydim + 0.5;
             }
         }
 
@@ -123,75 +117,49 @@ namespace{
     /*! Helper
      *! Build the vertices for the map wall
      */
-    std::vector<calc::mat4f> build_wall(int width, int length)
+    calc::mat4f_array build_wall(int width, int length)
     {
-        std::vector<calc::mat4f> wall;
+        // One 3x3 wall tile, pushed back to z = -1; baked at compile time
+        constexpr calc::mat4f tile = calc::static_product(calc::translate_4(0, 0, -1.0), calc::scale_4(3, 3, 1));
+
+        calc::mat4f mat = tile;
+
+        calc::mat4f_array wall;
 
         // West wall
         for (int i = 1 - length / 2 / 3; i != length / 2 / 3; ++i)
         {
-            calc::mat4f mat = calc::mat4f::identity();
-            mat[0][0] = 3;
-            mat[1][1] = 3;
-
             mat[0][3] = width / 2 - 1;
             mat[1][3] = i * 3;
-            mat[2][3] = -1.0;
-            wall.push_back(calc::transpose(mat));
+            wall.push_back(mat);
         }
 
         // East wall
         for (int i = 1 - length / 2 / 3; i != length / 2 / 3; ++i)
         {
-            calc::mat4f mat = calc::mat4f::identity();
-            mat[0][0] = 3;
-            mat[1][1] = 3;
-
             mat[0][3] = 1 - width / 2;
             mat[1][3] = i * 3;
-            mat[2][3] = -1.0;
-            wall.push_back(calc::transpose(mat));
+            wall.push_back(mat);
         }
 
         // North wall
         for (int i = 1 - width / 2 / 3; i != width / 2 / 3; ++i)
         {
-            calc::mat4f mat = calc::mat4f::identity();
-            mat[0][0] = 3;
-            mat[1][1] = 3;
-
             mat[0][3] = i * 3;
             mat[1][3] = length / 2 - 1;
-            mat[2][3] = -1.0;
-            wall.push_back(calc::transpose(mat));
+            wall.push_back(mat);
         }
 
         // South wall
         for (int i = 1 - width / 2 / 3; i != width / 2 / 3; ++i)
         {
-            calc::mat4f mat = calc::mat4f::identity();
-            mat[0][0] = 3;
-            mat[1][1] = 3;
-
             mat[0][3] = i * 3;
             mat[1][3] = 1 - length / 2;
-            mat[2][3] = -1.0;
-            wall.push_back(calc::transpose(mat));
+            wall.push_back(mat);
         }
 
         return wall;
     }
-
-    /*! Helper
-     *! Converts matrix to float data
-     */
-    inline std::vector<float> copy_matrix_data(const std::vector<calc::mat4f>& mats)
-    {
-        std::vector<float> values(mats.size() * 16);
-        for (::size_t i = 0; i != mats.size(); ++i)
-            ::memcpy(&values[i * 16], calc::data(mats[i]), sizeof(calc::mat4f));
-        return values;
-    }
 }
 
 namespace {
@@ -245,13 +213,13 @@ namespace {
                                                                      false));
 
             ballObject_[0] = render::Box(boxTAO1, (sizeof(boxTAO1) / sizeof(unsigned)), 1);
-            ballObject_[0].push_back(calc::mat4f::identity());
+            ballObject_[0].push_back(calc::affine3f::identity());
 
             ballObject_[1] = render::Box(boxTAO2, (sizeof(boxTAO2) / sizeof(unsigned)), 1);
-            ballObject_[1].push_back(calc::mat4f::identity());
+            ballObject_[1].push_back(calc::affine3f::identity());
 
             ballObject_[2] = render::Box(boxTAO3, (sizeof(boxTAO3) / sizeof(unsigned)), 1);
-            ballObject_[2].push_back(calc::mat4f::identity());
+            ballObject_[2].push_back(calc::affine3f::identity());
 
             // Load map...
             float cageWidth = width + (width % 2);
@@ -264,14 +232,14 @@ namespace {
             float gridLength = 2 * cageLength;
 
             // Load grid tiles
-            const std::vector<float> grid = copy_matrix_data(build_grid(gridWidth, gridLength));
+            calc::mat4f_array grid = build_grid(gridWidth, gridLength);
             gridTile_ = render::GridSquare((gridWidth * gridLength));
-            gridTile_.reset(grid.data(), (grid.size() / 16));
+            grid.device_affine(gridTile_.reset(grid.size()));
 
             // Load wall
-            const std::vector<float> wall = copy_matrix_data(build_wall(cageWidth, cageLength));
+            calc::mat4f_array wall = build_wall(cageWidth, cageLength);
             wallObject_ = render::Box(wallTAO, (sizeof(wallTAO) / sizeof(unsigned)), (cageWidth * cageLength));
-            wallObject_.reset(wall.data(), (wall.size() / 16));
+            wall.device_affine(wallObject_.reset(wall.size()));
 
             // Load dry grass tiles...
             unsigned dryGrassTextureTAO = render::load_texture_from_data(dry_grass_png, dry_grass_png_len, false);
@@ -298,15 +266,16 @@ namespace {
 
             // Load dry grass coordinates
             calc::mat4f mat = calc::mat4f::identity();
+            calc::mat4f_array dryGrass;
 
             // Top field
             for (int i = cageMaxLength; i <= gridMaxLength; ++i)
             {
                 for (int j = gridMinWidth; j <= gridMaxWidth; ++j)
                 {
-                    mat[3][0] = j;
-                    mat[3][1] = i;
-                    dryGrassTile_.push_back(mat);
+                    mat[0][3] = j;
+                    mat[1][3] = i;
+                    dryGrass.push_back(mat);
                 }
             }
 
@@ -315,9 +284,9 @@ namespace {
             {
                 for (int j = gridMinWidth; j <= cageMinWidth + 1; ++j)
                 {
-                    mat[3][0] = j;
-                    mat[3][1] = i;
-                    dryGrassTile_.push_back(mat);
+                    mat[0][3] = j;
+                    mat[1][3] = i;
+                    dryGrass.push_back(mat);
                 }
             }
 
@@ -326,9 +295,9 @@ namespace {
             {
                 for (int j = cageMaxWidth - 1; j <= gridMaxWidth; ++j)
                 {
-                    mat[3][0] = j;
-                    mat[3][1] = i;
-                    dryGrassTile_.push_back(mat);
+                    mat[0][3] = j;
+                    mat[1][3] = i;
+                    dryGrass.push_back(mat);
                 }
             }
 
@@ -337,12 +306,14 @@ namespace {
             {
                 for (int j = gridMinWidth; j <= gridMaxWidth; ++j)
                 {
-                    mat[3][0] = j;
-                    mat[3][1] = i;
-                    dryGrassTile_.push_back(mat);
+                    mat[0][3] = j;
+                    mat[1][3] = i;
+                    dryGrass.push_back(mat);
                 }
             }
 
+            dryGrass.device_affine(dryGrassTile_.reset(dryGrass.size()));
+
             // Load fresh grass tiles...
             unsigned grassTextureTAO = render::load_texture_from_data(dark_grass_png, dark_grass_png_len, false);
             unsigned grassTileTAO[] = {
@@ -356,20 +327,18 @@ namespace {
             const int wallThickness = 2;
 
             // Load fresh grass coordinates
+            calc::mat4f_array grass;
             for (int i = cageMinLength + wallThickness; i <= cageMaxLength - wallThickness; ++i)
             {
                 for (int j = cageMinWidth + wallThickness; j <= cageMaxWidth - wallThickness; ++j)
                 {
-                    grassTile_.push_back(calc::transpose([i, j]() {
-
-                        calc::mat4f mat = calc::mat4f::identity();
-                        mat[0][3] = j;
-                        mat[1][3] = i;
-                        mat[2][3] = 0;
-                        return mat;
-                    }()));
+                    mat[0][3] = j;
+                    mat[1][3] = i;
+                    grass.push_back(mat);
                 }
             }
+
+            grass.device_affine(grassTile_.reset(grass.size()));
         }
 
         /*! Run loop
@@ -466,7 +435,13 @@ namespace {
             const calc::mat4f& lookAt     = camera_->get_device_look_at();
             const calc::mat4f& projection = camera_->get_device_projection();
 
-            // Maybe draw the grid
+            // Upload the instances changed since the last frame
+            gridTile_.flush();
+            wallObject_.flush();
+            dryGrassTile_.flush();
+            grassTile_.flush();
+
+            // Per-frame uniforms; programs keep them while others are in use
             if (panel_.enableGrid)
             {
                 gridDraw_.use();
@@ -475,18 +450,23 @@ namespace {
                                                 panel_.gridColor[2],
                                                 1.0));
                 gridDraw_.set_scene(lookAt, projection);
-                gridTile_.draw();
             }
 
-            // Draw the wall
             mainDraw_.use();
             mainDraw_.set_scene(lookAt, projection);
-            wallObject_.draw();
+
+            // Maybe draw the grid
+            if (panel_.enableGrid) {
+                gridTile_.submit(renderQueue_, gridDraw_.handle());
+            }
+
+            // Draw the wall
+            wallObject_.submit(renderQueue_, mainDraw_.handle());
 
             // Draw the grass outside the cage
-            dryGrassTile_.draw();
+            dryGrassTile_.submit(renderQueue_, mainDraw_.handle());
             // Draw the grass inside the cage
-            grassTile_.draw();
+            grassTile_.submit(renderQueue_, mainDraw_.handle());
 
             // Draw the box
             calc::vec3f& direction = ballData_.direction;
@@ -510,17 +490,20 @@ namespace {
             }
 
             const calc::vec3f turnRate = ballData_.turnRate * calc::radians(SDL_GetTicks() / 10.0);
-            const calc::mat4f boxMat = calc::transpose(translation
-                                                       * calc::rotate_4x(turnRate[0])
-                                                       * calc::rotate_4y(turnRate[1])
-                                                       * calc::rotate_4z(turnRate[2]));
+            ballData_.orientation = calc::quatf::from_euler(turnRate[0], turnRate[1], turnRate[2]);
+            const calc::affine3f boxMat = calc::to_affine(ballData_.orientation, calc::vec3f(x, y, translation[2][3]));
 
             render::Box& refobject = ballObject_[ballData_.selectedSkin];
+            // Deferred: the draw sees the new transform once flushed
             refobject.modify(calc::data(boxMat), 0);
-            refobject.draw();
+            refobject.flush();
+            refobject.submit(renderQueue_, mainDraw_.handle());
+
+            // Issue the frame's draws, sorted by state
+            renderQueue_.execute();
 
             // Draw the control panel
-            panel_.render(ballData_, *camera_, textureHandles_.data(), textureHandles_.size());
+            panel_.render(ballData_, *camera_, textureHandles_.data(), textureHandles_.size(), renderQueue_.stats());
             // Update screen & return
             SDL_GL_SwapWindow(window_);
         }
@@ -543,6 +526,9 @@ namespace {
         // called to draw all textured objects
         DrawInstancedWithTexture mainDraw_;
 
+        // Draws of the frame, issued sorted by state
+        render::RenderQueue renderQueue_;
+
         // Map item
         render::Square     grassTile_;
         // Map item
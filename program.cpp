@@ -36,6 +36,10 @@ void Program::use() {
     glUseProgram(programHandle_);
 }
 
+unsigned Program::handle() const {
+    return programHandle_;
+}
+
 void Program::link()
 {
     // Link program
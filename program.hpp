@@ -36,6 +36,9 @@ public:
     Program();
     /// Sets program to be used by subsequent calls
     void use();
+    /// @get
+    /// @return OpenGL program handle
+    unsigned handle() const;
     /// Links program (use during creation phase)
     void link();
     /// @set
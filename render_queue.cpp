@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cassert>
+
+#include "glad/glad.h"
+
+#include "drawable.hpp"
+#include "render_queue.hpp"
+
+namespace {
+
+    // Not a handle: state that has to be bound whatever it was
+    static const unsigned UNKNOWN = ~0u;
+
+    // Helper
+    // Draw order: program, then vertex array, then textures unit by unit
+    bool state_less(const render::packet& a, const render::packet& b)
+    {
+        if (a.program != b.program) {
+            return a.program < b.program;
+        }
+
+        if (a.mesh != b.mesh) {
+            return a.mesh < b.mesh;
+        }
+
+        return std::lexicographical_compare(a.textures, a.textures + a.textureCount,
+                                            b.textures, b.textures + b.textureCount);
+    }
+}
+
+render::RenderQueue::RenderQueue() : stats_() {}
+
+void render::RenderQueue::submit(const packet& p)
+{
+    /**/ assert(p.textureCount <= PACKET_TEXTURES_MAX);
+    packets_.push_back(p);
+}
+
+void render::RenderQueue::execute()
+{
+    std::stable_sort(packets_.begin(), packets_.end(), state_less);
+
+    stats_ = render_stats();
+    stats_.packets = packets_.size();
+
+    unsigned program = UNKNOWN, unit = UNKNOWN;
+
+    unsigned bound[PACKET_TEXTURES_MAX];
+    std::fill(bound, bound + PACKET_TEXTURES_MAX, UNKNOWN);
+
+    // Binds a draw of its own would issue: program, vertex array, and an
+    // unbind followed by every texture
+    unsigned naivePrograms = 0, naiveArrays = 0, naiveTextures = 0;
+
+    for (const packet& p : packets_)
+    {
+        ++naivePrograms;
+        ++naiveArrays;
+        naiveTextures += p.textureCount + 1;
+
+        if (p.program != program)
+        {
+            glUseProgram(program = p.program);
+            ++stats_.programBinds;
+        }
+
+        // Tracked across frames and with the drawables' own binds
+        if (bind_vertex_array(p.mesh)) {
+            ++stats_.arrayBinds;
+        }
+
+        unsigned i = 0;
+        for ( ; i != p.textureCount; ++i)
+        {
+            if (bound[i] == p.textures[i]) {
+                continue;
+            }
+
+            if (unit != i) {
+                glActiveTexture(GL_TEXTURE0 + (unit = i));
+            }
+
+            glBindTexture(GL_TEXTURE_2D, bound[i] = p.textures[i]);
+            ++stats_.textureBinds;
+        }
+
+        draw_bound(*p.instances, p.primitive);
+    }
+
+    stats_.programBindsSaved = naivePrograms - stats_.programBinds;
+    stats_.arrayBindsSaved = naiveArrays - stats_.arrayBinds;
+    stats_.textureBindsSaved = naiveTextures - stats_.textureBinds;
+
+    packets_.clear();
+}
+
+const render::render_stats& render::RenderQueue::stats() const {
+    return stats_;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <vector>
+
+namespace render {
+
+    // Fwd. decl.
+    struct vbo;
+
+    /// Texture units whose bindings the queue tracks; packets bind at most
+    /// this many textures
+    static const unsigned PACKET_TEXTURES_MAX = 16;
+
+    /// struct packet
+    /*! One instanced draw and the state it needs
+     */
+    struct packet {
+
+        // Program handle
+        unsigned program;
+        // Vertex array handle
+        unsigned mesh;
+        // Texture handles, bound to units 0..textureCount - 1
+        const unsigned* textures;
+        unsigned textureCount;
+        // Instances, and the primitive type they are drawn with
+        const vbo* instances;
+        unsigned primitive;
+    };
+
+    /// struct render_stats
+    /*! State changes of the last RenderQueue::execute(): those issued, and
+     *! those saved against binding each packet's program, vertex array and
+     *! textures (Drawable::draw() also unbinds unit 0 first)
+     */
+    struct render_stats {
+
+        unsigned packets;
+
+        unsigned programBinds, programBindsSaved;
+        unsigned arrayBinds, arrayBindsSaved;
+        unsigned textureBinds, textureBindsSaved;
+    };
+
+    /// class RenderQueue
+    /*! Collects the draws of a frame and issues them sorted by program, then
+     *! vertex array, then texture set, binding only the state that changes
+     *! between one packet and the next; packets with the same state keep
+     *! their submission order
+     */
+    class RenderQueue {
+    public:
+        /// ctor.
+        RenderQueue();
+        /// Queues a draw until execute()
+        void submit(const packet& p);
+        /// Issues the queued draws and empties the queue. State bound by
+        /// others in between is not trusted: the first packet binds all
+        void execute();
+        /// @get
+        /// @return state changes of the last execute()
+        const render_stats& stats() const;
+
+    private:
+
+        // Packets of the frame, in submission order
+        std::vector<packet> packets_;
+        render_stats stats_;
+    };
+}
+
+#endif
@@ -2,13 +2,14 @@ R"(
 #version 330 core
 
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in mat4 aInst;
+layout (location = 1) in mat3x4 aInst;
 
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * aInst * vec4(aPos, 1.0);
+    // aInst columns are rows 0..2 of the model matrix: v * aInst == (model * v).xyz
+    gl_Position = projection * view * vec4(vec4(aPos, 1.0) * aInst, 1.0);
 }
 )"
@@ -3,7 +3,7 @@ R"(
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
-layout (location = 2) in mat4 aInst;
+layout (location = 2) in mat3x4 aInst;
 
 uniform mat4 view;
 uniform mat4 projection;
@@ -12,7 +12,8 @@ out vec2 TexCoord;
 
 void main()
 {
-    gl_Position = projection * view * aInst * vec4(aPos, 1.0);
+    // aInst columns are rows 0..2 of the model matrix: v * aInst == (model * v).xyz
+    gl_Position = projection * view * vec4(vec4(aPos, 1.0) * aInst, 1.0);
     TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
 )"
@@ -0,0 +1,348 @@
+// Built with -D__NO_USE_SIMD__ (see CMakeLists.txt)
+#ifndef __NO_USE_SIMD__
+#error "calc_scalar.cpp is the scalar reference; build it with -D__NO_USE_SIMD__"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Every calc name of this file moves to namespace calc_scalar: the templates
+// instantiated here without SIMD must not share symbols with the same
+// templates of the SIMD build they are compared to
+#define calc calc_scalar
+#include "calc/matrix.hpp"
+
+#include "calc_scalar.hpp"
+
+namespace {
+
+    /*! Helper
+     *! Calls f with std::integral_constant<unsigned, i>, i in 1..SHAPE_MAX
+     */
+    template <typename F,
+              unsigned... I>
+    void visit(const unsigned i, F f, std::integer_sequence<unsigned, I...>)
+    {
+        /**/ assert(i != 0 && i <= scalar::SHAPE_MAX);
+
+        const int expand[] = { (i == I + 1 ? (f(std::integral_constant<unsigned, I + 1>()), 0) : 0)... };
+        (void)expand;
+    }
+
+    /// @overload
+    template <typename F>
+    void visit(const unsigned i, F f) {
+        visit(i, f, std::make_integer_sequence<unsigned, scalar::SHAPE_MAX>());
+    }
+
+    /*! Helper
+     *! @return matrix holding the N * M values of in
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    calc::matrix<T, N, M> load(const T* in)
+    {
+        calc::matrix<T, N, M> out;
+        std::copy(in, in + N * M, calc::data(out));
+        return out;
+    }
+
+    /*! Helper
+     *! Copies the N * M values of m to out
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    void store(const calc::matrix<T, N, M>& m, T* out) {
+        std::copy(calc::data(m), calc::data(m) + N * M, out);
+    }
+
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    void elementwise(const T* a, const T* b, const T s, T* out)
+    {
+        const calc::matrix<T, N, M> x = load<T, N, M>(a);
+        const calc::matrix<T, N, M> y = load<T, N, M>(b);
+
+        calc::matrix<T, N, M> acc = x;
+        acc += y;
+        acc -= x;
+        acc *= s;
+        acc /= s;
+
+        store(x + y, out + scalar::OP_ADD * N * M);
+        store(x - y, out + scalar::OP_SUB * N * M);
+        store(x * s, out + scalar::OP_MUL_S * N * M);
+        store(x / s, out + scalar::OP_DIV_S * N * M);
+        store(s * x, out + scalar::OP_S_MUL * N * M);
+        store(-x, out + scalar::OP_NEG * N * M);
+        store(acc, out + scalar::OP_COMPOUND * N * M);
+    }
+
+    template <typename T,
+              unsigned N,
+              unsigned M,
+              unsigned M1>
+    void mul(const T* a, const T* b, T* out) {
+        store(load<T, N, M>(a) * load<T, M, M1>(b), out);
+    }
+
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    void mul_assign(T* a, const T* b)
+    {
+        calc::matrix<T, N, M> x = load<T, N, M>(a);
+        x *= load<T, M, M>(b);
+        store(x, a);
+    }
+}
+
+template <typename T>
+void scalar::elementwise(const unsigned n, const unsigned m, const T* a, const T* b, const T s, T* out)
+{
+    visit(n, [&](auto N) {
+        visit(m, [&](auto M) {
+            ::elementwise<T, decltype(N)::value, decltype(M)::value>(a, b, s, out);
+        });
+    });
+}
+
+template <typename T>
+void scalar::mul(const unsigned n, const unsigned m, const unsigned m1, const T* a, const T* b, T* out)
+{
+    visit(n, [&](auto N) {
+        visit(m, [&](auto M) {
+            visit(m1, [&](auto M1) {
+                ::mul<T, decltype(N)::value, decltype(M)::value, decltype(M1)::value>(a, b, out);
+            });
+        });
+    });
+}
+
+template <typename T>
+void scalar::mul_assign(const unsigned n, const unsigned m, T* a, const T* b)
+{
+    visit(n, [&](auto N) {
+        visit(m, [&](auto M) {
+            ::mul_assign<T, decltype(N)::value, decltype(M)::value>(a, b);
+        });
+    });
+}
+
+void scalar::transpose(const unsigned n, const unsigned m, const float* in, float* out)
+{
+    visit(n, [&](auto N) {
+        visit(m, [&](auto M) {
+            store(calc::transpose(load<float, decltype(N)::value, decltype(M)::value>(in)), out);
+        });
+    });
+}
+
+void scalar::transpose(const float* in, float* out, const std::size_t size)
+{
+    calc::transpose(reinterpret_cast<const calc::mat4f*>(in), reinterpret_cast<calc::mat4f*>(out), size);
+}
+
+template <typename T>
+T scalar::determinant(const unsigned n, const T* in)
+{
+    switch (n)
+    {
+        case 2: return calc::determinant(load<T, 2, 2>(in));
+        case 3: return calc::determinant(load<T, 3, 3>(in));
+        default:
+            /**/ assert(n == 4);
+            return calc::determinant(load<T, 4, 4>(in));
+    }
+}
+
+template <typename T>
+void scalar::inverse(const unsigned n, const T* in, T* out)
+{
+    switch (n)
+    {
+        case 2: store(calc::inverse(load<T, 2, 2>(in)), out); break;
+        case 3: store(calc::inverse(load<T, 3, 3>(in)), out); break;
+        default:
+            /**/ assert(n == 4);
+            store(calc::inverse(load<T, 4, 4>(in)), out);
+    }
+}
+
+void scalar::inverse_rigid(const float* in, float* out)
+{
+    store(calc::inverse_rigid(load<float, 4, 4>(in)), out);
+}
+
+void scalar::inverse_affine(const float* in, float* out)
+{
+    store(calc::inverse_affine(load<float, 4, 4>(in)), out);
+}
+
+float scalar::dot(const unsigned n, const float* a, const float* b)
+{
+    float out = 0;
+    visit(n, [&](auto N) {
+        out = calc::dot(load<float, decltype(N)::value, 1>(a), load<float, decltype(N)::value, 1>(b));
+    });
+
+    return out;
+}
+
+void scalar::cross(const float* a, const float* b, float* out)
+{
+    store(calc::cross(load<float, 3, 1>(a), load<float, 3, 1>(b)), out);
+}
+
+void scalar::normal(const unsigned n, const float* in, float* out, const bool fast)
+{
+    visit(n, [&](auto N) {
+        const calc::matrix<float, decltype(N)::value, 1> v = load<float, decltype(N)::value, 1>(in);
+        store(fast ? calc::normal_fast(v) : calc::normal(v), out);
+    });
+}
+
+void scalar::min_max(const unsigned n, const float* a, const float* b, float* out, const bool greater)
+{
+    visit(n, [&](auto N) {
+        const calc::matrix<float, decltype(N)::value, 1> x = load<float, decltype(N)::value, 1>(a);
+        const calc::matrix<float, decltype(N)::value, 1> y = load<float, decltype(N)::value, 1>(b);
+        store(greater ? calc::max(x, y) : calc::min(x, y), out);
+    });
+}
+
+void scalar::abs(const unsigned n, const unsigned m, const float* in, float* out)
+{
+    visit(n, [&](auto N) {
+        visit(m, [&](auto M) {
+            store(calc::abs(load<float, decltype(N)::value, decltype(M)::value>(in)), out);
+        });
+    });
+}
+
+void scalar::dot(const unsigned n, const float* a, const float* b, float* out, const std::size_t size)
+{
+    if (n == 3) {
+        calc::dot(reinterpret_cast<const calc::vec3f*>(a), reinterpret_cast<const calc::vec3f*>(b), out, size);
+    }
+    else {
+        calc::dot(reinterpret_cast<const calc::vec4f*>(a), reinterpret_cast<const calc::vec4f*>(b), out, size);
+    }
+}
+
+void scalar::normal(const unsigned n, const float* in, float* out, const std::size_t size, const bool fast)
+{
+    if (n == 3)
+    {
+        const calc::vec3f* v = reinterpret_cast<const calc::vec3f*>(in);
+        calc::vec3f* o = reinterpret_cast<calc::vec3f*>(out);
+        fast ? calc::normal_fast(v, o, size) : calc::normal(v, o, size);
+    }
+
+    else
+    {
+        const calc::vec4f* v = reinterpret_cast<const calc::vec4f*>(in);
+        calc::vec4f* o = reinterpret_cast<calc::vec4f*>(out);
+        fast ? calc::normal_fast(v, o, size) : calc::normal(v, o, size);
+    }
+}
+
+void scalar::transform(const transform_op op, const float* m, const float* in, float* out, const std::size_t size)
+{
+    const calc::mat4f mat = load<float, 4, 4>(m);
+
+    const calc::vec3f* v = reinterpret_cast<const calc::vec3f*>(in);
+    calc::vec3f* o = reinterpret_cast<calc::vec3f*>(out);
+
+    switch (op)
+    {
+        case TRANSFORM_POINTS: calc::transform_points(mat, v, o, size); break;
+        case TRANSFORM_DIRS: calc::transform_dirs(mat, v, o, size); break;
+        case PROJECT_POINTS: calc::project_points(mat, v, o, size); break;
+        case TRANSFORM_VEC4:
+            calc::transform_points(mat, reinterpret_cast<const calc::vec4f*>(in), reinterpret_cast<calc::vec4f*>(out), size);
+            break;
+    }
+}
+
+void scalar::sincos(const float* rad, float* s, float* c, const std::size_t size)
+{
+    calc::sincos(rad, s, c, size);
+}
+
+void scalar::compose(const float* const t[3], const float* const r[3], const float* const s[3], float* out, const std::size_t size)
+{
+    calc::mat4f_array m(size);
+    m.compose(t, r, s);
+
+    for (std::size_t i = 0; i != size; ++i)
+        store(m.get(i), out + i * 16);
+}
+
+void scalar::quat(const quat_op op, const float* a, const float* b, const float t, float* out)
+{
+    const calc::quatf x(a[0], a[1], a[2], a[3]);
+    const calc::quatf y(b[0], b[1], b[2], b[3]);
+
+    calc::quatf q;
+    switch (op)
+    {
+        case QUAT_MUL: q = x * y; break;
+        case QUAT_NORMAL: q = calc::normal(x); break;
+        case QUAT_NLERP: q = calc::nlerp(x, y, t); break;
+        default:
+            /**/ assert(op == QUAT_SLERP);
+            q = calc::slerp(x, y, t);
+    }
+
+    std::copy(calc::data(q), calc::data(q) + 4, out);
+}
+
+void scalar::quat_from_axis_angle(const float* axis, const float rad, float* out)
+{
+    const calc::quatf q = calc::quatf::from_axis_angle(load<float, 3, 1>(axis), rad);
+    std::copy(calc::data(q), calc::data(q) + 4, out);
+}
+
+void scalar::quat_from_euler(const float x, const float y, const float z, float* out)
+{
+    const calc::quatf q = calc::quatf::from_euler(x, y, z);
+    std::copy(calc::data(q), calc::data(q) + 4, out);
+}
+
+void scalar::quat_to_mat4(const float* q, float* out)
+{
+    store(calc::to_mat4(calc::quatf(q[0], q[1], q[2], q[3])), out);
+}
+
+void scalar::quat_rotate(const float* q, const float* v, float* out)
+{
+    store(calc::rotate(calc::quatf(q[0], q[1], q[2], q[3]), load<float, 3, 1>(v)), out);
+}
+
+void scalar::gemm(const float* a, const float* b, float* c, const std::size_t n, const std::size_t k, const std::size_t m)
+{
+    calc::gemm(a, b, c, n, k, m, 1);
+}
+
+template void scalar::elementwise<float>(unsigned, unsigned, const float*, const float*, float, float*);
+template void scalar::elementwise<double>(unsigned, unsigned, const double*, const double*, double, double*);
+template void scalar::mul<float>(unsigned, unsigned, unsigned, const float*, const float*, float*);
+template void scalar::mul<double>(unsigned, unsigned, unsigned, const double*, const double*, double*);
+template void scalar::mul_assign<float>(unsigned, unsigned, float*, const float*);
+template void scalar::mul_assign<double>(unsigned, unsigned, double*, const double*);
+template float scalar::determinant<float>(unsigned, const float*);
+template double scalar::determinant<double>(unsigned, const double*);
+template void scalar::inverse<float>(unsigned, const float*, float*);
+template void scalar::inverse<double>(unsigned, const double*, double*);
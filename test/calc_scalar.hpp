@@ -0,0 +1,124 @@
+#pragma once
+
+#ifndef CALC_SCALAR_HPP
+#define CALC_SCALAR_HPP
+
+#include <cstddef>
+
+/*! The calc operators as the __NO_USE_SIMD__ build computes them
+ *! (calc_scalar.cpp), the reference the SIMD backends are tested against.
+ *! Matrices are passed as their n * m values in row-major order, without
+ *! padding; shapes run from 1x1 to SHAPE_MAX x SHAPE_MAX. Arrays of vec3f
+ *! and vec4f are passed as 4 floats per vector, as they are stored
+ */
+namespace scalar {
+
+    /// Largest row and column count of the shapes built
+    static const unsigned SHAPE_MAX = 8;
+
+    /// enum elementwise_op
+    /*! Results of elementwise(), one block of n * m values each
+     */
+    enum elementwise_op {
+        OP_ADD,      //> a + b
+        OP_SUB,      //> a - b
+        OP_MUL_S,    //> a * s
+        OP_DIV_S,    //> a / s
+        OP_S_MUL,    //> s * a
+        OP_NEG,      //> -a
+        OP_COMPOUND, //> a, then += b, -= a, *= s, /= s
+        OP_COUNT
+    };
+
+    /// @param out OP_COUNT blocks of n * m values
+    template <typename T>
+    void elementwise(unsigned n, unsigned m, const T* a, const T* b, T s, T* out);
+
+    /// out = a * b, a n x m and b m x m1
+    template <typename T>
+    void mul(unsigned n, unsigned m, unsigned m1, const T* a, const T* b, T* out);
+
+    /// a *= b, a n x m and b m x m
+    template <typename T>
+    void mul_assign(unsigned n, unsigned m, T* a, const T* b);
+
+    /// out = transpose(in), in n x m
+    void transpose(unsigned n, unsigned m, const float* in, float* out);
+    /// Batched 4x4 transpose, 16 floats per matrix; out may alias in
+    void transpose(const float* in, float* out, std::size_t size);
+
+    /// @return determinant of the n x n matrix in, n in 2..4
+    template <typename T>
+    T determinant(unsigned n, const T* in);
+    /// out = inverse(in), in n x n, n in 2..4
+    template <typename T>
+    void inverse(unsigned n, const T* in, T* out);
+    /// out = inverse_rigid(in), in 4x4
+    void inverse_rigid(const float* in, float* out);
+    /// out = inverse_affine(in), in 4x4
+    void inverse_affine(const float* in, float* out);
+
+    /// @return dot(a, b), vectors of n in 1..SHAPE_MAX
+    float dot(unsigned n, const float* a, const float* b);
+    /// out = cross(a, b), vec3f
+    void cross(const float* a, const float* b, float* out);
+    /// out = normal(in), or normal_fast(in) if fast
+    void normal(unsigned n, const float* in, float* out, bool fast);
+    /// out = min(a, b), or max(a, b) if greater
+    void min_max(unsigned n, const float* a, const float* b, float* out, bool greater);
+    /// out = abs(in), in n x m
+    void abs(unsigned n, unsigned m, const float* in, float* out);
+
+    /// Batched dot of size vectors of n (3 or 4)
+    void dot(unsigned n, const float* a, const float* b, float* out, std::size_t size);
+    /// Batched normal or normal_fast of size vectors of n (3 or 4); out may
+    /// alias in
+    void normal(unsigned n, const float* in, float* out, std::size_t size, bool fast);
+
+    /// enum transform_op
+    /*! Batched transforms of arrays of vectors through a 4x4 matrix
+     */
+    enum transform_op {
+        TRANSFORM_POINTS, //> transform_points, vec3f
+        TRANSFORM_DIRS,   //> transform_dirs
+        PROJECT_POINTS,   //> project_points
+        TRANSFORM_VEC4    //> transform_points, vec4f
+    };
+
+    /// out = op(m, in) over size vectors; out may alias in
+    void transform(transform_op op, const float* m, const float* in, float* out, std::size_t size);
+
+    /// s[i], c[i] = sincos(rad[i]) for i < size
+    void sincos(const float* rad, float* s, float* c, std::size_t size);
+
+    /// out = mat4f_array::compose(t, r, s) over size matrices, 16 floats
+    /// each as mat4f_array::get() returns them; r and s may be null
+    void compose(const float* const t[3], const float* const r[3], const float* const s[3], float* out, std::size_t size);
+
+    /// enum quat_op
+    /*! quatf operators; quaternions are passed as (x, y, z, w)
+     */
+    enum quat_op {
+        QUAT_MUL,    //> a * b
+        QUAT_NORMAL, //> normal(a)
+        QUAT_NLERP,  //> nlerp(a, b, t)
+        QUAT_SLERP,  //> slerp(a, b, t)
+        QUAT_COUNT
+    };
+
+    /// out = op(a, b, t), 4 floats
+    void quat(quat_op op, const float* a, const float* b, float t, float* out);
+    /// out = quatf::from_axis_angle(axis, rad)
+    void quat_from_axis_angle(const float* axis, float rad, float* out);
+    /// out = quatf::from_euler(x, y, z)
+    void quat_from_euler(float x, float y, float z, float* out);
+    /// out = to_mat4(q), 16 floats
+    void quat_to_mat4(const float* q, float* out);
+    /// out = rotate(q, v), v and out 3 floats
+    void quat_rotate(const float* q, const float* v, float* out);
+
+    /// c = a * b, a n x k and b k x m, unpadded
+    void gemm(const float* a, const float* b, float* c, std::size_t n, std::size_t k, std::size_t m);
+}
+
+#endif
@@ -0,0 +1,996 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+#include "calc/matrix.hpp"
+#include "calc/simd/schur_mul.hpp"
+
+#include "calc_scalar.hpp"
+
+namespace {
+
+    // Number of comparisons made on the active backend
+    std::size_t checks = 0;
+
+    /*! Helper
+     *! Fills matrix with values in [-1, 1)
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    void fill(calc::matrix<T, N, M>& m)
+    {
+        T* d = calc::data(m);
+        for (unsigned i = 0; i != N * M; ++i)
+            d[i] = (std::rand() % 2000) / T(1000) - 1;
+    }
+
+    /*! Helper
+     *! Compares one result of the active backend with the scalar build
+     *! @return 1 if they differ by more than tol, 0 otherwise
+     */
+    template <typename T>
+    unsigned compare(const char* op, const char* shape, const unsigned i, const T value, const T expected, const T tol)
+    {
+        ++checks;
+        // Equal infinities differ by NaN; NaN matches NaN
+        if (value == expected || std::fabs(value - expected) <= tol || (value != value && expected != expected)) {
+            return 0;
+        }
+
+        printf("check %s: %s %s [%u] = %.9g, expected %.9g\n",
+               calc::get_backend_name(calc::get_backend()), op, shape, i, double(value), double(expected));
+        return 1;
+    }
+
+    /*! Helper
+     *! Checks that a result left the padding past N * M untouched (zero)
+     *! @return number of failures
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    unsigned compare_padding(const char* op, const char* shape, const calc::matrix<T, N, M>& m)
+    {
+        unsigned failures = 0;
+        for (unsigned i = N * M; i != sizeof(m) / sizeof(T); ++i)
+            failures += compare<T>(op, shape, i, calc::data(m)[i], 0, 0);
+        return failures;
+    }
+
+    /*! Helper
+     *! Operators that only move values or clear signs, transpose and abs;
+     *! results must match the scalar build exactly
+     *! @return number of failures
+     */
+    template <unsigned N,
+              unsigned M>
+    unsigned check_moves(const calc::matrix<float, N, M>& a, const char* shape)
+    {
+        const calc::matrix<float, M, N> t = calc::transpose(a);
+        const calc::matrix<float, N, M> abs = calc::abs(a);
+
+        float expected[N * M], expectedAbs[N * M];
+        scalar::transpose(N, M, calc::data(a), expected);
+        scalar::abs(N, M, calc::data(a), expectedAbs);
+
+        unsigned failures = 0;
+        for (unsigned i = 0; i != N * M; ++i)
+        {
+            failures += compare<float>("transpose", shape, i, calc::data(t)[i], expected[i], 0);
+            failures += compare<float>("abs", shape, i, calc::data(abs)[i], expectedAbs[i], 0);
+        }
+
+        return failures + compare_padding("transpose", shape, t) + compare_padding("abs", shape, abs);
+    }
+
+    /// @overload
+    /// Double transpose and abs are the same templates in both builds
+    template <unsigned N,
+              unsigned M>
+    unsigned check_moves(const calc::matrix<double, N, M>&, const char*) {
+        return 0;
+    }
+
+    /*! Helper
+     *! Elementwise operators of one shape; these round once per element, so
+     *! results must match the scalar build exactly
+     *! @return number of failures
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    unsigned check_elementwise()
+    {
+        calc::matrix<T, N, M> a, b;
+        fill(a);
+        fill(b);
+
+        const T s = (std::rand() % 1000) / T(1000) + T(0.5);
+
+        char shape[16];
+        snprintf(shape, sizeof(shape), "%ux%u%s", N, M, sizeof(T) == sizeof(double) ? "d" : "");
+
+        calc::matrix<T, N, M> acc = a;
+        acc += b;
+        acc -= a;
+        acc *= s;
+        acc /= s;
+
+        const calc::matrix<T, N, M> results[scalar::OP_COUNT] = { a + b, a - b, a * s, a / s, s * a, -a, acc };
+        const char* names[scalar::OP_COUNT] = { "add", "sub", "mul s", "div s", "s mul", "neg", "compound" };
+
+        T expected[scalar::OP_COUNT * N * M];
+        scalar::elementwise<T>(N, M, calc::data(a), calc::data(b), s, expected);
+
+        unsigned failures = 0;
+        for (unsigned op = 0; op != scalar::OP_COUNT; ++op)
+        {
+            for (unsigned i = 0; i != N * M; ++i)
+                failures += compare<T>(names[op], shape, i, calc::data(results[op])[i], expected[op * N * M + i], 0);
+            failures += compare_padding(names[op], shape, results[op]);
+        }
+
+        return failures + check_moves(a, shape);
+    }
+
+    /*! Helper
+     *! The NxM * MxM1 product, and *= by an MxM matrix; the kernels may
+     *! reassociate the sums and fuse multiply-adds, so each element may
+     *! differ from the scalar build by a few ulp of the sum of |products|
+     *! @return number of failures
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M,
+              unsigned M1>
+    unsigned check_mul()
+    {
+        calc::matrix<T, N, M> a;
+        calc::matrix<T, M, M1> b;
+        calc::matrix<T, M, M> c;
+        fill(a);
+        fill(b);
+        fill(c);
+
+        char shape[32];
+        snprintf(shape, sizeof(shape), "%ux%u * %ux%u%s", N, M, M, M1, sizeof(T) == sizeof(double) ? "d" : "");
+
+        const calc::matrix<T, N, M1> out = a * b;
+
+        calc::matrix<T, N, M> acc = a;
+        acc *= c;
+
+        T expected[N * M1];
+        scalar::mul<T>(N, M, M1, calc::data(a), calc::data(b), expected);
+
+        T expectedAcc[N * M];
+        std::copy(calc::data(a), calc::data(a) + N * M, expectedAcc);
+        scalar::mul_assign<T>(N, M, expectedAcc, calc::data(c));
+
+        // |a| and |b|, |c| are below one
+        const T tol = 4 * M * M * std::numeric_limits<T>::epsilon();
+
+        unsigned failures = 0;
+        for (unsigned i = 0; i != N * M1; ++i)
+            failures += compare<T>("mul", shape, i, calc::data(out)[i], expected[i], tol);
+        for (unsigned i = 0; i != N * M; ++i)
+            failures += compare<T>("mul=", shape, i, calc::data(acc)[i], expectedAcc[i], tol);
+
+        failures += compare_padding("mul", shape, out);
+        failures += compare_padding("mul=", shape, acc);
+
+        return failures;
+    }
+
+    /*! Helper
+     *! The NxN * NxM1 product with an infinity at each element of the left
+     *! side in turn: only the output row holding it may turn non-finite, as
+     *! in the scalar build, however the kernel loads its rows
+     *! @return number of failures
+     */
+    template <unsigned N,
+              unsigned M1>
+    unsigned check_non_finite()
+    {
+        char shape[32];
+        snprintf(shape, sizeof(shape), "%ux%u * %ux%u inf", N, N, N, M1);
+
+        calc::matrix<float, N, M1> b;
+        fill(b);
+
+        unsigned failures = 0;
+        for (unsigned i = 0; i != N * N; ++i)
+        {
+            calc::matrix<float, N, N> a;
+            fill(a);
+            calc::data(a)[i] = std::numeric_limits<float>::infinity();
+
+            const calc::matrix<float, N, M1> out = a * b;
+
+            float expected[N * M1];
+            scalar::mul<float>(N, N, M1, calc::data(a), calc::data(b), expected);
+
+            for (unsigned j = 0; j != N * M1; ++j)
+                failures += compare<float>("mul", shape, j, calc::data(out)[j], expected[j], 4 * N * N * std::numeric_limits<float>::epsilon());
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Lazy elementwise expressions of one shape against the eager operators,
+     *! which the scalar build is checked against above; each node rounds once
+     *! per element, so results must match exactly. Infinite and zero scales
+     *! turn the values non-finite but must leave the padding zero
+     *! @return number of failures
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M>
+    unsigned check_lazy()
+    {
+        calc::matrix<T, N, M> a, b;
+        fill(a);
+        fill(b);
+
+        char shape[16];
+        snprintf(shape, sizeof(shape), "%ux%u%s", N, M, sizeof(T) == sizeof(double) ? "d" : "");
+
+        const T scales[] = { (std::rand() % 1000) / T(1000) + T(0.5), std::numeric_limits<T>::infinity(), 0 };
+
+        unsigned failures = 0;
+        for (const T s : scales)
+        {
+            const calc::matrix<T, N, M> results[] = {
+                calc::lazy(a) * s, s * calc::lazy(a), calc::lazy(a) / s, -calc::lazy(a), (calc::lazy(a) + b) / s, (calc::lazy(a) - b) * s
+            };
+            const calc::matrix<T, N, M> expected[] = { a * s, s * a, a / s, -a, (a + b) / s, (a - b) * s };
+            const char* names[] = { "lazy mul s", "lazy s mul", "lazy div s", "lazy neg", "lazy add div s", "lazy sub mul s" };
+
+            for (unsigned op = 0; op != sizeof(names) / sizeof(names[0]); ++op)
+            {
+                for (unsigned i = 0; i != N * M; ++i)
+                    failures += compare<T>(names[op], shape, i, calc::data(results[op])[i], calc::data(expected[op])[i], 0);
+                failures += compare_padding(names[op], shape, results[op]);
+            }
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Checks all products NxM * MxM1 for M1 in 1..8
+     */
+    template <typename T,
+              unsigned N,
+              unsigned M,
+              unsigned... M1>
+    unsigned check_products(std::integer_sequence<unsigned, M1...>)
+    {
+        unsigned failures = 0;
+        const unsigned expand[] = { (failures += check_mul<T, N, M, M1 + 1>())... };
+        (void)expand;
+        return failures;
+    }
+
+    /*! Helper
+     *! Checks all shapes NxM for M in 1..8
+     */
+    template <typename T,
+              unsigned N,
+              unsigned... M>
+    unsigned check_row(std::integer_sequence<unsigned, M...>)
+    {
+        unsigned failures = 0;
+        const unsigned expand[] = {
+            (failures += check_elementwise<T, N, M + 1>()
+                       + check_lazy<T, N, M + 1>()
+                       + check_products<T, N, M + 1>(std::make_integer_sequence<unsigned, scalar::SHAPE_MAX>()))...
+        };
+        (void)expand;
+        return failures;
+    }
+
+    /*! Helper
+     *! Checks all shapes NxM for N in 1..8
+     */
+    template <typename T,
+              unsigned... N>
+    unsigned check_shapes(std::integer_sequence<unsigned, N...>)
+    {
+        unsigned failures = 0;
+        const unsigned expand[] = { (failures += check_row<T, N + 1>(std::make_integer_sequence<unsigned, scalar::SHAPE_MAX>()))... };
+        (void)expand;
+        return failures;
+    }
+
+    /*! Helper
+     *! Vector operators of length N: dot, normal, normal_fast, min and max,
+     *! and cross for N = 3; dot and normal sum in a different order, and
+     *! normal_fast starts from a reciprocal square root estimate
+     *! @return number of failures
+     */
+    template <unsigned N>
+    unsigned check_vector()
+    {
+        calc::matrix<float, N, 1> a, b;
+        fill(a);
+        fill(b);
+
+        char shape[16];
+        snprintf(shape, sizeof(shape), "%ux1", N);
+
+        const float tol = 4 * N * std::numeric_limits<float>::epsilon();
+
+        unsigned failures = 0;
+        failures += compare<float>("dot", shape, 0, calc::dot(a, b), scalar::dot(N, calc::data(a), calc::data(b)), tol);
+
+        const calc::matrix<float, N, 1> results[4] = { calc::normal(a), calc::normal_fast(a), calc::min(a, b), calc::max(a, b) };
+        const char* names[4] = { "normal", "normal_fast", "min", "max" };
+        const float tols[4] = { tol, 4 * tol, 0, 0 };
+
+        float expected[4][N];
+        scalar::normal(N, calc::data(a), expected[0], false);
+        scalar::normal(N, calc::data(a), expected[1], true);
+        scalar::min_max(N, calc::data(a), calc::data(b), expected[2], false);
+        scalar::min_max(N, calc::data(a), calc::data(b), expected[3], true);
+
+        for (unsigned op = 0; op != 4; ++op)
+        {
+            for (unsigned i = 0; i != N; ++i)
+                failures += compare<float>(names[op], shape, i, calc::data(results[op])[i], expected[op][i], tols[op]);
+            failures += compare_padding(names[op], shape, results[op]);
+        }
+
+        if (N == 3)
+        {
+            const calc::vec3f x(calc::data(a)[0], calc::data(a)[1], calc::data(a)[2]);
+            const calc::vec3f y(calc::data(b)[0], calc::data(b)[1], calc::data(b)[2]);
+            const calc::vec3f c = calc::cross(x, y);
+
+            float expectedCross[3];
+            scalar::cross(calc::data(x), calc::data(y), expectedCross);
+            for (unsigned i = 0; i != 3; ++i)
+                failures += compare<float>("cross", shape, i, c[i], expectedCross[i], 0);
+            failures += compare_padding("cross", shape, c);
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Checks vector operators for N in 1..8
+     */
+    template <unsigned... N>
+    unsigned check_vectors(std::integer_sequence<unsigned, N...>)
+    {
+        unsigned failures = 0;
+        const unsigned expand[] = { (failures += check_vector<N + 1>())... };
+        (void)expand;
+        return failures;
+    }
+
+    /*! Helper
+     *! Batched dot, normal and normal_fast over vec3f and vec4f arrays of
+     *! every length up to 37, in place, with a canary past the end
+     *! @return number of failures
+     */
+    template <unsigned N>
+    unsigned check_batched()
+    {
+        typedef calc::matrix<float, N, 1> vec;
+
+        const std::size_t count = 37;
+        vec a[count + 1], b[count + 1], out[count + 1], same[count];
+        float dots[count + 1];
+        for (std::size_t i = 0; i != count; ++i)
+        {
+            fill(a[i]);
+            fill(b[i]);
+        }
+
+        const char* shape = (N == 3) ? "vec3[]" : "vec4[]";
+        const float tol = 4 * N * std::numeric_limits<float>::epsilon();
+
+        unsigned failures = 0;
+        for (std::size_t size = 0; size <= count; ++size)
+        {
+            float expectedDots[count];
+            scalar::dot(N, calc::data(a[0]), calc::data(b[0]), expectedDots, size);
+
+            dots[size] = 7;
+            calc::dot(a, b, dots, size);
+            for (std::size_t i = 0; i != size; ++i)
+                failures += compare<float>("dot[]", shape, unsigned(i), dots[i], expectedDots[i], tol);
+            failures += compare<float>("dot[] canary", shape, unsigned(size), dots[size], 7, 0);
+
+            for (unsigned fast = 0; fast != 2; ++fast)
+            {
+                const char* name = fast ? "normal_fast[]" : "normal[]";
+
+                vec expected[count];
+                scalar::normal(N, calc::data(a[0]), calc::data(expected[0]), size, fast);
+
+                std::copy(a, a + size, same);
+                out[size] = vec(7);
+                if (fast)
+                {
+                    calc::normal_fast(a, out, size);
+                    calc::normal_fast(same, same, size);
+                }
+                else
+                {
+                    calc::normal(a, out, size);
+                    calc::normal(same, same, size);
+                }
+
+                for (std::size_t i = 0; i != size; ++i)
+                {
+                    for (unsigned j = 0; j != 4; ++j)
+                    {
+                        const float e = calc::data(expected[i])[j];
+                        failures += compare<float>(name, shape, unsigned(i * 4 + j), calc::data(out[i])[j], e, fast ? 4 * tol : tol);
+                        failures += compare<float>(name, "in place", unsigned(i * 4 + j), calc::data(same[i])[j], calc::data(out[i])[j], 0);
+                    }
+                }
+
+                failures += compare<float>(name, "canary", unsigned(size), out[size][0], 7, 0);
+            }
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Single and batched 4x4 transposes, in place too; transposing only
+     *! moves values, so they must match the scalar build exactly
+     *! @return number of failures
+     */
+    unsigned check_transpose()
+    {
+        const std::size_t size = 7;
+        calc::mat4f in[size], out[size], same[size], expected[size];
+        for (std::size_t k = 0; k != size; ++k)
+        {
+            fill(in[k]);
+            same[k] = in[k];
+        }
+
+        calc::transpose(in, out, size);
+        calc::transpose(same, same, size);
+        scalar::transpose(calc::data(in[0]), calc::data(expected[0]), size);
+
+        unsigned failures = 0;
+        for (std::size_t k = 0; k != size; ++k)
+        {
+            const calc::mat4f one = calc::transpose(in[k]);
+            for (unsigned i = 0; i != 16; ++i)
+            {
+                const float e = calc::data(expected[k])[i];
+                failures += compare<float>("transpose", "4x4", i, calc::data(one)[i], e, 0);
+                failures += compare<float>("transpose[]", "4x4", i, calc::data(out[k])[i], e, 0);
+                failures += compare<float>("transpose[] in place", "4x4", i, calc::data(same[k])[i], e, 0);
+            }
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Inverses and determinants of well-conditioned matrices; the SIMD 4x4
+     *! inverse works from 2x2 blocks, so it rounds differently
+     *! @return number of failures
+     */
+    template <typename T,
+              unsigned N>
+    unsigned check_inverse(const T tol)
+    {
+        char shape[16];
+        snprintf(shape, sizeof(shape), "%ux%u%s", N, N, sizeof(T) == sizeof(double) ? "d" : "");
+
+        unsigned failures = 0;
+        for (unsigned k = 0; k != 16; ++k)
+        {
+            // Diagonally dominant, so well conditioned
+            calc::matrix<T, N, N> m;
+            fill(m);
+            for (unsigned i = 0; i != N; ++i)
+                m(i, i) += 4;
+
+            const calc::matrix<T, N, N> inv = calc::inverse(m);
+            const T det = calc::determinant(m);
+
+            T expected[N * N];
+            scalar::inverse<T>(N, calc::data(m), expected);
+            const T expectedDet = scalar::determinant<T>(N, calc::data(m));
+
+            for (unsigned i = 0; i != N * N; ++i)
+                failures += compare<T>("inverse", shape, i, calc::data(inv)[i], expected[i], tol);
+            failures += compare_padding("inverse", shape, inv);
+            failures += compare<T>("determinant", shape, k, det, expectedDet, tol * std::fabs(expectedDet));
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Rigid and affine 4x4 inverses of model matrices
+     *! @return number of failures
+     */
+    unsigned check_inverse_affine()
+    {
+        unsigned failures = 0;
+        for (unsigned k = 0; k != 16; ++k)
+        {
+            // Rotation, then scale and translation
+            calc::affine3f a = calc::to_affine(calc::quatf::from_euler(0.3f * k, 0.2f * k, 0.1f * k));
+            for (unsigned r = 0; r != 3; ++r)
+                a(r, 3) = (std::rand() % 2000) / 100.0f - 10;
+
+            const calc::mat4f rigid = a.to_mat4();
+
+            for (unsigned r = 0; r != 3; ++r)
+                for (unsigned c = 0; c != 3; ++c)
+                    a(r, c) *= 1 + r;
+
+            const calc::mat4f scaled = a.to_mat4();
+
+            const calc::mat4f rigidInv = calc::inverse_rigid(rigid);
+            const calc::mat4f affineInv = calc::inverse_affine(scaled);
+
+            float expectedRigid[16], expectedAffine[16];
+            scalar::inverse_rigid(calc::data(rigid), expectedRigid);
+            scalar::inverse_affine(calc::data(scaled), expectedAffine);
+
+            for (unsigned i = 0; i != 16; ++i)
+            {
+                failures += compare<float>("inverse_rigid", "4x4", i, calc::data(rigidInv)[i], expectedRigid[i], 1e-5f);
+                failures += compare<float>("inverse_affine", "4x4", i, calc::data(affineInv)[i], expectedAffine[i], 1e-5f);
+            }
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! quatf against the scalar build: construction, the Hamilton product,
+     *! normal, nlerp and slerp (endpoints, the shorter arc and the nearly
+     *! parallel fallback), to_mat4 and rotate; to_mat4 is also checked
+     *! against the Euler chain it replaces and against the product
+     *! @return number of failures
+     */
+    unsigned check_quat()
+    {
+        static const float tol = 1e-6f;
+        static const float pi = 3.14159265f;
+
+        const char* names[scalar::QUAT_COUNT] = { "quat mul", "quat normal", "nlerp", "slerp" };
+
+        unsigned failures = 0;
+        auto check4 = [&](const char* op, const char* shape, const calc::quatf& q, const float* e) {
+            for (unsigned i = 0; i != 4; ++i)
+                failures += compare<float>(op, shape, i, q[i], e[i], tol);
+        };
+
+        for (unsigned k = 0; k != 64; ++k)
+        {
+            const float ex = (std::rand() % 2000) / 1000.0f * pi - pi;
+            const float ey = (std::rand() % 2000) / 1000.0f * pi - pi;
+            const float ez = (std::rand() % 2000) / 1000.0f * pi - pi;
+            const float rad = (std::rand() % 2000) / 1000.0f * pi - pi;
+            const float t = (std::rand() % 1001) / 1000.0f;
+
+            calc::vec3f axis, v;
+            fill(axis);
+            fill(v);
+            axis[k % 3] += 2;
+
+            float expected[16];
+
+            const calc::quatf a = calc::quatf::from_euler(ex, ey, ez);
+            scalar::quat_from_euler(ex, ey, ez, expected);
+            check4("from_euler", "quat", a, expected);
+
+            const calc::quatf b = calc::quatf::from_axis_angle(axis, rad);
+            scalar::quat_from_axis_angle(calc::data(axis), rad, expected);
+            check4("from_axis_angle", "quat", b, expected);
+
+            // Nearly parallel to a, within the slerp fallback, and a non-unit
+            // quaternion for normal
+            const calc::quatf near = calc::normal(calc::quatf(a[0] + 1e-3f, a[1], a[2] - 1e-3f, a[3]));
+            const calc::quatf scaled(2 * a[0] + 0.5f, 2 * a[1], 2 * a[2], 2 * a[3]);
+
+            const calc::quatf* pairs[][2] = { { &a, &b }, { &b, &a }, { &a, &near }, { &scaled, &b } };
+            const char* shapes[] = { "a, b", "b, a", "near", "scaled" };
+
+            for (unsigned p = 0; p != 4; ++p)
+            {
+                const calc::quatf& x = *pairs[p][0];
+                const calc::quatf& y = *pairs[p][1];
+
+                const calc::quatf results[scalar::QUAT_COUNT] = { x * y, calc::normal(x), calc::nlerp(x, y, t), calc::slerp(x, y, t) };
+                for (unsigned op = 0; op != scalar::QUAT_COUNT; ++op)
+                {
+                    // Interpolation is defined between unit quaternions
+                    if (p == 3 && op >= scalar::QUAT_NLERP) {
+                        continue;
+                    }
+
+                    scalar::quat(static_cast<scalar::quat_op>(op), calc::data(x), calc::data(y), t, expected);
+                    check4(names[op], shapes[p], results[op], expected);
+                }
+            }
+
+            // The fallback is nlerp itself, exactly; without it, slerp of
+            // parallel quaternions divides by sin(0)
+            const calc::quatf fallback = calc::slerp(a, near, t);
+            const calc::quatf blend = calc::nlerp(a, near, t);
+            for (unsigned i = 0; i != 4; ++i)
+                failures += compare<float>("slerp", "near = nlerp", i, fallback[i], blend[i], 0);
+            check4("slerp", "a, a", calc::slerp(a, a, t), calc::data(a));
+
+            // Endpoints, and the shorter arc whatever the sign of b
+            const calc::quatf negated(-b[0], -b[1], -b[2], -b[3]);
+            const float sign = (calc::dot(a, b) < 0) ? -1 : 1;
+            const calc::quatf end(sign * b[0], sign * b[1], sign * b[2], sign * b[3]);
+
+            check4("slerp", "t = 0", calc::slerp(a, b, 0), calc::data(a));
+            check4("slerp", "t = 1", calc::slerp(a, b, 1), calc::data(end));
+            check4("nlerp", "t = 0", calc::nlerp(a, b, 0), calc::data(a));
+            check4("nlerp", "t = 1", calc::nlerp(a, b, 1), calc::data(end));
+            check4("slerp", "-b", calc::slerp(a, negated, t), calc::data(calc::slerp(a, b, t)));
+
+            // to_mat4 and rotate
+            const calc::mat4f m = calc::to_mat4(a);
+            scalar::quat_to_mat4(calc::data(a), expected);
+            for (unsigned i = 0; i != 16; ++i)
+                failures += compare<float>("to_mat4", "quat", i, calc::data(m)[i], expected[i], tol);
+
+            const calc::vec3f r = calc::rotate(b, v);
+            scalar::quat_rotate(calc::data(b), calc::data(v), expected);
+            for (unsigned i = 0; i != 3; ++i)
+                failures += compare<float>("rotate", "quat", i, r[i], expected[i], 4 * tol);
+
+            const calc::mat4f chain = calc::rotate_4x(ex) * calc::rotate_4y(ey) * calc::rotate_4z(ez);
+            const calc::mat4f product = calc::to_mat4(a) * calc::to_mat4(b);
+            const calc::mat4f composed = calc::to_mat4(a * b);
+            for (unsigned i = 0; i != 16; ++i)
+            {
+                failures += compare<float>("to_mat4", "euler chain", i, calc::data(m)[i], calc::data(chain)[i], 1e-5f);
+                failures += compare<float>("to_mat4", "a * b", i, calc::data(composed)[i], calc::data(product)[i], 1e-5f);
+            }
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Batched point, direction and projection transforms for every length
+     *! up to 37, in place, with a canary past the end
+     *! @return number of failures
+     */
+    unsigned check_transform_points()
+    {
+        // w = m(3, .) * (x, y, z, 1) >= 1 for |x|, |y|, |z| <= 1
+        calc::mat4f m;
+        fill(m);
+        m(3, 3) += 4;
+
+        const std::size_t count = 37;
+        calc::vec3f in[count + 1], out[count + 1], same[count], expected[count];
+        calc::vec4f in4[count + 1], out4[count + 1], expected4[count];
+        for (std::size_t i = 0; i != count; ++i)
+        {
+            fill(in[i]);
+            fill(in4[i]);
+        }
+
+        const char* names[] = { "transform_points", "transform_dirs", "project_points", "transform_points vec4" };
+
+        unsigned failures = 0;
+        for (unsigned mode = 0; mode != 4; ++mode)
+        {
+            const scalar::transform_op op = static_cast<scalar::transform_op>(mode);
+
+            for (std::size_t size = 0; size <= count; ++size)
+            {
+                out[size] = calc::vec3f(7, 7, 7);
+                out4[size] = calc::vec4f(7, 7, 7, 7);
+                std::copy(in, in + size, same);
+
+                switch (op)
+                {
+                    case scalar::TRANSFORM_POINTS: calc::transform_points(m, in, out, size); calc::transform_points(m, same, same, size); break;
+                    case scalar::TRANSFORM_DIRS: calc::transform_dirs(m, in, out, size); calc::transform_dirs(m, same, same, size); break;
+                    case scalar::PROJECT_POINTS: calc::project_points(m, in, out, size); calc::project_points(m, same, same, size); break;
+                    case scalar::TRANSFORM_VEC4: calc::transform_points(m, in4, out4, size); break;
+                }
+
+                const bool vec4 = (op == scalar::TRANSFORM_VEC4);
+                if (vec4) {
+                    scalar::transform(op, calc::data(m), calc::data(in4[0]), calc::data(expected4[0]), size);
+                }
+                else {
+                    scalar::transform(op, calc::data(m), calc::data(in[0]), calc::data(expected[0]), size);
+                }
+
+                for (std::size_t i = 0; i != size; ++i)
+                {
+                    const float* o = vec4 ? calc::data(out4[i]) : calc::data(out[i]);
+                    const float* e = vec4 ? calc::data(expected4[i]) : calc::data(expected[i]);
+                    for (unsigned j = 0; j != 4; ++j)
+                    {
+                        failures += compare<float>(names[mode], "vec", unsigned(i * 4 + j), o[j], e[j], (j == 3 && !vec4) ? 0 : 1e-5f);
+                        if (!vec4) {
+                            failures += compare<float>(names[mode], "in place", unsigned(i * 4 + j), calc::data(same[i])[j], o[j], 0);
+                        }
+                    }
+                }
+
+                const float canary = vec4 ? out4[size][0] : out[size][0];
+                failures += compare<float>(names[mode], "canary", unsigned(size), canary, 7, 0);
+            }
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! Batched sincos, within the stated error of libm over |rad| <= 8192
+     *! @return number of failures
+     */
+    unsigned check_sincos()
+    {
+        const std::size_t size = 1027;
+
+        float rad[size], s[size], c[size], expectedS[size], expectedC[size];
+        for (std::size_t i = 0; i != size; ++i)
+            rad[i] = (i < size / 2) ? (std::rand() % 2000) / 1000.0f * 3.14159265f - 3.14159265f
+                                    : (std::rand() % 2000) / 1000.0f * 8192 - 8192;
+
+        calc::sincos(rad, s, c, size);
+        scalar::sincos(rad, expectedS, expectedC, size);
+
+        unsigned failures = 0;
+        for (std::size_t i = 0; i != size; ++i)
+        {
+            failures += compare<float>("sin", "[]", unsigned(i), s[i], expectedS[i], 2e-7f);
+            failures += compare<float>("cos", "[]", unsigned(i), c[i], expectedC[i], 2e-7f);
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! mat4f_array::compose, called again and again on one batch that
+     *! shrinks, with and without rotation and scale: nothing of an earlier
+     *! call may leak into a later one
+     *! @return number of failures
+     */
+    unsigned check_compose()
+    {
+        const std::size_t capacity = 37;
+
+        float streams[9][capacity];
+        for (float* p : streams)
+            for (std::size_t i = 0; i != capacity; ++i)
+                p[i] = (std::rand() % 2000) / 1000.0f - 1;
+
+        const float* const t[3] = { streams[0], streams[1], streams[2] };
+        const float* const r[3] = { streams[3], streams[4], streams[5] };
+        const float* const s[3] = { streams[6], streams[7], streams[8] };
+
+        calc::mat4f_array m(capacity);
+        float expected[capacity * 16];
+
+        unsigned failures = 0;
+        for (std::size_t size = capacity; size + 1 != 0; --size)
+        {
+            m.resize(size);
+
+            char shape[32];
+            snprintf(shape, sizeof(shape), "[%zu]", size);
+
+            for (unsigned pass = 0; pass != 3; ++pass)
+            {
+                const float* const* rotation = (pass == 1) ? nullptr : r;
+                const float* const* scale = (pass == 2) ? nullptr : s;
+
+                m.compose(t, rotation, scale);
+                scalar::compose(t, rotation, scale, expected, size);
+
+                for (std::size_t i = 0; i != size; ++i)
+                {
+                    const calc::mat4f x = m.get(i);
+                    for (unsigned k = 0; k != 16; ++k)
+                        failures += compare<float>("compose", shape, unsigned(i * 16 + k), calc::data(x)[k], expected[i * 16 + k], 1e-6f);
+                }
+            }
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! The elementwise engine on unpadded arrays of every length to 70,
+     *! unaligned, in place and fused: every element is compared and the
+     *! element past the end must be left alone. The engine has no
+     *! __NO_USE_SIMD__ form; the reference is the expression itself, which
+     *! rounds as the scalar operators do
+     *! @return number of failures
+     */
+    template <typename T>
+    unsigned check_arrays()
+    {
+        const std::size_t capacity = 72;
+
+        // One past 16-byte alignment, and a canary after the last element
+        T a[capacity + 1], b[capacity + 1], c[capacity + 1], out[capacity + 1];
+        for (std::size_t i = 0; i != capacity + 1; ++i)
+        {
+            a[i] = (std::rand() % 2000) / T(1000) - 1;
+            b[i] = (std::rand() % 2000) / T(1000) - 1;
+            c[i] = (std::rand() % 2000) / T(1000) - 1;
+        }
+
+        const T scalar = (std::rand() % 1000) / T(1000) + T(0.5);
+        const T canary = T(-12345);
+
+        unsigned failures = 0;
+        for (std::size_t size = 0; size <= 70; ++size)
+        {
+            char shape[16];
+            snprintf(shape, sizeof(shape), "[%zu]%s", size, sizeof(T) == sizeof(double) ? "d" : "");
+
+            const T* x = a + 1;
+            const T* y = b + 1;
+            const T* z = c + 1;
+            T* o = out + 1;
+
+            auto check = [&](const char* op, auto reference, const T tol) {
+
+                for (std::size_t i = 0; i != size; ++i)
+                    failures += compare<T>(op, shape, unsigned(i), o[i], reference(i), tol);
+                failures += compare<T>(op, shape, unsigned(size), o[size], canary, 0);
+                o[size] = canary;
+            };
+
+            o[size] = canary;
+
+            calc::matrix_add<T>::add(x, y, o, size);
+            check("add[]", [&](std::size_t i) { return x[i] + y[i]; }, 0);
+
+            calc::matrix_sub<T>::sub(x, y, o, size);
+            check("sub[]", [&](std::size_t i) { return x[i] - y[i]; }, 0);
+
+            calc::detail::schur_mul<T>::mul(x, y, o, size);
+            check("schur[]", [&](std::size_t i) { return x[i] * y[i]; }, 0);
+
+            calc::scalar_mul<T>::mul(x, scalar, o, size);
+            check("mul s[]", [&](std::size_t i) { return x[i] * scalar; }, 0);
+
+            calc::scalar_div<T>::div(x, scalar, o, size);
+            check("div s[]", [&](std::size_t i) { return x[i] / scalar; }, 0);
+
+            // A multiply-add may be contracted to one rounding
+            calc::elementwise(o, size, calc::elements(x) * scalar + calc::elements(y) - calc::elements(z));
+            check("fused[]", [&](std::size_t i) { return x[i] * scalar + y[i] - z[i]; }, 4 * std::numeric_limits<T>::epsilon() * 4);
+
+            std::copy(x, x + size, o);
+            calc::elementwise(o, size, calc::elements<T>(o) / calc::elements(y) + calc::elements<T>(o));
+            check("in place[]", [&](std::size_t i) { return x[i] / y[i] + x[i]; }, 0);
+        }
+
+        return failures;
+    }
+
+    /*! Helper
+     *! calc::gemm on one shape, serial and split over three threads, and the
+     *! aliasing dynamic product in place; the packed kernels reassociate, so
+     *! each element may differ from the scalar build by a few ulp of the sum
+     *! of |products|
+     *! @return number of failures
+     */
+    unsigned check_gemm(const std::size_t n, const std::size_t k, const std::size_t m)
+    {
+        calc::matf a(n, k), b(k, m), c1(n, m), c3(n, m), expected(n, m);
+        for (std::size_t i = 0; i != a.size(); ++i)
+            calc::data(a)[i] = (std::rand() % 2000) / 1000.0f - 1;
+        for (std::size_t i = 0; i != b.size(); ++i)
+            calc::data(b)[i] = (std::rand() % 2000) / 1000.0f - 1;
+
+        calc::gemm(calc::data(a), calc::data(b), calc::data(c1), n, k, m, 1);
+        calc::gemm(calc::data(a), calc::data(b), calc::data(c3), n, k, m, 3);
+        scalar::gemm(calc::data(a), calc::data(b), calc::data(expected), n, k, m);
+
+        char shape[48];
+        snprintf(shape, sizeof(shape), "%zux%zu * %zux%zu", n, k, k, m);
+
+        // |a| and |b| are below one
+        const float tol = 4 * k * std::numeric_limits<float>::epsilon() * k;
+
+        unsigned failures = 0;
+        for (std::size_t i = 0; i != c1.size(); ++i)
+        {
+            failures += compare<float>("gemm", shape, unsigned(i), calc::data(c1)[i], calc::data(expected)[i], tol);
+            failures += compare<float>("gemm threads", shape, unsigned(i), calc::data(c3)[i], calc::data(c1)[i], 0);
+        }
+
+        // Square products also go through matrix_mul in place, as operator*= does
+        if (n == k && k == m)
+        {
+            calc::matf x = a;
+            calc::matrix_mul<float, 0, 0, 0>::mul(calc::data(x), calc::data(b), calc::data(x), n, k, m);
+            for (std::size_t i = 0; i != x.size(); ++i)
+                failures += compare<float>("mul in place", shape, unsigned(i), calc::data(x)[i], calc::data(c1)[i], 0);
+        }
+
+        return failures;
+    }
+}
+
+/*! Entry point
+ *! Pins each backend in turn with calc::set_backend() and compares every
+ *! calc operator, float and double, 1x1 to 8x8, with the scalar build;
+ *! backends the host cannot run are reported and skipped
+ */
+int main()
+{
+    unsigned failures = 0;
+    for (unsigned b = calc::BACKEND_SSE4; b <= calc::BACKEND_AVX512; ++b)
+    {
+        const calc::backend backend = static_cast<calc::backend>(b);
+        if (!calc::set_backend(backend))
+        {
+            printf("%-8s skipped, not supported by this host\n", calc::get_backend_name(backend));
+            continue;
+        }
+
+        checks = 0;
+        const unsigned count = check_shapes<float>(std::make_integer_sequence<unsigned, scalar::SHAPE_MAX>())
+                             + check_shapes<double>(std::make_integer_sequence<unsigned, scalar::SHAPE_MAX>())
+                             + check_non_finite<3, 1>()
+                             + check_non_finite<3, 3>()
+                             + check_non_finite<4, 1>()
+                             + check_non_finite<4, 4>()
+                             + check_vectors(std::make_integer_sequence<unsigned, scalar::SHAPE_MAX>())
+                             + check_batched<3>()
+                             + check_batched<4>()
+                             + check_transpose()
+                             + check_inverse<float, 2>(1e-5f)
+                             + check_inverse<float, 3>(1e-5f)
+                             + check_inverse<float, 4>(1e-5f)
+                             + check_inverse<double, 4>(1e-12)
+                             + check_inverse_affine()
+                             + check_quat()
+                             + check_transform_points()
+                             + check_sincos()
+                             + check_compose()
+                             + check_arrays<float>()
+                             + check_arrays<double>()
+                             + check_gemm(1, 1, 1)
+                             + check_gemm(7, 13, 5)
+                             + check_gemm(67, 45, 131)
+                             + check_gemm(64, 64, 64)
+                             + check_gemm(130, 300, 37)
+                             // Large enough to split: two B panels across, and
+                             // a B panel too narrow for every thread to pack
+                             + check_gemm(203, 517, 2101)
+                             + check_gemm(300, 3000, 5);
+
+        printf("%-8s %10zu values %10u failures\n", calc::get_backend_name(backend), checks, count);
+        failures += count;
+    }
+
+    if (failures != 0)
+    {
+        printf("\nerror: SIMD results differ from the __NO_USE_SIMD__ build\n");
+        return 1;
+    }
+
+    return 0;
+}